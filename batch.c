@@ -0,0 +1,394 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "batch.h"
+#include "syntax.h"
+#include "cache.h"
+#include "trace.h"
+
+#define BATCH_READ_SIZE    (1 << 20) // Bytes read at once from pipes
+#define BATCH_CHUNK_SIZE   (1 << 18) // Bytes of input one worker takes at once
+#define BATCH_CHUNKS_PER_THREAD 8    // Chunks per thread evaluated before results are written
+
+// A chunk only ever contains complete lines, its results are written once all chunks before it are
+typedef struct BatchChunk {
+    const char * data;
+    size_t len;
+    size_t lines;
+    ByteBuf out;
+    ByteBuf errors; // Records of a size_t line inside the chunk followed by the NUL terminated message
+    bool failed;    // Out of memory, out and errors are incomplete
+} BatchChunk;
+
+// Chunks of a worker are the range [begin, end), the owner takes from begin and thieves from end
+typedef struct BatchWorker {
+    _Atomic uint64_t range; // begin in the upper, end in the lower 32 bits
+    TokenVec tokens;
+    NodeArena arena;
+    ResultCache cache; // Only used with a memory_cap
+    pthread_t thread;
+    struct BatchPool * pool;
+} BatchWorker;
+
+typedef struct BatchPool {
+    size_t thread_count;
+    BatchWorker * workers;
+    BatchChunk * chunks;
+    size_t chunk_count;
+    size_t chunk_capacity;
+    size_t line;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    size_t generation;
+    size_t active;
+    bool quit;
+} BatchPool;
+
+static bool writeAll(int fd, const char * data, size_t len) {
+    size_t written = 0;
+    while (written < len) {
+        const ssize_t n = write(fd, data + written, len - written);
+        if (n < 0) return false;
+        written += (size_t)n;
+    }
+    return true;
+}
+
+static void evaluateLine(BatchWorker * worker, BatchChunk * chunk, const char * line, size_t len) {
+    worker->tokens.count = 0;
+    resetNodeArena(&worker->arena);
+
+    double result = 0;
+    NodeIndex root = NO_NODE;
+    ResultCache * cache = worker->cache.memory_cap ? &worker->cache : NULL;
+    bool ok = tokenizeN(line, len, &worker->tokens);
+    // A cached line is neither parsed nor calculated
+    if (ok && !(cache && lookupResultCache(cache, &worker->tokens, &result))) {
+        ok = (root = createSyntaxTree(&worker->arena, line, &worker->tokens)) != NO_NODE
+          && calculateResult(&worker->arena, root, NULL, &result);
+        if (ok && cache) insertResultCache(cache, result);
+    }
+    if (!ok) {
+        TRACE_STAGE(TraceError, TraceInstant, chunk->lines, 0);
+        const size_t msg_len = strlen(err_msg) + 1;
+        if (!reserveByteBuf(&chunk->errors, chunk->errors.count + sizeof(size_t) + msg_len)) {
+            chunk->failed = true;
+            return;
+        }
+        memcpy(chunk->errors.vals + chunk->errors.count, &chunk->lines, sizeof(size_t));
+        memcpy(chunk->errors.vals + chunk->errors.count + sizeof(size_t), err_msg, msg_len);
+        chunk->errors.count += sizeof(size_t) + msg_len;
+        result = NAN;
+    }
+    // Every later result would belong to the line before it
+    if (!reserveByteBuf(&chunk->out, chunk->out.count + 32)) {
+        chunk->failed = true;
+        return;
+    }
+    chunk->lines++;
+    chunk->out.count += (size_t)snprintf(chunk->out.vals + chunk->out.count, 32, "%.17g\n", result);
+}
+
+static void evaluateChunk(BatchWorker * worker, BatchChunk * chunk) {
+    chunk->lines = 0;
+    chunk->out.count = 0;
+    chunk->errors.count = 0;
+    chunk->failed = false;
+    TRACE_STAGE(TraceBatchChunk, TraceBegin, 0, 0);
+
+    size_t pos = 0;
+    while (pos < chunk->len && !chunk->failed) {
+        const char * end = memchr(chunk->data + pos, '\n', chunk->len - pos);
+        const size_t line_len = end ? (size_t)(end - (chunk->data + pos)) : chunk->len - pos;
+        evaluateLine(worker, chunk, chunk->data + pos, line_len);
+        pos += line_len + (end ? 1 : 0);
+    }
+    TRACE_STAGE(TraceBatchChunk, TraceEnd, chunk->lines, 0);
+}
+
+static bool takeChunk(BatchWorker * worker, bool steal, uint32_t * chunk) {
+    uint64_t range = atomic_load(&worker->range);
+    for (;;) {
+        const uint32_t begin = (uint32_t)(range >> 32);
+        const uint32_t end = (uint32_t)range;
+        if (begin >= end) return false;
+        const uint64_t next = steal ? ((uint64_t)begin << 32) | (end - 1) : ((uint64_t)(begin + 1) << 32) | end;
+        if (atomic_compare_exchange_weak(&worker->range, &range, next)) {
+            *chunk = steal ? end - 1 : begin;
+            return true;
+        }
+    }
+}
+
+static void workOnWindow(BatchWorker * worker) {
+    BatchPool * pool = worker->pool;
+    uint32_t chunk;
+    while (takeChunk(worker, false, &chunk)) evaluateChunk(worker, &pool->chunks[chunk]);
+
+    // Own chunks are done, help the others starting with the next worker
+    const size_t self = (size_t)(worker - pool->workers);
+    for (size_t i = 1; i < pool->thread_count; i++) {
+        BatchWorker * victim = &pool->workers[(self + i) % pool->thread_count];
+        while (takeChunk(victim, true, &chunk)) evaluateChunk(worker, &pool->chunks[chunk]);
+    }
+}
+
+static void * batchWorkerThread(void * arg) {
+    BatchWorker * worker = arg;
+    BatchPool * pool = worker->pool;
+    size_t generation = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (!pool->quit && pool->generation == generation) pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->quit) break;
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        workOnWindow(worker);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static bool createBatchPool(BatchPool * pool, size_t thread_count, size_t cache_bytes) {
+    *pool = (BatchPool) { 0 };
+    pool->thread_count = thread_count;
+    pool->chunk_capacity = thread_count * BATCH_CHUNKS_PER_THREAD;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->workers = calloc(thread_count, sizeof(BatchWorker));
+    pool->chunks = calloc(pool->chunk_capacity, sizeof(BatchChunk));
+    if (!pool->workers || !pool->chunks) return false;
+    for (size_t i = 0; i < thread_count; i++) {
+        BatchWorker * worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->tokens = createTokenVec();
+        worker->arena = createNodeArena();
+        worker->cache = createResultCache(cache_bytes / thread_count);
+        // The calling thread is worker 0
+        if (i && pthread_create(&worker->thread, NULL, batchWorkerThread, worker) != 0) {
+            freeTokenVec(worker->tokens);
+            freeNodeArena(worker->arena);
+            freeResultCache(worker->cache);
+            pool->thread_count = i;
+            break;
+        }
+    }
+    return true;
+}
+
+static void freeBatchPool(BatchPool * pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; pool->workers && pool->chunks && i < pool->thread_count; i++) {
+        if (i) pthread_join(pool->workers[i].thread, NULL);
+        freeTokenVec(pool->workers[i].tokens);
+        freeNodeArena(pool->workers[i].arena);
+        freeResultCache(pool->workers[i].cache);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    for (size_t i = 0; pool->chunks && i < pool->chunk_capacity; i++) {
+        freeByteBuf(pool->chunks[i].out);
+        freeByteBuf(pool->chunks[i].errors);
+    }
+    free(pool->chunks);
+    free(pool->workers);
+}
+
+// Writes results and errors of all chunks in input order
+static bool writeWindow(BatchPool * pool) {
+    for (size_t i = 0; i < pool->chunk_count; i++) {
+        const BatchChunk * chunk = &pool->chunks[i];
+        // Workers cannot set err_msg of this thread
+        if (chunk->failed) {
+            snprintf(err_msg, sizeof(err_msg), "Out of memory while evaluating line %zu\n", pool->line + chunk->lines + 1);
+            return false;
+        }
+        size_t pos = 0;
+        while (pos < chunk->errors.count) {
+            size_t line;
+            memcpy(&line, chunk->errors.vals + pos, sizeof(size_t));
+            const char * msg = chunk->errors.vals + pos + sizeof(size_t);
+            fprintf(stderr, "Line %zu: %s", pool->line + line + 1, msg);
+            pos += sizeof(size_t) + strlen(msg) + 1;
+        }
+        if (!writeAll(STDOUT_FILENO, chunk->out.vals, chunk->out.count)) {
+            snprintf(err_msg, sizeof(err_msg), "Could not write results\n");
+            return false;
+        }
+        pool->line += chunk->lines;
+    }
+    return true;
+}
+
+// Splits the complete lines of data into chunks and evaluates them on all workers.
+// The last line is only evaluated if final is set. Returns the number of bytes consumed.
+static size_t evaluateWindow(BatchPool * pool, const char * data, size_t len, bool final, bool * ok) {
+    size_t pos = 0;
+    pool->chunk_count = 0;
+    while (pos < len && pool->chunk_count < pool->chunk_capacity) {
+        size_t end = pos + BATCH_CHUNK_SIZE < len ? pos + BATCH_CHUNK_SIZE : len;
+        const char * newline = memchr(data + end - 1, '\n', len - end + 1);
+        if (newline)     end = (size_t)(newline - data) + 1;
+        else if (final)  end = len;
+        else {
+            // No complete line left, let the caller provide more input
+            const char * last = memrchr(data + pos, '\n', end - pos);
+            if (!last) break;
+            end = (size_t)(last - data) + 1;
+        }
+        BatchChunk * chunk = &pool->chunks[pool->chunk_count++];
+        chunk->data = data + pos;
+        chunk->len = end - pos;
+        pos = end;
+    }
+    if (pool->chunk_count == 0) return 0;
+
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        const uint64_t begin = i * pool->chunk_count / pool->thread_count;
+        const uint64_t end = (i + 1) * pool->chunk_count / pool->thread_count;
+        atomic_store(&pool->workers[i].range, (begin << 32) | end);
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->active = pool->thread_count - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    workOnWindow(&pool->workers[0]);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active) pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!writeWindow(pool)) *ok = false;
+    return pos;
+}
+
+static bool runBatchMapped(BatchPool * pool, int fd, size_t size) {
+    if (size == 0) return true;
+    char * data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        snprintf(err_msg, sizeof(err_msg), "Could not map input file\n");
+        return false;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    // Pages of evaluated windows are dropped, so memory use stays constant
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    bool ok = true;
+    size_t pos = 0;
+    while (ok && pos < size) {
+        const size_t consumed = evaluateWindow(pool, data + pos, size - pos, true, &ok);
+        const size_t release_start = pos & ~(page - 1);
+        pos += consumed;
+        const size_t release_end = pos & ~(page - 1);
+        if (release_end > release_start) madvise(data + release_start, release_end - release_start, MADV_DONTNEED);
+    }
+
+    munmap(data, size);
+    return ok;
+}
+
+static bool runBatchStream(BatchPool * pool, int fd) {
+    size_t capacity = pool->chunk_capacity * BATCH_CHUNK_SIZE;
+    if (capacity < BATCH_READ_SIZE) capacity = BATCH_READ_SIZE;
+    char * buf = malloc(capacity);
+    if (!buf) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while reading input\n");
+        return false;
+    }
+
+    bool ok = true;
+    bool eof = false;
+    size_t count = 0;
+    while (ok && !(eof && count == 0)) {
+        // Only a line longer than the buffer lets it grow
+        if (count == capacity) {
+            char * grown = realloc(buf, capacity * 2);
+            if (!grown) {
+                snprintf(err_msg, sizeof(err_msg), "Out of memory while reading input\n");
+                ok = false;
+                break;
+            }
+            buf = grown;
+            capacity *= 2;
+        }
+        while (!eof && count < capacity) {
+            const ssize_t n = read(fd, buf + count, capacity - count);
+            if (n < 0) {
+                snprintf(err_msg, sizeof(err_msg), "Could not read input\n");
+                ok = false;
+                break;
+            }
+            if (n == 0) eof = true;
+            count += (size_t)n;
+        }
+        if (!ok) break;
+
+        const size_t consumed = evaluateWindow(pool, buf, count, eof, &ok);
+        memmove(buf, buf + consumed, count - consumed);
+        count -= consumed;
+    }
+
+    free(buf);
+    return ok;
+}
+
+static void printCacheStats(const BatchPool * pool) {
+    CacheStats total = { 0 };
+    for (size_t i = 0; i < pool->thread_count; i++) addCacheStats(&total, &pool->workers[i].cache.stats);
+    const size_t lookups = total.hits + total.misses;
+    fprintf(stderr, "Cache: %zu hits, %zu misses (%.1f%% hit rate), %zu evictions, %zu uncacheable, %zu entries in %zu KiB\n",
+            total.hits, total.misses, lookups ? 100.0 * (double)total.hits / (double)lookups : 0.0,
+            total.evictions, total.uncacheable, total.entries, total.memory / 1024);
+}
+
+int runBatch(const char * filename, size_t thread_count, size_t cache_bytes) {
+    const bool use_stdin = !filename || strcmp(filename, "-") == 0;
+    const int fd = use_stdin ? STDIN_FILENO : open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open file >%s<\n", filename);
+        return -1;
+    }
+
+    if (thread_count == 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cpus > 0 ? (size_t)cpus : 1;
+    }
+    BatchPool pool;
+    bool ok = createBatchPool(&pool, thread_count, cache_bytes);
+    if (!ok) snprintf(err_msg, sizeof(err_msg), "Out of memory\n");
+
+    struct stat st;
+    if (ok) {
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) ok = runBatchMapped(&pool, fd, (size_t)st.st_size);
+        else                                           ok = runBatchStream(&pool, fd);
+    }
+    if (!ok) fprintf(stderr, "%s", err_msg);
+    if (cache_bytes && pool.workers) printCacheStats(&pool);
+
+    freeBatchPool(&pool);
+    if (!use_stdin) close(fd);
+    return ok ? 0 : -1;
+}
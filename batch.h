@@ -0,0 +1,11 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+#include <stddef.h>
+
+// Evaluates every line of filename (stdin for NULL or "-") and writes one result per line to stdout.
+// Errors are reported on stderr, the result of a line with an error is nan.
+// Lines are evaluated on thread_count threads (0 for one per CPU), results keep the input order.
+// With cache_bytes every thread caches results of repeated lines, together using at most cache_bytes.
+int runBatch(const char * filename, size_t thread_count, size_t cache_bytes);
+
+#endif // __BATCH_H__
@@ -0,0 +1,283 @@
+// Measures every stage of the pipeline separately on generated expressions.
+// The generator is seeded, the same seed always produces the same expressions.
+// Results are printed as JSON or CSV, in ns per token so workloads of different size compare.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+#include "syntax.h"
+#include "vm.h"
+#include "trace.h"
+#include "generate.h"
+
+#define BENCH_DEFAULT_SEED        1
+#define BENCH_DEFAULT_EXPRESSIONS 32
+#define BENCH_DEFAULT_SAMPLES     21
+#define BENCH_BATCH_TOKENS        4096 // A timed batch repeats an expression until it covers about this many tokens
+
+typedef enum BenchStage {
+    StageTokenize = 0, // tokenizeN
+    StageParse,        // createSyntaxTree, includes every syntax check
+    StageEvaluate,     // calculateResult on the parsed tree
+    StageCompile,      // compileProgram
+    StageVm,           // runProgram on the compiled bytecode
+    StageEndToEnd,     // tokenize, parse and calculateResult like the command line does
+    StageCount,
+} BenchStage;
+
+static const char * stage_names[StageCount] = {"tokenize", "parse", "evaluate", "compile", "vm", "end_to_end"};
+
+typedef struct BenchResult {
+    double tokens;            // Mean tokens per expression
+    double dedup_ratio;       // Mean tree nodes per stored node, 1 without --share
+    double median_ns_per_token;
+    double p99_ns_per_token;
+    double mean_ns_per_expression;
+} BenchResult;
+
+static bool share_nodes;
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int compareDoubles(const void * a, const void * b) {
+    const double left = *(const double *)a;
+    const double right = *(const double *)b;
+    return (left > right) - (left < right);
+}
+
+// Nearest rank percentile of sorted samples
+static double percentile(const double * sorted, size_t count, double fraction) {
+    size_t rank = (size_t)ceil(fraction * (double)count);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+static void abortBench(const char * expression) {
+    fprintf(stderr, "%sin generated expression >%.80s<\n", err_msg, expression);
+    exit(-1);
+}
+
+static volatile double sink;
+
+// Runs one stage of one expression iterations times, returns the elapsed ns
+static double timeStage(BenchStage stage, const char * expression, size_t len, size_t iterations,
+                        TokenVec * tokens, NodeArena * arena, NodeIndex root, const Program * program,
+                        const double * variables, double * stack) {
+    double result = 0;
+    const double start = nowNs();
+    for (size_t i = 0; i < iterations; i++) {
+        switch (stage) {
+            case StageTokenize:
+                tokens->count = 0;
+                if (!tokenizeN(expression, len, tokens)) abortBench(expression);
+                break;
+            case StageParse:
+                resetNodeArena(arena);
+                if (createSyntaxTree(arena, expression, tokens) == NO_NODE) abortBench(expression);
+                break;
+            case StageEvaluate:
+                if (!calculateResult(arena, root, variables, &result)) abortBench(expression);
+                break;
+            case StageCompile: {
+                Program compiled;
+                if (!compileProgram(arena, root, &compiled)) abortBench(expression);
+                result += (double)compiled.code_count;
+                freeProgram(compiled);
+                break;
+            }
+            case StageVm:
+                result += runProgram(program, variables, stack);
+                break;
+            case StageEndToEnd: {
+                tokens->count = 0;
+                resetNodeArena(arena);
+                if (!tokenizeN(expression, len, tokens)) abortBench(expression);
+                const NodeIndex parsed = createSyntaxTree(arena, expression, tokens);
+                if (parsed == NO_NODE || !calculateResult(arena, parsed, variables, &result)) abortBench(expression);
+                break;
+            }
+            case StageCount:
+                break;
+        }
+    }
+    const double elapsed = nowNs() - start;
+    sink = result;
+    return elapsed;
+}
+
+static void runWorkload(const Workload * workload, size_t expression_count, size_t sample_count, BenchResult results[StageCount]) {
+    const size_t total_samples = expression_count * sample_count;
+    double * samples[StageCount];
+    double total_ns[StageCount] = { 0 };
+    for (int stage = 0; stage < StageCount; stage++) {
+        samples[stage] = malloc(total_samples * sizeof(double));
+        if (!samples[stage]) {
+            fprintf(stderr, "Out of memory\n");
+            exit(-1);
+        }
+    }
+
+    CharBuf expression = { 0 };
+    TokenVec tokens = createTokenVec();
+    NodeArena arena = createNodeArena();
+    arena.share_nodes = share_nodes;
+    size_t total_tokens = 0;
+    size_t filled = 0;
+    double total_ratio = 0;
+    for (size_t e = 0; e < expression_count; e++) {
+        expression.count = 0;
+        repeat_count = 0;
+        generateExpression(&expression, workload, workload->tokens, 0);
+        const size_t len = expression.count;
+
+        tokens.count = 0;
+        resetNodeArena(&arena);
+        if (!tokenizeN(expression.vals, len, &tokens)) abortBench(expression.vals);
+        const NodeIndex root = createSyntaxTree(&arena, expression.vals, &tokens);
+        if (root == NO_NODE) abortBench(expression.vals);
+        total_ratio += (double)(arena.count + arena.reused) / (double)arena.count;
+        Program program;
+        if (!compileProgram(&arena, root, &program)) abortBench(expression.vals);
+
+        // Every variable gets a distinct value, the names of the program are in the same order as the arena's
+        double * variables = malloc((arena.variables.count + 1) * sizeof(double));
+        double * stack = malloc((program.max_stack + program.slot_count) * sizeof(double));
+        if (!variables || !stack) {
+            fprintf(stderr, "Out of memory\n");
+            exit(-1);
+        }
+        for (size_t i = 0; i < arena.variables.count; i++) variables[i] = 1.0 + 0.25 * (double)i;
+
+        const size_t token_count = tokens.count;
+        const size_t iterations = token_count < BENCH_BATCH_TOKENS ? BENCH_BATCH_TOKENS / token_count : 1;
+        total_tokens += token_count;
+        for (int stage = 0; stage < StageCount; stage++) {
+            // One untimed batch warms up caches and lets the arena and vectors reach their final size
+            timeStage((BenchStage)stage, expression.vals, len, iterations, &tokens, &arena, root, &program, variables, stack);
+            for (size_t s = 0; s < sample_count; s++) {
+                const double ns = timeStage((BenchStage)stage, expression.vals, len, iterations, &tokens, &arena, root, &program, variables, stack);
+                samples[stage][filled + s] = ns / (double)iterations / (double)token_count;
+                total_ns[stage] += ns / (double)iterations;
+            }
+        }
+        filled += sample_count;
+
+        free(stack);
+        free(variables);
+        freeProgram(program);
+    }
+
+    for (int stage = 0; stage < StageCount; stage++) {
+        qsort(samples[stage], total_samples, sizeof(double), compareDoubles);
+        results[stage] = (BenchResult) {
+            .tokens = (double)total_tokens / (double)expression_count,
+            .dedup_ratio = total_ratio / (double)expression_count,
+            .median_ns_per_token = percentile(samples[stage], total_samples, 0.5),
+            .p99_ns_per_token = percentile(samples[stage], total_samples, 0.99),
+            .mean_ns_per_expression = total_ns[stage] / (double)total_samples,
+        };
+        free(samples[stage]);
+    }
+
+    free(expression.vals);
+    freeNodeArena(arena);
+    freeTokenVec(tokens);
+}
+
+int main(int argc, char * argv[]) {
+    uint64_t seed = BENCH_DEFAULT_SEED;
+    size_t expression_count = BENCH_DEFAULT_EXPRESSIONS;
+    size_t sample_count = BENCH_DEFAULT_SAMPLES;
+    bool csv = false;
+    const char * only_workload = NULL;
+    const char * output_file = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+            continue;
+        }
+        if (strcmp(argv[i], "--expressions") == 0 && i + 1 < argc) {
+            expression_count = (size_t)strtoul(argv[++i], NULL, 10);
+            continue;
+        }
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            sample_count = (size_t)strtoul(argv[++i], NULL, 10);
+            continue;
+        }
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            csv = strcmp(argv[++i], "csv") == 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--workload") == 0 && i + 1 < argc) {
+            only_workload = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--share") == 0) {
+            share_nodes = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_file = argv[++i];
+            continue;
+        }
+        fprintf(stderr, "Usage: %s [--seed N] [--expressions N] [--samples N] [--format json|csv] [--workload Name] [--share] [--output File]\n", argv[0]);
+        fprintf(stderr, "Workloads:");
+        for (size_t w = 0; w < WORKLOAD_COUNT; w++) fprintf(stderr, " %s", workloads[w].name);
+        fprintf(stderr, "\n");
+        return -1;
+    }
+    if (!expression_count || !sample_count) {
+        fprintf(stderr, "--expressions and --samples need to be at least 1\n");
+        return -1;
+    }
+
+    FILE * out = output_file ? fopen(output_file, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Could not open output file >%s<\n", output_file);
+        return -1;
+    }
+
+    if (csv) {
+        fprintf(out, "workload,stage,tokens_per_expression,dedup_ratio,median_ns_per_token,p99_ns_per_token,mean_ns_per_expression,tokens_per_second\n");
+    } else {
+        fprintf(out, "{\n  \"seed\": %llu,\n  \"expressions\": %zu,\n  \"samples\": %zu,\n  \"trace_level\": %d,\n  \"share_nodes\": %s,\n  \"results\": [",
+                (unsigned long long)seed, expression_count, sample_count, TRACE_LEVEL, share_nodes ? "true" : "false");
+    }
+
+    bool first = true;
+    for (size_t w = 0; w < WORKLOAD_COUNT; w++) {
+        const Workload * workload = &workloads[w];
+        if (only_workload && strcmp(only_workload, workload->name) != 0) continue;
+        // Every workload starts from the seed, so filtering one out does not change the others
+        random_state = (seed + w + 1) * 0x9e3779b97f4a7c15u;
+        BenchResult results[StageCount];
+        runWorkload(workload, expression_count, sample_count, results);
+
+        for (int stage = 0; stage < StageCount; stage++) {
+            const BenchResult * r = &results[stage];
+            const double tokens_per_second = 1e9 / r->median_ns_per_token;
+            if (csv) {
+                fprintf(out, "%s,%s,%.1f,%.3f,%.3f,%.3f,%.1f,%.0f\n", workload->name, stage_names[stage],
+                        r->tokens, r->dedup_ratio, r->median_ns_per_token, r->p99_ns_per_token, r->mean_ns_per_expression, tokens_per_second);
+            } else {
+                fprintf(out, "%s\n    {\"workload\": \"%s\", \"stage\": \"%s\", \"tokens_per_expression\": %.1f, \"dedup_ratio\": %.3f, "
+                        "\"median_ns_per_token\": %.3f, \"p99_ns_per_token\": %.3f, \"mean_ns_per_expression\": %.1f, \"tokens_per_second\": %.0f}",
+                        first ? "" : ",", workload->name, stage_names[stage], r->tokens, r->dedup_ratio, r->median_ns_per_token,
+                        r->p99_ns_per_token, r->mean_ns_per_expression, tokens_per_second);
+            }
+            first = false;
+        }
+    }
+    if (!csv) fprintf(out, "\n  ]\n}\n");
+
+    if (out != stdout) fclose(out);
+    for (size_t i = 0; i < BENCH_REPEAT_POOL; i++) free(repeat_pool[i].vals);
+    return 0;
+}
@@ -0,0 +1,172 @@
+// Times the exact mode: big integer multiplication with schoolbook against Karatsuba, then whole
+// expressions evaluated exactly against the double path of calculateResult.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "syntax.h"
+#include "exact.h"
+
+#define BENCH_MIN_NS 2e8 // Every measurement repeats until it took this long
+
+static const size_t multiply_limbs[] = {8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096};
+#define MULTIPLY_COUNT (sizeof(multiply_limbs) / sizeof(multiply_limbs[0]))
+
+static uint64_t random_state = 0x9e3779b97f4a7c15u;
+
+static uint64_t nextRandom(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Random integer literal with digits digits
+static char * randomDigits(size_t digits) {
+    char * str = malloc(digits + 1);
+    for (size_t i = 0; i < digits; i++) str[i] = (char)('0' + nextRandom() % 10);
+    str[0] = (char)('1' + nextRandom() % 9);
+    str[digits] = '\0';
+    return str;
+}
+
+static double timeMultiply(LimbPool * pool, const Rational * a, const Rational * b, Rational * product, size_t threshold) {
+    exact_karatsuba_threshold = threshold;
+    long runs = 0;
+    const double start = nowNs();
+    double elapsed;
+    do {
+        applyExactOperator(pool, a, b, OperatorMult, product);
+        runs++;
+    } while ((elapsed = nowNs() - start) < BENCH_MIN_NS);
+    return elapsed / (double)runs;
+}
+
+static void benchMultiply(void) {
+    const size_t threshold = exact_karatsuba_threshold;
+    LimbPool pool = createLimbPool();
+    printf("%-8s %9s %14s %14s %9s\n", "limbs", "digits", "schoolbook", "karatsuba", "speedup");
+    for (size_t s = 0; s < MULTIPLY_COUNT; s++) {
+        const size_t digits = (size_t)((double)multiply_limbs[s] * 19.26);
+        char * a_str = randomDigits(digits);
+        char * b_str = randomDigits(digits);
+        Rational a = { 0 }, b = { 0 }, schoolbook = { 0 }, karatsuba = { 0 };
+        parseExact(&pool, a_str, digits, &a);
+        parseExact(&pool, b_str, digits, &b);
+
+        const double schoolbook_ns = timeMultiply(&pool, &a, &b, &schoolbook, SIZE_MAX);
+        const double karatsuba_ns = timeMultiply(&pool, &a, &b, &karatsuba, threshold);
+        const bool same = schoolbook.num.count == karatsuba.num.count
+                       && memcmp(schoolbook.num.limbs, karatsuba.num.limbs, schoolbook.num.count * sizeof(uint64_t)) == 0;
+        printf("%-8zu %9zu %11.2f us %11.2f us %8.2fx%s\n", multiply_limbs[s], digits, schoolbook_ns / 1e3, karatsuba_ns / 1e3,
+               schoolbook_ns / karatsuba_ns, same ? "" : "  MISMATCH");
+
+        freeRational(&pool, &a);
+        freeRational(&pool, &b);
+        freeRational(&pool, &schoolbook);
+        freeRational(&pool, &karatsuba);
+        free(a_str);
+        free(b_str);
+    }
+    exact_karatsuba_threshold = threshold;
+    freeLimbPool(&pool);
+}
+
+// Sum of count prices with two decimals, the kind of input double rounds on every addition
+static char * decimalSum(size_t count) {
+    char * str = malloc(count * 16 + 1);
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t r = nextRandom();
+        len += (size_t)sprintf(str + len, "%s%llu.%02llu", i ? (r & 1 ? " + " : " - ") : "", (unsigned long long)(r >> 8) % 100000,
+                               (unsigned long long)(r >> 40) % 100);
+    }
+    return str;
+}
+
+// 1 + 1/2 + ... + 1/count, denominators grow with every term
+static char * harmonicSum(size_t count) {
+    char * str = malloc(count * 16 + 1);
+    size_t len = (size_t)sprintf(str, "1");
+    for (size_t i = 2; i <= count; i++) len += (size_t)sprintf(str + len, " + 1/%zu", i);
+    return str;
+}
+
+// Integer powers of thousands of digits that cancel down to a small result
+static char * bigPowers(size_t exponent) {
+    char * str = malloc(128);
+    sprintf(str, "3^%zu * 7^%zu - 21^%zu + (10^%zu + 1) / (10^%zu + 1)", exponent, exponent, exponent, exponent, exponent);
+    return str;
+}
+
+static void benchExpression(const char * name, char * expression) {
+    TokenVec tokens = createTokenVec();
+    NodeArena arena = createNodeArena();
+    LimbPool pool = createLimbPool();
+    Rational result = { 0 };
+    if (!tokenize(expression, &tokens) || createSyntaxTree(&arena, expression, &tokens) == NO_NODE) {
+        fprintf(stderr, "%s: %s", name, err_msg);
+        exit(1);
+    }
+    const NodeIndex root = (NodeIndex)(arena.count - 1);
+
+    long exact_runs = 0;
+    double start = nowNs();
+    double exact_ns;
+    do {
+        if (!calculateExact(&pool, &arena, root, expression, &tokens, NULL, &result)) {
+            fprintf(stderr, "%s: %s", name, err_msg);
+            exit(1);
+        }
+        exact_runs++;
+    } while ((exact_ns = nowNs() - start) < BENCH_MIN_NS);
+    exact_ns /= (double)exact_runs;
+
+    long double_runs = 0;
+    volatile double sink = 0;
+    double double_ns;
+    start = nowNs();
+    do {
+        double value;
+        calculateResult(&arena, root, NULL, &value);
+        sink = value;
+        double_runs++;
+    } while ((double_ns = nowNs() - start) < BENCH_MIN_NS);
+    double_ns /= (double)double_runs;
+    (void)sink;
+
+    char * str = exactToStr(&pool, &result);
+    const char * slash = strchr(str, '/');
+    const size_t digits = slash ? (size_t)(slash - str) : strlen(str);
+    const double reused = (double)pool.reused / (double)(pool.reused + pool.allocated);
+    printf("%-16s %8zu %12.2f us %12.2f us %9.0fx %10zu %9.1f%%\n", name, tokens.count, exact_ns / 1e3, double_ns / 1e3,
+           exact_ns / double_ns, digits, 100.0 * reused);
+
+    free(str);
+    freeRational(&pool, &result);
+    freeLimbPool(&pool);
+    freeNodeArena(arena);
+    freeTokenVec(tokens);
+    free(expression);
+}
+
+int main(void) {
+    benchMultiply();
+
+    printf("\n%-16s %8s %15s %15s %10s %10s %10s\n", "expression", "tokens", "exact", "double", "slowdown", "digits", "pooled");
+    benchExpression("prices_1k", decimalSum(1000));
+    benchExpression("prices_100k", decimalSum(100000));
+    benchExpression("harmonic_100", harmonicSum(100));
+    benchExpression("harmonic_1k", harmonicSum(1000));
+    benchExpression("powers_1k", bigPowers(1000));
+    benchExpression("powers_10k", bigPowers(10000));
+    return 0;
+}
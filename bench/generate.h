@@ -0,0 +1,157 @@
+// Seeded generator of syntactically valid expressions shared by the benchmarks,
+// the same random_state always produces the same expressions
+#ifndef __BENCH_GENERATE_H__
+#define __BENCH_GENERATE_H__
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+#define BENCH_REPEAT_POOL         8    // Parenthesized subexpressions an expression may repeat
+
+typedef enum LiteralKind {
+    LiteralIntegers = 0, // 42
+    LiteralDecimals,     // 3.25
+    LiteralScientific,   // 6.022e23
+    LiteralHex,          // 0xff
+    LiteralSeparators,   // 1_000_000
+    LiteralVariables,    // x, rate
+    LiteralMixed,
+} LiteralKind;
+
+enum { WeightPlus = 0, WeightMinus, WeightMult, WeightDiv, WeightPower, WeightCount };
+
+typedef struct Workload {
+    const char * name;
+    size_t tokens;                      // Approximate tokens per expression
+    size_t max_depth;                   // Parenthesis nesting limit
+    unsigned paren_percent;             // Chance of putting a subexpression into parentheses
+    unsigned negate_percent;            // Chance of a unary minus in front of an operand
+    bool right_leaning;                 // Nests to the right instead of splitting evenly, builds deep trees
+    unsigned weights[WeightCount];      // Relative frequency of + - * / ^
+    LiteralKind literals;
+    unsigned repeat_percent;            // Chance of repeating an earlier parenthesized subexpression verbatim
+} Workload;
+
+static const Workload workloads[] = {
+    {"small_mixed",      9,    4,   20, 5,  false, {4, 3, 4, 2, 1}, LiteralMixed, 0},
+    {"medium_mixed",     101,  16,  20, 5,  false, {4, 3, 4, 2, 1}, LiteralMixed, 0},
+    {"large_mixed",      2001, 32,  15, 5,  false, {4, 3, 4, 2, 1}, LiteralMixed, 0},
+    {"deep_nesting",     801,  400, 100, 0, true,  {1, 1, 1, 1, 0}, LiteralIntegers, 0},
+    {"additive_ints",    201,  0,   0,  0,  false, {1, 1, 0, 0, 0}, LiteralIntegers, 0},
+    {"power_heavy",      101,  8,   30, 0,  false, {1, 0, 2, 0, 3}, LiteralDecimals, 0},
+    {"scientific",       101,  8,   10, 5,  false, {2, 2, 2, 2, 0}, LiteralScientific, 0},
+    {"hex_separators",   101,  8,   10, 0,  false, {2, 2, 2, 1, 0}, LiteralHex, 0},
+    {"digit_separators", 101,  8,   10, 0,  false, {2, 2, 2, 1, 0}, LiteralSeparators, 0},
+    {"variables",        101,  8,   20, 5,  false, {4, 3, 4, 2, 1}, LiteralVariables, 0},
+    {"repeated_subterms", 501, 8,  40, 5,  false, {4, 3, 4, 2, 1}, LiteralVariables, 40},
+};
+
+#define WORKLOAD_COUNT (sizeof(workloads) / sizeof(workloads[0]))
+
+static const char * variable_names[] = {"x", "y", "z", "rate", "t0", "offset_2"};
+
+#define VARIABLE_NAME_COUNT (sizeof(variable_names) / sizeof(variable_names[0]))
+
+typedef struct CharBuf {
+    size_t count;
+    size_t capacity;
+    char * vals;
+} CharBuf;
+
+static uint64_t random_state;
+static CharBuf repeat_pool[BENCH_REPEAT_POOL];
+static size_t repeat_count;
+
+static uint64_t nextRandom(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+static void appendf(CharBuf * buf, const char * format, ...) __attribute__((format(printf, 2, 3)));
+
+static void appendf(CharBuf * buf, const char * format, ...) {
+    va_list args;
+    for (;;) {
+        va_start(args, format);
+        const int written = vsnprintf(buf->vals + buf->count, buf->capacity - buf->count, format, args);
+        va_end(args);
+        if (written >= 0 && (size_t)written < buf->capacity - buf->count) {
+            buf->count += (size_t)written;
+            return;
+        }
+        buf->capacity = buf->capacity * 2 + 64;
+        buf->vals = realloc(buf->vals, buf->capacity);
+        if (!buf->vals) {
+            fprintf(stderr, "Out of memory\n");
+            exit(-1);
+        }
+    }
+}
+
+static void generateLiteral(CharBuf * buf, LiteralKind kind) {
+    if (kind == LiteralMixed) kind = (LiteralKind)(nextRandom() % LiteralMixed);
+    const uint64_t r = nextRandom();
+    switch (kind) {
+        case LiteralIntegers:   appendf(buf, "%llu", (unsigned long long)(r % 1000)); break;
+        case LiteralDecimals:   appendf(buf, "%llu.%02llu", (unsigned long long)(r % 100), (unsigned long long)((r >> 16) % 100)); break;
+        case LiteralScientific: appendf(buf, "%llu.%03llue%d", (unsigned long long)(r % 10), (unsigned long long)((r >> 8) % 1000), (int)((r >> 24) % 41) - 20); break;
+        case LiteralHex:        appendf(buf, "0x%llx", (unsigned long long)(r % 0x10000)); break;
+        case LiteralSeparators: appendf(buf, "%llu_%03llu", (unsigned long long)(r % 1000 + 1), (unsigned long long)((r >> 16) % 1000)); break;
+        case LiteralVariables:  appendf(buf, "%s", variable_names[r % VARIABLE_NAME_COUNT]); break;
+        case LiteralMixed:      break;
+    }
+}
+
+static char pickOperator(const Workload * workload) {
+    static const char operator_chars[WeightCount] = {'+', '-', '*', '/', '^'};
+    unsigned total = 0;
+    for (int i = 0; i < WeightCount; i++) total += workload->weights[i];
+    unsigned pick = (unsigned)(nextRandom() % total);
+    for (int i = 0; i < WeightCount; i++) {
+        if (pick < workload->weights[i]) return operator_chars[i];
+        pick -= workload->weights[i];
+    }
+    return '+';
+}
+
+// Appends an expression of about budget tokens, every generated expression is syntactically valid
+static void generateExpression(CharBuf * buf, const Workload * workload, size_t budget, size_t depth) {
+    if (budget >= 3 && repeat_count && nextRandom() % 100 < workload->repeat_percent) {
+        const CharBuf * repeated = &repeat_pool[nextRandom() % repeat_count];
+        appendf(buf, "%.*s", (int)repeated->count, repeated->vals);
+        return;
+    }
+    if (budget < 3) {
+        if (nextRandom() % 100 < workload->negate_percent) appendf(buf, "-");
+        generateLiteral(buf, workload->literals);
+        return;
+    }
+    const bool parens = depth < workload->max_depth && nextRandom() % 100 < workload->paren_percent;
+    const size_t start = buf->count;
+    if (parens) {
+        appendf(buf, "(");
+        budget = budget > 4 ? budget - 2 : 3;
+        depth++;
+    }
+
+    const char operator = pickOperator(workload);
+    const size_t left = workload->right_leaning ? 1 : 1 + (size_t)(nextRandom() % (budget - 2));
+    generateExpression(buf, workload, left, depth);
+    appendf(buf, " %c ", operator);
+    // Small exponents keep most results finite
+    if (operator == '^') appendf(buf, "%s", nextRandom() % 2 ? "2" : "0.5");
+    else                 generateExpression(buf, workload, budget - left - 1, depth);
+
+    if (parens) appendf(buf, ")");
+    if (parens && workload->repeat_percent) {
+        CharBuf * pooled = &repeat_pool[repeat_count < BENCH_REPEAT_POOL ? repeat_count++ : nextRandom() % BENCH_REPEAT_POOL];
+        pooled->count = 0;
+        appendf(pooled, "%.*s", (int)(buf->count - start), buf->vals + start);
+    }
+}
+
+#endif // __BENCH_GENERATE_H__
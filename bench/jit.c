@@ -0,0 +1,98 @@
+// Compiles a seeded corpus of generated expressions to native code with every optimize mode, with and
+// without shared nodes, and checks every function with verifyJit against calculateResult.
+// Expressions too deep for native code are counted as skipped. Exits with 1 on any mismatch.
+// Usage: bench_jit [Seed] [Expressions per workload]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "syntax.h"
+#include "optimize.h"
+#include "vm.h"
+#include "jit.h"
+#include "generate.h"
+
+#define DEFAULT_SEED        1
+#define DEFAULT_EXPRESSIONS 32
+#define VERIFY_SAMPLES      64
+
+static const char * mode_names[] = { "none", "strict", "fast-math" };
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+typedef struct JitCounts {
+    size_t verified;
+    size_t skipped;
+    size_t mismatches;
+} JitCounts;
+
+// Parses expression again for one mode, compiles it down to native code and compares
+static void checkExpression(const char * expression, size_t len, OptimizeMode mode, bool share, TokenVec * tokens, NodeArena * arena, JitCounts * counts) {
+    tokens->count = 0;
+    resetNodeArena(arena);
+    arena->share_nodes = share;
+    NodeIndex root = NO_NODE;
+    Program program;
+    bool ok = tokenizeN(expression, len, tokens)
+           && (root = createSyntaxTree(arena, expression, tokens)) != NO_NODE
+           && (mode == OptimizeNone || optimizeSyntaxTree(arena, &root, mode == OptimizeFastMath, NULL));
+    if (!ok || !compileProgram(arena, root, &program)) {
+        fprintf(stderr, "%sin generated expression >%.80s<\n", err_msg, expression);
+        exit(-1);
+    }
+
+    JitCode jit;
+    if (!compileJit(&program, &jit)) {
+        counts->skipped++;
+    } else if (verifyJit(&jit, arena, root, VERIFY_SAMPLES)) {
+        counts->verified++;
+    } else {
+        fprintf(stderr, "Mismatch with optimize %s%s: %sin generated expression >%.80s<\n", mode_names[mode], share ? " and shared nodes" : "", err_msg, expression);
+        counts->mismatches++;
+    }
+    freeJit(jit);
+    freeProgram(program);
+}
+
+int main(int argc, char * argv[]) {
+    const uint64_t seed = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_SEED;
+    const size_t expression_count = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_EXPRESSIONS;
+    if (!expression_count) {
+        fprintf(stderr, "Usage: %s [Seed] [Expressions per workload]\n", argv[0]);
+        return 1;
+    }
+
+    CharBuf expression = { 0 };
+    TokenVec tokens = createTokenVec();
+    NodeArena arena = createNodeArena();
+    JitCounts counts = { 0 };
+    const double start = nowNs();
+    for (size_t w = 0; w < WORKLOAD_COUNT; w++) {
+        // Same corpus as bench_mathlang with the same seed
+        random_state = (seed + w + 1) * 0x9e3779b97f4a7c15u;
+        for (size_t e = 0; e < expression_count; e++) {
+            expression.count = 0;
+            repeat_count = 0;
+            generateExpression(&expression, &workloads[w], workloads[w].tokens, 0);
+            for (int mode = OptimizeNone; mode <= OptimizeFastMath; mode++) {
+                checkExpression(expression.vals, expression.count, (OptimizeMode)mode, false, &tokens, &arena, &counts);
+                checkExpression(expression.vals, expression.count, (OptimizeMode)mode, true, &tokens, &arena, &counts);
+            }
+        }
+    }
+    const double elapsed = nowNs() - start;
+
+    printf("Verified %zu native functions on %zu inputs each in %.1f ms, %zu too deep or unsupported\n",
+           counts.verified, (size_t)VERIFY_SAMPLES, elapsed / 1e6, counts.skipped);
+    printf("%zu mismatches\n", counts.mismatches);
+    for (size_t i = 0; i < BENCH_REPEAT_POOL; i++) free(repeat_pool[i].vals);
+    free(expression.vals);
+    freeNodeArena(arena);
+    freeTokenVec(tokens);
+    return counts.mismatches ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+// Replays typing sessions on long formulas with the live mode and compares every keystroke
+// against tokenizing, parsing and calculating the whole text again, both in time and in result.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "syntax.h"
+#include "live.h"
+
+#define BENCH_KEYSTROKES   20000
+#define BENCH_MAX_INVALID  8  // Keystrokes an expression may stay broken before it is restored
+
+static const size_t formula_sizes[] = {1 << 10, 8 << 10, 64 << 10};
+static const char * snippets[] = {" + 3.5 * x", " - (y / 2)", " * 1.25", " + 0x1f", " - 2e-3 * (x + y)", " / 4", " + x ^ 2"};
+
+#define SIZE_COUNT    (sizeof(formula_sizes) / sizeof(formula_sizes[0]))
+#define SNIPPET_COUNT (sizeof(snippets) / sizeof(snippets[0]))
+
+static uint64_t random_state = 0x9e3779b97f4a7c15u;
+
+static uint64_t nextRandom(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int compareDoubles(const void * a, const void * b) {
+    const double left = *(const double *)a;
+    const double right = *(const double *)b;
+    return (left > right) - (left < right);
+}
+
+// Terms like (12.5 * x - 3) / 7 joined by + and -
+static char * generateFormula(size_t size) {
+    char * formula = malloc(size + 64);
+    size_t len = 0;
+    while (len < size) {
+        const uint64_t r = nextRandom();
+        len += (size_t)snprintf(formula + len, 64, "%s(%llu.%llu * %s - %llu) / %llu", len ? (r & 1 ? " + " : " - ") : "",
+                                (unsigned long long)(r % 100), (unsigned long long)((r >> 8) % 10), (r >> 12) & 1 ? "x" : "y",
+                                (unsigned long long)((r >> 16) % 50), (unsigned long long)((r >> 24) % 9 + 1));
+    }
+    return formula;
+}
+
+typedef struct FullPipeline {
+    TokenVec tokens;
+    NodeArena arena;
+    double variables[2];
+} FullPipeline;
+
+static bool calculateFull(FullPipeline * full, const char * text, size_t len, const StrVec * names, const double * values, double * result) {
+    full->tokens.count = 0;
+    resetNodeArena(&full->arena);
+    if (!tokenizeN(text, len, &full->tokens)) return false;
+    const NodeIndex root = createSyntaxTree(&full->arena, text, &full->tokens);
+    return root != NO_NODE && bindVariables(&full->arena.variables, names, values, full->variables)
+        && calculateResult(&full->arena, root, full->variables, result);
+}
+
+int main(void) {
+    StrVec names = createStrVec();
+    appendStrVec(&names, "x");
+    appendStrVec(&names, "y");
+    const double values[] = {1.5, -0.75};
+
+    double * live_ns = malloc(BENCH_KEYSTROKES * sizeof(double));
+    double * full_ns = malloc(BENCH_KEYSTROKES * sizeof(double));
+    FullPipeline full = { .tokens = createTokenVec(), .arena = createNodeArena() };
+
+    printf("%-10s %12s %12s %12s %12s %9s %9s %10s\n", "formula", "live p50", "live p99", "full p50", "full p99", "speedup", "valid", "mismatch");
+    for (size_t s = 0; s < SIZE_COUNT; s++) {
+        char * formula = generateFormula(formula_sizes[s]);
+        LiveExpression live = createLiveExpression(&names, values);
+        editLiveExpression(&live, 0, 0, formula, strlen(formula));
+
+        size_t mismatches = 0;
+        size_t valid = 0;
+        size_t invalid_run = 0;
+        const char * typing = NULL; // Rest of the snippet being typed
+        size_t deleting = 0;        // Characters left to delete with backspace
+        size_t cursor = live.len;
+        for (size_t k = 0; k < BENCH_KEYSTROKES; k++) {
+            if (invalid_run > BENCH_MAX_INVALID) {
+                editLiveExpression(&live, 0, live.len, formula, strlen(formula));
+                invalid_run = 0;
+                typing = NULL;
+                deleting = 0;
+            }
+            if (!typing && !deleting) {
+                const uint64_t r = nextRandom();
+                cursor = (size_t)((r >> 8) % (live.len + 1));
+                if (r % 4 == 0 && cursor) {
+                    deleting = 1 + (r >> 40) % 6;
+                    if (deleting > cursor) deleting = cursor;
+                } else if (r % 4 <= 1) {
+                    // Types a digit into a number
+                    while (cursor < live.len && !(cursor && live.text[cursor - 1] >= '0' && live.text[cursor - 1] <= '9')) cursor++;
+                    typing = "7";
+                } else {
+                    // Snippets are typed where a term ends
+                    while (cursor < live.len && live.text[cursor] != ' ') cursor++;
+                    typing = snippets[(r >> 32) % SNIPPET_COUNT];
+                }
+            }
+
+            double start = nowNs();
+            bool live_valid;
+            if (deleting) {
+                live_valid = editLiveExpression(&live, --cursor, 1, "", 0);
+                deleting--;
+            } else {
+                live_valid = editLiveExpression(&live, cursor++, 0, typing, 1);
+                typing = *++typing ? typing : NULL;
+            }
+            live_ns[k] = nowNs() - start;
+
+            double result = 0;
+            start = nowNs();
+            const bool full_valid = calculateFull(&full, live.text, live.len, &names, values, &result);
+            full_ns[k] = nowNs() - start;
+
+            if (live_valid != full_valid || (live_valid && memcmp(&result, &live.result, sizeof(double)) != 0)) {
+                if (!mismatches) fprintf(stderr, "Mismatch on >%.*s<: live %s %.17g, full %s %.17g\n", (int)live.len, live.text,
+                                         live_valid ? "valid" : "invalid", live.result, full_valid ? "valid" : "invalid", result);
+                mismatches++;
+            }
+            valid += live_valid;
+            invalid_run = live_valid ? 0 : invalid_run + 1;
+        }
+
+        qsort(live_ns, BENCH_KEYSTROKES, sizeof(double), compareDoubles);
+        qsort(full_ns, BENCH_KEYSTROKES, sizeof(double), compareDoubles);
+        const double live_p50 = live_ns[BENCH_KEYSTROKES / 2] / 1e3;
+        const double full_p50 = full_ns[BENCH_KEYSTROKES / 2] / 1e3;
+        printf("%7zu KB %9.2f us %9.2f us %9.2f us %9.2f us %8.1fx %8.1f%% %10zu\n", formula_sizes[s] >> 10, live_p50,
+               live_ns[BENCH_KEYSTROKES * 99 / 100] / 1e3, full_p50, full_ns[BENCH_KEYSTROKES * 99 / 100] / 1e3,
+               full_p50 / live_p50, 100.0 * (double)valid / BENCH_KEYSTROKES, mismatches);
+
+        freeLiveExpression(live);
+        free(formula);
+    }
+
+    freeTokenVec(full.tokens);
+    freeNodeArena(full.arena);
+    freeStrVec(names);
+    free(live_ns);
+    free(full_ns);
+    return 0;
+}
@@ -0,0 +1,221 @@
+// Load generator for mathlang --serve. Every connection runs on its own thread and keeps
+// up to pipeline requests in flight, latency is measured from sending a request to its response.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define LOADGEN_DEFAULT_CONNECTIONS 8
+#define LOADGEN_DEFAULT_REQUESTS    20000 // Per connection
+#define LOADGEN_DEFAULT_PIPELINE    16
+#define LOADGEN_EXPRESSIONS         256   // Distinct expressions the requests cycle through
+#define LOADGEN_MAX_EXPRESSION      64
+#define LOADGEN_READ_SIZE           (1 << 16)
+
+typedef struct LoadConnection {
+    const char * socket_path;
+    size_t requests;
+    size_t pipeline;
+    size_t offset;        // First expression this connection sends
+    double * latencies;   // ns per request
+    size_t errors;
+    bool failed;
+    pthread_t thread;
+} LoadConnection;
+
+static char expressions[LOADGEN_EXPRESSIONS][LOADGEN_MAX_EXPRESSION];
+static size_t expression_lengths[LOADGEN_EXPRESSIONS];
+
+static uint64_t random_state = 0x2545f4914f6cdd1du;
+
+static uint64_t nextRandom(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void generateExpressions(void) {
+    for (size_t i = 0; i < LOADGEN_EXPRESSIONS; i++) {
+        const uint64_t r = nextRandom();
+        const int len = snprintf(expressions[i], LOADGEN_MAX_EXPRESSION, "(%llu.%llu + %llu) * %llu - %llu / %llu ^ 2\n",
+                                 (unsigned long long)(r % 1000), (unsigned long long)((r >> 10) % 100), (unsigned long long)((r >> 17) % 50),
+                                 (unsigned long long)((r >> 23) % 20), (unsigned long long)((r >> 28) % 1000), (unsigned long long)((r >> 38) % 9 + 1));
+        expression_lengths[i] = (size_t)len;
+    }
+}
+
+static bool writeAll(int fd, const char * data, size_t len) {
+    size_t written = 0;
+    while (written < len) {
+        const ssize_t n = write(fd, data + written, len - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += (size_t)n;
+    }
+    return true;
+}
+
+static void * runConnection(void * arg) {
+    LoadConnection * connection = arg;
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    strncpy(address.sun_path, connection->socket_path, sizeof(address.sun_path) - 1);
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        fprintf(stderr, "Could not connect to >%s<: %s\n", connection->socket_path, strerror(errno));
+        if (fd >= 0) close(fd);
+        connection->failed = true;
+        return NULL;
+    }
+
+    double * sent_at = malloc(connection->pipeline * sizeof(double));
+    char * out = malloc(connection->pipeline * LOADGEN_MAX_EXPRESSION);
+    char * in = malloc(LOADGEN_READ_SIZE);
+    if (!sent_at || !out || !in) {
+        connection->failed = true;
+        goto done;
+    }
+
+    size_t sent = 0;
+    size_t received = 0;
+    size_t in_count = 0;
+    while (received < connection->requests) {
+        size_t out_count = 0;
+        const double now = nowNs();
+        while (sent < connection->requests && sent - received < connection->pipeline) {
+            const size_t e = (connection->offset + sent) % LOADGEN_EXPRESSIONS;
+            memcpy(out + out_count, expressions[e], expression_lengths[e]);
+            out_count += expression_lengths[e];
+            sent_at[sent % connection->pipeline] = now;
+            sent++;
+        }
+        if (out_count && !writeAll(fd, out, out_count)) {
+            connection->failed = true;
+            break;
+        }
+
+        const ssize_t n = read(fd, in + in_count, LOADGEN_READ_SIZE - in_count);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            fprintf(stderr, "Server closed the connection after %zu responses\n", received);
+            connection->failed = true;
+            break;
+        }
+        in_count += (size_t)n;
+        const double arrived = nowNs();
+        size_t pos = 0;
+        const char * newline;
+        while ((newline = memchr(in + pos, '\n', in_count - pos))) {
+            if (strncmp(in + pos, "error", 5) == 0) connection->errors++;
+            connection->latencies[received] = arrived - sent_at[received % connection->pipeline];
+            received++;
+            pos = (size_t)(newline - in) + 1;
+        }
+        memmove(in, in + pos, in_count - pos);
+        in_count -= pos;
+    }
+
+done:
+    free(sent_at);
+    free(out);
+    free(in);
+    close(fd);
+    return NULL;
+}
+
+static int compareDoubles(const void * a, const void * b) {
+    const double left = *(const double *)a;
+    const double right = *(const double *)b;
+    return (left > right) - (left < right);
+}
+
+static double percentile(const double * sorted, size_t count, double fraction) {
+    size_t rank = (size_t)((double)count * fraction + 0.999999);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+int main(int argc, char * argv[]) {
+    const char * socket_path = NULL;
+    size_t connection_count = LOADGEN_DEFAULT_CONNECTIONS;
+    size_t requests = LOADGEN_DEFAULT_REQUESTS;
+    size_t pipeline = LOADGEN_DEFAULT_PIPELINE;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc) {
+            connection_count = (size_t)strtoul(argv[++i], NULL, 10);
+            continue;
+        }
+        if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc) {
+            requests = (size_t)strtoul(argv[++i], NULL, 10);
+            continue;
+        }
+        if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) {
+            pipeline = (size_t)strtoul(argv[++i], NULL, 10);
+            continue;
+        }
+        socket_path = argv[i];
+    }
+    if (!socket_path || !connection_count || !requests || !pipeline) {
+        fprintf(stderr, "Usage: %s [--connections N] [--requests PerConnection] [--pipeline InFlight] SocketPath\n", argv[0]);
+        return -1;
+    }
+
+    generateExpressions();
+    LoadConnection * connections = calloc(connection_count, sizeof(LoadConnection));
+    double * latencies = malloc(connection_count * requests * sizeof(double));
+    if (!connections || !latencies) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+
+    const double start = nowNs();
+    for (size_t i = 0; i < connection_count; i++) {
+        connections[i] = (LoadConnection) {
+            .socket_path = socket_path,
+            .requests = requests,
+            .pipeline = pipeline,
+            .offset = i * 7,
+            .latencies = latencies + i * requests,
+        };
+        if (pthread_create(&connections[i].thread, NULL, runConnection, &connections[i]) != 0) {
+            fprintf(stderr, "Could not start connection %zu\n", i);
+            return -1;
+        }
+    }
+    size_t errors = 0;
+    bool failed = false;
+    for (size_t i = 0; i < connection_count; i++) {
+        pthread_join(connections[i].thread, NULL);
+        errors += connections[i].errors;
+        failed = failed || connections[i].failed;
+    }
+    const double elapsed = nowNs() - start;
+    if (failed) return -1;
+
+    const size_t total = connection_count * requests;
+    qsort(latencies, total, sizeof(double), compareDoubles);
+    printf("%zu requests on %zu connections, %zu in flight per connection, %zu errors\n", total, connection_count, pipeline, errors);
+    printf("throughput: %.0f requests/s\n", (double)total / elapsed * 1e9);
+    printf("latency: p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+           percentile(latencies, total, 0.5) / 1e3, percentile(latencies, total, 0.9) / 1e3, percentile(latencies, total, 0.99) / 1e3,
+           percentile(latencies, total, 0.999) / 1e3, latencies[total - 1] / 1e3);
+
+    free(latencies);
+    free(connections);
+    return 0;
+}
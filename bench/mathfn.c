@@ -0,0 +1,203 @@
+// Measures the error of the elementary functions of mathfn.c against long double libm, checks special
+// values against double libm and that every instruction set returns the bits of the scalar kernels,
+// then reports the throughput of every function per instruction set next to libm.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+
+#include "mathfn.h"
+
+#define BENCH_SAMPLES (1 << 20)
+#define BENCH_RUNS    5
+
+typedef struct BenchFunction {
+    const char * name;
+    double (*scalar)(double);
+    double (*libm)(double);
+    long double (*reference)(long double);
+    size_t offset; // Offset of the array function inside MathKernels
+    double (*generate)(uint64_t random);
+} BenchFunction;
+
+static const char * isa_names[] = {"scalar", "sse2", "avx2", "avx512"};
+#define ISA_COUNT (sizeof(isa_names) / sizeof(isa_names[0]))
+
+static const double specials[] = {0.0, -0.0, 1.0, -1.0, 0.5, INFINITY, -INFINITY, NAN, 4.9e-324, -4.9e-324, 2.2250738585072014e-308,
+                                  1e-300, 1e300, -1e300, 709.782712893384, 709.79, 710, -708.4, -745.1, -746, 1.5707963267948966,
+                                  3.141592653589793, 1048576, 1048577, 1e22, -1e22, 0x1p1023, -0x1p-1022};
+
+static uint64_t random_state = 0x9e3779b97f4a7c15u;
+
+static uint64_t nextRandom(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+// Uniform in [lo, hi)
+static double uniform(uint64_t random, double lo, double hi) {
+    return lo + (hi - lo) * (double)(random >> 11) * 0x1p-53;
+}
+
+// Whole range of exp, every eighth sample close to 0 where the result is close to 1
+static double generateExp(uint64_t random) {
+    return random & 7 ? uniform(random, -745.0, 709.78) : uniform(random, -0.5, 0.5);
+}
+
+// Random bits of a positive double, including subnormals, every eighth sample close to 1
+static double generateLog(uint64_t random) {
+    if (!(random & 7)) return uniform(random, 0.75, 1.5);
+    uint64_t bits = (random >> 1) % 0x7ff0000000000000u;
+    double x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+// Range of the kernels, every eighth sample within a few periods
+static double generateTrig(uint64_t random) {
+    return random & 7 ? uniform(random, -0x1p20, 0x1p20) : uniform(random, -10.0, 10.0);
+}
+
+static const BenchFunction functions[] = {
+    {"exp", mathExp, exp, expl, offsetof(MathKernels, exp), generateExp},
+    {"log", mathLog, log, logl, offsetof(MathKernels, log), generateLog},
+    {"sin", mathSin, sin, sinl, offsetof(MathKernels, sin), generateTrig},
+    {"cos", mathCos, cos, cosl, offsetof(MathKernels, cos), generateTrig},
+};
+#define FUNCTION_COUNT (sizeof(functions) / sizeof(functions[0]))
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static MathArrayFunction arrayFunction(const MathKernels * kernels, const BenchFunction * function) {
+    MathArrayFunction array;
+    memcpy(&array, (const char *)kernels + function->offset, sizeof(array));
+    return array;
+}
+
+// Error of y in units in the last place of the correctly rounded result, infinite if only one of both is finite
+static double ulpError(double y, long double reference) {
+    if (isnan(y) || isnan(reference)) return isnan(y) && isnan(reference) ? 0 : INFINITY;
+    if (isinf(y) || isinfl(reference)) {
+        if ((long double)y == reference) return 0;
+        // An overflow right at the largest double may still be within one place
+        if (!isinf(y) || fabsl(reference) < 0x1p1024L) return (double)(fabsl((long double)y - reference) / 0x1p971L);
+        return INFINITY;
+    }
+    int exponent;
+    frexpl(reference, &exponent);
+    if (exponent < -1021) exponent = -1021;
+    return (double)(fabsl((long double)y - reference) / ldexpl(1.0L, exponent - 53));
+}
+
+static bool sameBits(double a, double b) {
+    if (isnan(a) || isnan(b)) return isnan(a) && isnan(b);
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// Zeros, infinities and nan have to be exactly those of libm, other results within one place of it
+static size_t checkSpecials(const BenchFunction * function) {
+    size_t failures = 0;
+    for (size_t i = 0; i < sizeof(specials) / sizeof(specials[0]); i++) {
+        const double x = specials[i];
+        const double ours = function->scalar(x);
+        const double libm = function->libm(x);
+        const bool exact = isnan(libm) || isinf(libm) || libm == 0;
+        if (exact ? sameBits(ours, libm) : ulpError(ours, function->reference(x)) <= 1.0) continue;
+        if (!failures) fprintf(stderr, "%s(%.17g) is %.17g, libm %.17g\n", function->name, x, ours, libm);
+        failures++;
+    }
+    return failures;
+}
+
+int main(void) {
+    double * inputs = malloc(BENCH_SAMPLES * sizeof(double));
+    double * outputs = malloc(BENCH_SAMPLES * sizeof(double));
+    double * scalar = malloc(BENCH_SAMPLES * sizeof(double));
+    if (!inputs || !outputs || !scalar) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    const MathKernels * kernels[ISA_COUNT];
+    for (size_t k = 0; k < ISA_COUNT; k++) kernels[k] = findMathKernels(isa_names[k]);
+
+    printf("%-8s %10s %10s %24s %9s %10s\n", "function", "max ulp", "libm ulp", "worst input", "specials", "identical");
+    for (size_t f = 0; f < FUNCTION_COUNT; f++) {
+        const BenchFunction * function = &functions[f];
+        for (size_t i = 0; i < BENCH_SAMPLES; i++) inputs[i] = function->generate(nextRandom());
+
+        double max_ulp = 0;
+        double max_libm_ulp = 0;
+        double worst = 0;
+        for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+            const long double reference = function->reference(inputs[i]);
+            scalar[i] = function->scalar(inputs[i]);
+            const double ulp = ulpError(scalar[i], reference);
+            const double libm_ulp = ulpError(function->libm(inputs[i]), reference);
+            if (ulp > max_ulp) {
+                max_ulp = ulp;
+                worst = inputs[i];
+            }
+            if (libm_ulp > max_libm_ulp) max_libm_ulp = libm_ulp;
+        }
+
+        // Every instruction set has to return the bits of mathExp and friends
+        size_t identical = 0;
+        size_t available = 0;
+        for (size_t k = 0; k < ISA_COUNT; k++) {
+            if (!kernels[k]) continue;
+            available++;
+            arrayFunction(kernels[k], function)(outputs, inputs, BENCH_SAMPLES);
+            size_t mismatches = 0;
+            for (size_t i = 0; i < BENCH_SAMPLES; i++) mismatches += !sameBits(outputs[i], scalar[i]);
+            if (mismatches) fprintf(stderr, "%s %s differs from the scalar kernel in %zu results\n", isa_names[k], function->name, mismatches);
+            identical += !mismatches;
+        }
+
+        const size_t failures = checkSpecials(function);
+        printf("%-8s %10.3f %10.3f %24.17g %9s %6zu / %zu\n", function->name, max_ulp, max_libm_ulp, worst,
+               failures ? "FAIL" : "ok", identical, available);
+    }
+
+    printf("\n%-8s %-8s %12s %12s %10s\n", "function", "isa", "ns/element", "Melements/s", "vs libm");
+    for (size_t f = 0; f < FUNCTION_COUNT; f++) {
+        const BenchFunction * function = &functions[f];
+        for (size_t i = 0; i < BENCH_SAMPLES; i++) inputs[i] = function->generate(nextRandom());
+
+        double libm_ns = INFINITY;
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            const double start = nowNs();
+            for (size_t i = 0; i < BENCH_SAMPLES; i++) outputs[i] = function->libm(inputs[i]);
+            const double ns = (nowNs() - start) / BENCH_SAMPLES;
+            if (ns < libm_ns) libm_ns = ns;
+        }
+        printf("%-8s %-8s %12.2f %12.1f %9.2fx\n", function->name, "libm", libm_ns, 1e3 / libm_ns, 1.0);
+
+        for (size_t k = 0; k < ISA_COUNT; k++) {
+            if (!kernels[k]) continue;
+            const MathArrayFunction array = arrayFunction(kernels[k], function);
+            double best = INFINITY;
+            for (int run = 0; run < BENCH_RUNS; run++) {
+                const double start = nowNs();
+                array(outputs, inputs, BENCH_SAMPLES);
+                const double ns = (nowNs() - start) / BENCH_SAMPLES;
+                if (ns < best) best = ns;
+            }
+            printf("%-8s %-8s %12.2f %12.1f %9.2fx\n", function->name, isa_names[k], best, 1e3 / best, libm_ns / best);
+        }
+    }
+
+    free(inputs);
+    free(outputs);
+    free(scalar);
+    return 0;
+}
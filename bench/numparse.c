@@ -0,0 +1,129 @@
+// Compares parseNumber with strtod on token streams like the ones expressions contain.
+// Every stream holds the same numbers for both parsers, strtod gets them without digit separators.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "number.h"
+
+#define BENCH_NUMBERS 200000
+#define BENCH_ROUNDS  20
+
+typedef enum StreamKind {
+    StreamIntegers = 0, // 42, 1024
+    StreamDecimals,     // 3.25, 1234.56
+    StreamScientific,   // 6.022e23, 1e-9
+    StreamRoundTrip,    // %.17g of random doubles
+    StreamSeparators,   // 1_000_000
+    StreamHex,          // 0xff
+    StreamMixed,
+    StreamKindCount,
+} StreamKind;
+
+static const char * stream_names[StreamKindCount] = {"integers", "decimals", "scientific", "round trip", "separators", "hex", "mixed"};
+
+static uint64_t random_state = 0x853c49e6748fea9bu;
+
+static uint64_t nextRandom(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int writeNumber(char * buf, size_t size, StreamKind kind) {
+    if (kind == StreamMixed) kind = (StreamKind)(nextRandom() % StreamMixed);
+    const uint64_t r = nextRandom();
+    switch (kind) {
+        case StreamIntegers:   return snprintf(buf, size, "%llu", (unsigned long long)(r % 10000));
+        case StreamDecimals:   return snprintf(buf, size, "%llu.%0*llu", (unsigned long long)(r % 10000), (int)(1 + (r >> 20) % 4), (unsigned long long)((r >> 32) % 10000));
+        case StreamScientific: return snprintf(buf, size, "%.*fe%d", (int)(r % 4), (double)(r >> 40) / 1e6, (int)((r >> 8) % 61) - 30);
+        case StreamRoundTrip:  return snprintf(buf, size, "%.17g", (double)(r >> 11) / (double)(1ull << 53) * 1000.0);
+        case StreamSeparators: return snprintf(buf, size, "%llu_%03llu_%03llu", (unsigned long long)(r % 1000), (unsigned long long)((r >> 10) % 1000), (unsigned long long)((r >> 20) % 1000));
+        case StreamHex:        return snprintf(buf, size, "0x%llx", (unsigned long long)(r >> (r % 48)));
+        default:               return 0;
+    }
+}
+
+int main(void) {
+    char * text = malloc((size_t)BENCH_NUMBERS * 64);
+    char * plain = malloc((size_t)BENCH_NUMBERS * 64);
+    size_t * offsets = malloc(BENCH_NUMBERS * sizeof(size_t));
+    size_t * lengths = malloc(BENCH_NUMBERS * sizeof(size_t));
+    if (!text || !plain || !offsets || !lengths) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+
+    printf("%-12s %14s %14s %10s %10s\n", "stream", "parseNumber", "strtod", "speedup", "mismatch");
+    for (int kind = 0; kind < StreamKindCount; kind++) {
+        size_t size = 0;
+        size_t plain_size = 0;
+        for (size_t i = 0; i < BENCH_NUMBERS; i++) {
+            offsets[i] = size;
+            lengths[i] = (size_t)writeNumber(text + size, 64, (StreamKind)kind);
+            for (size_t j = 0; j < lengths[i]; j++) {
+                if (text[size + j] != '_') plain[plain_size++] = text[size + j];
+            }
+            plain[plain_size++] = ' ';
+            size += lengths[i];
+            text[size++] = ' ';
+        }
+
+        double parse_best = 1e300;
+        double strtod_best = 1e300;
+        size_t mismatches = 0;
+        double sink = 0;
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            double start = nowNs();
+            for (size_t i = 0; i < BENCH_NUMBERS; i++) {
+                double value;
+                parseNumber(text + offsets[i], lengths[i], &value);
+                sink += value;
+            }
+            const double parse_ns = nowNs() - start;
+
+            // strtod stops at the space behind every number
+            start = nowNs();
+            const char * current = plain;
+            for (size_t i = 0; i < BENCH_NUMBERS; i++) {
+                char * end;
+                sink -= strtod(current, &end);
+                current = end + 1;
+            }
+            const double strtod_ns = nowNs() - start;
+            if (parse_ns < parse_best) parse_best = parse_ns;
+            if (strtod_ns < strtod_best) strtod_best = strtod_ns;
+        }
+
+        const char * current = plain;
+        for (size_t i = 0; i < BENCH_NUMBERS; i++) {
+            char * end;
+            double value;
+            const double expected = strtod(current, &end);
+            current = end + 1;
+            if (parseNumber(text + offsets[i], lengths[i], &value) != lengths[i] || memcmp(&value, &expected, sizeof(double))) mismatches++;
+        }
+
+        // Keeps both loops from being optimized away
+        volatile double keep = sink;
+        (void)keep;
+
+        printf("%-12s %9.2f ns/n %9.2f ns/n %9.2fx %10zu\n", stream_names[kind],
+               parse_best / BENCH_NUMBERS, strtod_best / BENCH_NUMBERS, strtod_best / parse_best, mismatches);
+    }
+
+    free(text);
+    free(plain);
+    free(offsets);
+    free(lengths);
+    return 0;
+}
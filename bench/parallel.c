@@ -0,0 +1,104 @@
+// Evaluates a machine generated sum and product of many terms with calculateResult and with
+// calculateResultParallel on a growing number of threads. The sum cancels heavily, its error is measured
+// against a sum in higher precision. Every thread count has to give the same result.
+// Usage: bench_parallel [Terms]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "syntax.h"
+#include "parallel.h"
+#include "mathfn.h"
+
+#define DEFAULT_TERMS 4000000
+
+#ifdef __SIZEOF_FLOAT128__
+typedef __float128 Reference;
+#else
+typedef long double Reference;
+#endif
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Sum of terms like sin(1.25) * 3.5e7 whose large parts cancel in pairs, reference gets the exact sum
+static char * writeSum(size_t terms, Reference * reference) {
+    char * text = malloc(terms * 40 + 1);
+    size_t len = 0;
+    *reference = 0;
+    for (size_t i = 0; i < terms; i++) {
+        const double scale = i % 2 ? 1e8 : 1e-3;
+        const int len_i = sprintf(text + len, "%ssin(%zu.25) * %.17g", !i ? "" : i % 4 == 3 ? " - " : " + ", i % 1000, scale * (double)(i % 7 + 1));
+        double term = mathSin((double)(i % 1000) + 0.25) * (scale * (double)(i % 7 + 1));
+        *reference += i && i % 4 == 3 ? -(Reference)term : (Reference)term;
+        len += (size_t)len_i;
+    }
+    text[len] = '\0';
+    return text;
+}
+
+// Product of factors close to one
+static char * writeProduct(size_t terms, Reference * reference) {
+    char * text = malloc(terms * 24 + 1);
+    size_t len = 0;
+    *reference = 1;
+    for (size_t i = 0; i < terms; i++) {
+        const double factor = 1 + (double)((long)((i * 7919) % 2001) - 1000) * 1e-7;
+        len += (size_t)sprintf(text + len, "%s%.17g", i ? " * " : "", factor);
+        *reference *= factor;
+    }
+    text[len] = '\0';
+    return text;
+}
+
+static void benchExpression(const char * name, char * text, Reference reference) {
+    TokenVec tokens = createTokenVec();
+    NodeArena arena = createNodeArena();
+    NodeIndex root;
+    if (!tokenize(text, &tokens) || (root = createSyntaxTree(&arena, text, &tokens)) == NO_NODE) {
+        fprintf(stderr, "%s", err_msg);
+        exit(1);
+    }
+
+    double start = nowNs();
+    double serial;
+    calculateResult(&arena, root, NULL, &serial);
+    const double serial_ns = nowNs() - start;
+    printf("%-8s %8s %12.2f %14.3e %24.17g\n", name, "serial", serial_ns / 1e6, fabs((double)(((Reference)serial - reference) / reference)), serial);
+
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    double first = 0;
+    for (size_t threads = 1; threads <= (size_t)(cpus > 0 ? cpus : 1) * 2; threads *= 2) {
+        double result;
+        ParallelStats stats;
+        start = nowNs();
+        calculateResultParallel(&arena, root, NULL, threads, &result, &stats);
+        const double ns = nowNs() - start;
+        if (threads == 1) first = result;
+        char label[32];
+        snprintf(label, sizeof(label), "%zu thr", stats.threads);
+        printf("%-8s %8s %12.2f %14.3e %24.17g%s\n", name, label, ns / 1e6, fabs((double)(((Reference)result - reference) / reference)), result,
+               memcmp(&result, &first, sizeof(double)) ? " DIFFERS" : "");
+    }
+
+    freeTokenVec(tokens);
+    freeNodeArena(arena);
+    free(text);
+}
+
+int main(int argc, char * argv[]) {
+    const size_t terms = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_TERMS;
+    printf("%-8s %8s %12s %14s %24s\n", "chain", "path", "ms", "rel. error", "result");
+    Reference reference;
+    char * text = writeSum(terms, &reference);
+    benchExpression("sum", text, reference);
+    text = writeProduct(terms, &reference);
+    benchExpression("product", text, reference);
+    return 0;
+}
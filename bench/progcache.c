@@ -0,0 +1,120 @@
+// Writes a library of machine generated formulas, builds a program cache of it and compares compiling
+// every formula from its text with mapping the cache and looking every formula up. Both programs of
+// every formula are run and have to give the same result.
+// Usage: bench_progcache [Formulas]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "progcache.h"
+#include "syntax.h"
+
+#define DEFAULT_FORMULAS 20000
+#define LIBRARY_PATH     "bench_progcache.lib"
+#define CACHE_PATH       "bench_progcache.mlc"
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Formula i, a few dozen tokens of operators, functions and the variables x and y
+static int writeFormula(char * buf, size_t size, size_t i) {
+    return snprintf(buf, size, "sqrt(x * %zu.5 + y ^ 2) - (%zu + x) * (y - %zu) / %zu.25 + exp(-x / %zu) * cos(y + %zu) - log(%zu + x * y)",
+                    i % 97, i, i % 13, i % 7 + 1, i % 31 + 1, i % 17, i + 1);
+}
+
+int main(int argc, char * argv[]) {
+    const size_t formulas = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_FORMULAS;
+    FILE * fp = fopen(LIBRARY_PATH, "w");
+    if (!fp) {
+        fprintf(stderr, "Could not open file >%s<\n", LIBRARY_PATH);
+        return 1;
+    }
+    char formula[512];
+    for (size_t i = 0; i < formulas; i++) {
+        writeFormula(formula, sizeof(formula), i);
+        fprintf(fp, "%s\n", formula);
+    }
+    fclose(fp);
+
+    const double build_start = nowNs();
+    if (buildProgramCache(LIBRARY_PATH, CACHE_PATH, OptimizeStrict, false) != 0) {
+        fprintf(stderr, "%s", err_msg);
+        return 1;
+    }
+    const double build_ns = nowNs() - build_start;
+
+    StrVec bound_names = createStrVec();
+    appendStrVec(&bound_names, "x");
+    appendStrVec(&bound_names, "y");
+    const double bound_values[] = { 1.75, 0.5 };
+    double variables[2];
+    double stack[256];
+    double compiled_sum = 0;
+    double cached_sum = 0;
+    size_t mismatches = 0;
+    double compile_ns = 0;
+    double lookup_ns = 0;
+
+    const double open_start = nowNs();
+    ProgramCache cache;
+    if (!openProgramCache(CACHE_PATH, &cache)) {
+        fprintf(stderr, "%s", err_msg);
+        return 1;
+    }
+    const double open_ns = nowNs() - open_start;
+    const uint32_t options = programCacheOptions(OptimizeStrict, false);
+    TokenVec tokens = createTokenVec();
+    NodeArena arena = createNodeArena();
+    for (size_t i = 0; i < formulas; i++) {
+        const size_t len = (size_t)writeFormula(formula, sizeof(formula), i);
+
+        const double compile_start = nowNs();
+        tokens.count = 0;
+        resetNodeArena(&arena);
+        NodeIndex root;
+        OptimizeStats stats;
+        Program program;
+        if (!tokenizeN(formula, len, &tokens) || (root = createSyntaxTree(&arena, formula, &tokens)) == NO_NODE
+            || !optimizeSyntaxTree(&arena, &root, false, &stats) || !compileProgram(&arena, root, &program)) {
+            fprintf(stderr, "%s", err_msg);
+            return 1;
+        }
+        compile_ns += nowNs() - compile_start;
+
+        const double lookup_start = nowNs();
+        CachedProgram cached;
+        if (!findCachedProgram(&cache, options, formula, len, &cached)) {
+            fprintf(stderr, "Formula %zu is not in the cache\n", i);
+            return 1;
+        }
+        lookup_ns += nowNs() - lookup_start;
+
+        bindVariables(&program.variables, &bound_names, bound_values, variables);
+        const double compiled = runProgram(&program, variables, stack);
+        bindCachedVariables(&cached, &bound_names, bound_values, variables);
+        const double from_cache = runProgram(&cached.program, variables, stack);
+        mismatches += memcmp(&compiled, &from_cache, sizeof(double)) != 0;
+        compiled_sum += compiled;
+        cached_sum += from_cache;
+        freeProgram(program);
+    }
+
+    printf("%-10s %10s %14s %14s\n", "path", "formulas", "total ms", "us/formula");
+    printf("%-10s %10zu %14.2f %14.3f\n", "build", formulas, build_ns / 1e6, build_ns / 1e3 / (double)formulas);
+    printf("%-10s %10zu %14.2f %14.3f\n", "compile", formulas, compile_ns / 1e6, compile_ns / 1e3 / (double)formulas);
+    printf("%-10s %10zu %14.2f %14.3f\n", "cache", formulas, (open_ns + lookup_ns) / 1e6, (open_ns + lookup_ns) / 1e3 / (double)formulas);
+    printf("Cache file %zu bytes, mapped and checked in %.2f ms, %zu mismatches (sums %.17g %.17g)\n", cache.size, open_ns / 1e6, mismatches,
+           compiled_sum, cached_sum);
+
+    closeProgramCache(cache);
+    freeTokenVec(tokens);
+    freeNodeArena(arena);
+    freeStrVec(bound_names);
+    remove(LIBRARY_PATH);
+    remove(CACHE_PATH);
+    return mismatches != 0;
+}
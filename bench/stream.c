@@ -0,0 +1,100 @@
+// Streams a machine generated sum of many terms through the StreamEvaluator chunk by chunk, without ever
+// holding the whole expression, and checks the result against the same sum added up directly. Then the
+// first part of the sum is evaluated through a syntax tree to compare speed and memory.
+// Usage: bench_stream [Terms]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "syntax.h"
+#include "stream.h"
+#include "number.h"
+
+#define DEFAULT_TERMS 20000000
+#define TREE_TERMS    5000000 // Terms evaluated through a syntax tree for comparison
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static double maxRssMiB(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double)usage.ru_maxrss / 1024.0;
+}
+
+// Appends term i with its operator, reference holds the sum of the terms before it
+static size_t writeTerm(char * buf, size_t i, double * reference) {
+    const char * op = !i ? "" : i % 3 ? " + " : " - ";
+    const size_t op_len = strlen(op);
+    memcpy(buf, op, op_len);
+    const int len = sprintf(buf + op_len, i % 5 ? "%zu.%02zu" : "%zue-%zu", i % 100003, i % 97);
+    double value;
+    parseNumber(buf + op_len, (size_t)len, &value);
+    *reference = !i ? value : i % 3 ? *reference + value : *reference - value;
+    return op_len + (size_t)len;
+}
+
+int main(int argc, char * argv[]) {
+    const size_t terms = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_TERMS;
+    char * chunk = malloc(STREAM_CHUNK_SIZE + 64);
+    const double rss_before = maxRssMiB();
+
+    StreamEvaluator stream = createStreamEvaluator(NULL, NULL);
+    double reference = 0;
+    size_t bytes = 0;
+    size_t len = 0;
+    double stream_ns = 0; // Generating the terms is not counted
+    for (size_t i = 0; i < terms; i++) {
+        len += writeTerm(chunk + len, i, &reference);
+        if (len < STREAM_CHUNK_SIZE && i + 1 < terms) continue;
+        const double fed = nowNs();
+        if (!feedStreamEvaluator(&stream, chunk, len)) {
+            fprintf(stderr, "%s", err_msg);
+            return 1;
+        }
+        stream_ns += nowNs() - fed;
+        bytes += len;
+        len = 0;
+    }
+    double result;
+    const double finished = nowNs();
+    if (!finishStreamEvaluator(&stream, &result)) {
+        fprintf(stderr, "%s", err_msg);
+        return 1;
+    }
+    stream_ns += nowNs() - finished;
+    printf("%-8s %12s %10s %12s %12s %10s %8s\n", "path", "terms", "MiB", "MiB/s", "Mtokens/s", "RSS MiB", "result");
+    printf("%-8s %12zu %10.1f %12.1f %12.1f %10.1f %8s\n", "stream", terms, (double)bytes / (1 << 20), (double)bytes / (1 << 20) / (stream_ns / 1e9),
+           (double)stream.token_count / (stream_ns / 1e3), maxRssMiB() - rss_before, memcmp(&result, &reference, sizeof(result)) ? "WRONG" : "exact");
+    freeStreamEvaluator(&stream);
+
+    // The tree needs the whole text, its tokens and its nodes at once
+    const size_t tree_terms = terms < TREE_TERMS ? terms : TREE_TERMS;
+    char * text = malloc(tree_terms * 24 + 1);
+    len = 0;
+    for (size_t i = 0; i < tree_terms; i++) len += writeTerm(text + len, i, &reference);
+    text[len] = '\0';
+    const double rss_text = maxRssMiB();
+    const double tree_start = nowNs();
+    TokenVec tokens = createTokenVec();
+    NodeArena arena = createNodeArena();
+    NodeIndex root;
+    if (!tokenizeN(text, len, &tokens) || (root = createSyntaxTree(&arena, text, &tokens)) == NO_NODE || !calculateResult(&arena, root, NULL, &result)) {
+        fprintf(stderr, "%s", err_msg);
+        return 1;
+    }
+    const double tree_ns = nowNs() - tree_start;
+    printf("%-8s %12zu %10.1f %12.1f %12.1f %10.1f %8s\n", "tree", tree_terms, (double)len / (1 << 20), (double)len / (1 << 20) / (tree_ns / 1e9),
+           (double)tokens.count / (tree_ns / 1e3), maxRssMiB() - rss_text, memcmp(&result, &reference, sizeof(result)) ? "WRONG" : "exact");
+
+    freeTokenVec(tokens);
+    freeNodeArena(arena);
+    free(text);
+    free(chunk);
+    return 0;
+}
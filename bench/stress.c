@@ -0,0 +1,141 @@
+// Evaluates one compiled expression from many threads at once against results computed up front.
+// Every thread also compiles valid and broken expressions in its own context, whose results and
+// messages must not be mixed up with those of other threads. Exits with 1 on any mismatch.
+// Usage: bench_stress [Threads] [Iterations]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mathlang.h"
+
+#define DEFAULT_THREADS    16
+#define DEFAULT_ITERATIONS 200000
+#define VALUE_SETS         64
+
+// Shares x+y so the program keeps shared slots behind its stack
+static const char * shared_source = "sqrt((x+y)*(x+y) + z^2) * sin(x+y) - exp(-(z/4)) / (1 + log(2 + x*x)) + cos(x+y)^3";
+static const char * variable_names[] = { "x", "y", "z" };
+
+typedef struct StressThread {
+    pthread_t thread;
+    size_t index;
+    size_t iterations;
+    const MathExpression * expression;
+    const double (*values)[3];
+    const double * expected;
+    size_t mismatches;
+} StressThread;
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Compiles and evaluates expressions only this thread knows, the error of its context has to name its own token
+static size_t checkOwnContext(MathContext * context, size_t index, size_t round) {
+    char source[128];
+    const size_t value = index * 1000 + round;
+    int len = snprintf(source, sizeof(source), "%zu + t * 2", value);
+    MathExpression * expression;
+    if (compileMathExpression(context, source, (size_t)len, &expression) != MathOk) return 1;
+    const double t = (double)round;
+    double result;
+    size_t mismatches = 0;
+    if (evaluateMathExpression(expression, &t, &result) != MathOk || result != (double)value + t * 2) mismatches++;
+    freeMathExpression(expression);
+
+    len = snprintf(source, sizeof(source), "1 + 2 %zu", value);
+    if (compileMathExpression(context, source, (size_t)len, &expression) != MathErrorSyntax || expression) return mismatches + 1;
+    char token[64];
+    snprintf(token, sizeof(token), ">%zu<", value);
+    if (!strstr(mathContextError(context), token)) mismatches++;
+    return mismatches;
+}
+
+static void * stressThread(void * argument) {
+    StressThread * thread = argument;
+    MathContext * context;
+    if (createMathContext(NULL, &context) != MathOk) {
+        thread->mismatches++;
+        return NULL;
+    }
+    for (size_t i = 0; i < thread->iterations; i++) {
+        const size_t set = (i + thread->index) % VALUE_SETS;
+        double result;
+        if (evaluateMathExpression(thread->expression, thread->values[set], &result) != MathOk ||
+            memcmp(&result, &thread->expected[set], sizeof(result)) != 0) {
+            thread->mismatches++;
+        }
+        if (i % 1024 == 0) thread->mismatches += checkOwnContext(context, thread->index, i / 1024);
+    }
+    freeMathContext(context);
+    return NULL;
+}
+
+int main(int argc, char * argv[]) {
+    const size_t thread_count = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_THREADS;
+    const size_t iterations = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_ITERATIONS;
+    if (!thread_count) {
+        fprintf(stderr, "Usage: %s [Threads] [Iterations]\n", argv[0]);
+        return 1;
+    }
+
+    MathContext * context;
+    MathExpression * expression;
+    const MathOptions options = { .share_nodes = true };
+    if (createMathContext(&options, &context) != MathOk) return 1;
+    MathStatus status = compileMathExpression(context, shared_source, strlen(shared_source), &expression);
+    if (status != MathOk) {
+        fprintf(stderr, "%s: %s", mathStatusToStr(status), mathContextError(context));
+        return 1;
+    }
+
+    // Values in the order of the expression, which need not be the one of variable_names
+    double values[VALUE_SETS][3];
+    double expected[VALUE_SETS];
+    const size_t variable_count = mathExpressionVariableCount(expression);
+    for (size_t set = 0; set < VALUE_SETS; set++) {
+        for (size_t i = 0; i < 3; i++) {
+            const size_t index = findMathVariable(expression, variable_names[i]);
+            if (index < variable_count) values[set][index] = (double)set * 0.37 + (double)i * 1.5 - 7.0;
+        }
+        if (evaluateMathExpression(expression, values[set], &expected[set]) != MathOk) return 1;
+    }
+
+    StressThread * threads = calloc(thread_count, sizeof(StressThread));
+    if (!threads) return 1;
+    const double start = nowNs();
+    size_t started = 0;
+    for (; started < thread_count; started++) {
+        threads[started] = (StressThread) {
+            .index = started,
+            .iterations = iterations,
+            .expression = expression,
+            .values = (const double (*)[3])values,
+            .expected = expected,
+        };
+        if (pthread_create(&threads[started].thread, NULL, stressThread, &threads[started]) != 0) break;
+    }
+    // Compiling more while the threads evaluate must not touch the shared expression
+    for (size_t i = 0; i < 1000; i++) {
+        MathExpression * other;
+        if (compileMathExpression(context, shared_source, strlen(shared_source), &other) == MathOk) freeMathExpression(other);
+    }
+    size_t mismatches = 0;
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i].thread, NULL);
+        mismatches += threads[i].mismatches;
+    }
+    const double elapsed = nowNs() - start;
+
+    printf("%zu threads evaluated >%s< %zu times each in %.1f ms (%.1f ns per evaluation and thread)\n", started,
+           shared_source, iterations, elapsed / 1e6, elapsed / (double)iterations);
+    printf("%zu mismatches\n", mismatches);
+    free(threads);
+    freeMathExpression(expression);
+    freeMathContext(context);
+    return mismatches || started != thread_count ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+// Times appending to and iterating over the vecs of cvecs.h: entries boxed behind a pointer the way Vec
+// stored numbers before, the unboxed Vec, IntVec, a typed vec, a typed vec with inline capacity and TokenVec.
+// Then strings: one malloc per string the way StrVec stored them before, the pooled StrVec, the pooled StrVec
+// cleared and reused and the interned StrVec, for names that repeat every STRING_DISTINCT strings.
+// Build with VEC_GROWTH="-DVEC_GROWTH_NUM=3 -DVEC_GROWTH_DEN=2" to try another growth factor.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "cvecs.h"
+#include "syntax.h"
+
+#define BENCH_MIN_NS 1e8 // Every measurement repeats until it took this long
+#define SMALL_CAPACITY 64
+#define STRING_DISTINCT 1000
+
+DEFINE_VEC(LongVec, long, DEFAULT_CAP_VEC)
+DEFINE_SMALL_VEC(LongSmallVec, long, SMALL_CAPACITY)
+
+static const size_t counts[] = {16, 64, 1000, 100000, 10000000};
+#define COUNT_COUNT (sizeof(counts) / sizeof(counts[0]))
+
+typedef struct BenchResult {
+    double append_ns;  // Per element, including creating and freeing the vec
+    double iterate_ns; // Per element
+    size_t resizes;    // Capacity changes while appending
+} BenchResult;
+
+static volatile long sink;
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Every vec is filled and summed the same way, only the code between the markers differs
+#define BENCH_VEC(RESULT, COUNT, CREATE, APPEND, CAPACITY, SUM, FREE) \
+    do { \
+        long runs = 0; \
+        const double start = nowNs(); \
+        double elapsed; \
+        do { \
+            CREATE; \
+            for (size_t i = 0; i < COUNT; i++) { \
+                const size_t capacity = CAPACITY; \
+                APPEND; \
+                if (!runs) RESULT.resizes += CAPACITY != capacity; \
+            } \
+            FREE; \
+            runs++; \
+        } while ((elapsed = nowNs() - start) < BENCH_MIN_NS); \
+        RESULT.append_ns = elapsed / (double)runs / (double)COUNT; \
+        CREATE; \
+        for (size_t i = 0; i < COUNT; i++) { APPEND; } \
+        runs = 0; \
+        const double iterate_start = nowNs(); \
+        do { \
+            long sum = 0; \
+            SUM; \
+            sink = sum; \
+            runs++; \
+        } while ((elapsed = nowNs() - iterate_start) < BENCH_MIN_NS); \
+        RESULT.iterate_ns = elapsed / (double)runs / (double)COUNT; \
+        FREE; \
+    } while (0)
+
+// Layout of Vec before numbers were stored in the entries
+typedef struct BoxedEntry {
+    void * val;
+    unsigned int type;
+} BoxedEntry;
+
+typedef struct BoxedVec {
+    size_t count;
+    size_t capacity;
+    BoxedEntry * entries;
+} BoxedVec;
+
+static void appendBoxed(BoxedVec * vec, long val) {
+    if (vec->count == vec->capacity) {
+        vec->capacity = vec->capacity ? vec->capacity * 2 : DEFAULT_CAP_VEC;
+        vec->entries = realloc(vec->entries, vec->capacity * sizeof(BoxedEntry));
+    }
+    long * boxed = malloc(sizeof(long));
+    *boxed = val;
+    vec->entries[vec->count++] = (BoxedEntry) { boxed, VEC_ENTRY_NUM };
+}
+
+static void freeBoxed(BoxedVec vec) {
+    for (size_t i = 0; i < vec.count; i++) free(vec.entries[i].val);
+    free(vec.entries);
+}
+
+// Layout of StrVec before its strings were pooled
+typedef struct MallocStrVec {
+    size_t count;
+    size_t capacity;
+    char ** vals;
+} MallocStrVec;
+
+static void appendMallocStr(MallocStrVec * vec, const char * str) {
+    if (vec->count == vec->capacity) {
+        vec->capacity = vec->capacity ? vec->capacity * 2 : DEFAULT_CAP_VEC;
+        vec->vals = realloc(vec->vals, vec->capacity * sizeof(char *));
+    }
+    const size_t len = strlen(str);
+    char * copy = malloc(len + 1);
+    memcpy(copy, str, len + 1);
+    vec->vals[vec->count++] = copy;
+}
+
+static void freeMallocStrVec(MallocStrVec vec) {
+    for (size_t i = 0; i < vec.count; i++) free(vec.vals[i]);
+    free(vec.vals);
+}
+
+static void printResult(const char * name, size_t count, BenchResult result) {
+    printf("%-10s %10zu %12.2f %12.3f %9zu\n", name, count, result.append_ns, result.iterate_ns, result.resizes);
+}
+
+int main(void) {
+    printf("Growth factor %d/%d, first capacity %d, inline capacity %d\n\n", VEC_GROWTH_NUM, VEC_GROWTH_DEN, DEFAULT_CAP_VEC, SMALL_CAPACITY);
+    printf("%-10s %10s %12s %12s %9s\n", "vec", "elements", "append ns", "iterate ns", "resizes");
+    for (size_t c = 0; c < COUNT_COUNT; c++) {
+        const size_t count = counts[c];
+        BenchResult result = { 0 };
+
+        BENCH_VEC(result, count, BoxedVec boxed = { 0 }, appendBoxed(&boxed, (long)i), boxed.capacity,
+                  for (size_t i = 0; i < boxed.count; i++) sum += *(long *)boxed.entries[i].val, freeBoxed(boxed));
+        printResult("boxed", count, result);
+
+        result = (BenchResult) { 0 };
+        BENCH_VEC(result, count, Vec vec = createVec(), appendVecNum(&vec, (long)i), vec.capacity,
+                  for (size_t i = 0; i < vec.count; i++) sum += vec.entries[i].num, freeVec(vec));
+        printResult("Vec", count, result);
+
+        result = (BenchResult) { 0 };
+        BENCH_VEC(result, count, IntVec ints = createIntVec(), appendIntVec(&ints, (long)i), ints.capacity,
+                  for (size_t i = 0; i < ints.count; i++) sum += ints.vals[i], freeIntVec(ints));
+        printResult("IntVec", count, result);
+
+        result = (BenchResult) { 0 };
+        BENCH_VEC(result, count, LongVec longs = createLongVec(), appendLongVec(&longs, (long)i), longs.capacity,
+                  for (size_t i = 0; i < longs.count; i++) sum += longs.vals[i], freeLongVec(longs));
+        printResult("typed", count, result);
+
+        result = (BenchResult) { 0 };
+        BENCH_VEC(result, count, LongSmallVec small; initLongSmallVec(&small), appendLongSmallVec(&small, (long)i), small.capacity,
+                  for (size_t i = 0; i < small.count; i++) sum += small.vals[i], freeLongSmallVec(&small));
+        printResult("small", count, result);
+
+        result = (BenchResult) { 0 };
+        BENCH_VEC(result, count, TokenVec tokens = createTokenVec(),
+                  appendTokenVec(&tokens, ((Token) { .value = (double)i, .offset = (uint32_t)i, .length = 1, .type = TokenValue })),
+                  tokens.capacity, for (size_t i = 0; i < tokens.count; i++) sum += tokens.vals[i].offset, freeTokenVec(tokens));
+        printResult("TokenVec", count, result);
+        printf("\n");
+    }
+
+    char (*names)[16] = malloc(STRING_DISTINCT * sizeof(*names));
+    for (size_t i = 0; i < STRING_DISTINCT; i++) snprintf(names[i], sizeof(names[i]), "name_%zu", i);
+    printf("%-10s %10s %12s %12s %9s\n", "strings", "elements", "append ns", "iterate ns", "resizes");
+    for (size_t c = 0; c < COUNT_COUNT; c++) {
+        const size_t count = counts[c];
+        BenchResult result = { 0 };
+
+        BENCH_VEC(result, count, MallocStrVec strs = { 0 }, appendMallocStr(&strs, names[i % STRING_DISTINCT]), strs.capacity,
+                  for (size_t i = 0; i < strs.count; i++) sum += (long)strlen(strs.vals[i]), freeMallocStrVec(strs));
+        printResult("malloc", count, result);
+
+        result = (BenchResult) { 0 };
+        BENCH_VEC(result, count, StrVec strs = createStrVec(), appendStrVec(&strs, names[i % STRING_DISTINCT]), strs.byte_capacity,
+                  for (size_t i = 0; i < strs.count; i++) sum += (long)strs.spans[i].length, freeStrVec(strs));
+        printResult("pooled", count, result);
+
+        // Memory of the previous run is kept, so after the first run nothing grows anymore
+        result = (BenchResult) { 0 };
+        StrVec reused = createStrVec();
+        BENCH_VEC(result, count, clearStrVec(&reused), appendStrVec(&reused, names[i % STRING_DISTINCT]), reused.byte_capacity,
+                  for (size_t i = 0; i < reused.count; i++) sum += (long)reused.spans[i].length, (void)0);
+        freeStrVec(reused);
+        printResult("reused", count, result);
+
+        result = (BenchResult) { 0 };
+        BENCH_VEC(result, count, StrVec strs = createInternedStrVec(DEFAULT_CAP_VEC), appendStrVec(&strs, names[i % STRING_DISTINCT]),
+                  strs.byte_capacity, for (size_t i = 0; i < strs.count; i++) sum += (long)strs.spans[i].length, freeStrVec(strs));
+        printResult("interned", count, result);
+        printf("\n");
+    }
+    free(names);
+    return 0;
+}
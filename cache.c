@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+
+#define CACHE_MIN_BUCKETS 64
+#define CACHE_HASH_MULTIPLIER 0x9e3779b97f4a7c15u
+
+ResultCache createResultCache(size_t memory_cap) {
+    return (ResultCache) { .memory_cap = memory_cap };
+}
+
+void freeResultCache(ResultCache cache) {
+    CacheEntry * entry = cache.newest;
+    while (entry) {
+        CacheEntry * older = entry->older;
+        free(entry);
+        entry = older;
+    }
+    free(cache.buckets);
+    free(cache.key);
+}
+
+static uint64_t hashKey(const unsigned char * key, size_t len) {
+    uint64_t hash = len * CACHE_HASH_MULTIPLIER;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, key + i, sizeof(word));
+        hash = (hash ^ word) * CACHE_HASH_MULTIPLIER;
+        hash ^= hash >> 32;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, key + i, len - i);
+    hash = (hash ^ tail) * CACHE_HASH_MULTIPLIER;
+    return hash ^ (hash >> 29);
+}
+
+static bool reserveKey(ResultCache * cache, size_t capacity) {
+    if (capacity <= cache->key_capacity) return true;
+    size_t grown = cache->key_capacity ? cache->key_capacity : 256;
+    while (grown < capacity) grown *= 2;
+    unsigned char * key = realloc(cache->key, grown);
+    if (!key) return false;
+    cache->key = key;
+    cache->key_capacity = grown;
+    return true;
+}
+
+// One byte of type and operator per token, values are followed by their bits.
+// Returns false for token streams whose result is not only defined by the tokens.
+static bool normalizeTokens(ResultCache * cache, const TokenVec * tokens) {
+    cache->key_len = 0;
+    if (!reserveKey(cache, tokens->count * (1 + sizeof(double)))) return false;
+    unsigned char * key = cache->key;
+    size_t len = 0;
+    for (size_t i = 0; i < tokens->count; i++) {
+        const Token * token = &tokens->vals[i];
+        if (token->type == TokenVariable) return false;
+        key[len++] = (unsigned char)(token->type | token->operator << 3);
+        if (token->type == TokenValue) {
+            memcpy(key + len, &token->value, sizeof(double));
+            len += sizeof(double);
+        }
+    }
+    cache->key_len = len;
+    cache->key_hash = hashKey(key, len);
+    return len > 0;
+}
+
+static void unlinkEntry(ResultCache * cache, CacheEntry * entry) {
+    if (entry->newer) entry->newer->older = entry->older;
+    else              cache->newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer;
+    else              cache->oldest = entry->newer;
+}
+
+static void linkNewest(ResultCache * cache, CacheEntry * entry) {
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest) cache->newest->newer = entry;
+    else               cache->oldest = entry;
+    cache->newest = entry;
+}
+
+bool lookupResultCache(ResultCache * cache, const TokenVec * tokens, double * result) {
+    if (!normalizeTokens(cache, tokens)) {
+        cache->key_len = 0;
+        cache->stats.uncacheable++;
+        return false;
+    }
+    if (cache->buckets) {
+        CacheEntry * entry = cache->buckets[cache->key_hash & (cache->bucket_count - 1)];
+        for (; entry; entry = entry->next) {
+            if (entry->hash != cache->key_hash || entry->key_len != cache->key_len) continue;
+            if (memcmp(entry->key, cache->key, cache->key_len) != 0) continue;
+            unlinkEntry(cache, entry);
+            linkNewest(cache, entry);
+            *result = entry->result;
+            cache->key_len = 0;
+            cache->stats.hits++;
+            return true;
+        }
+    }
+    cache->stats.misses++;
+    return false;
+}
+
+static void evictOldest(ResultCache * cache) {
+    CacheEntry * entry = cache->oldest;
+    CacheEntry ** link = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+    unlinkEntry(cache, entry);
+    cache->stats.memory -= sizeof(CacheEntry) + entry->key_len;
+    cache->stats.entries--;
+    cache->stats.evictions++;
+    free(entry);
+}
+
+// Doubles the buckets once there are more entries than buckets, as long as the cap allows
+static void growBuckets(ResultCache * cache) {
+    const size_t count = cache->bucket_count ? cache->bucket_count * 2 : CACHE_MIN_BUCKETS;
+    const size_t added = (count - cache->bucket_count) * sizeof(CacheEntry *);
+    if (cache->stats.memory + added > cache->memory_cap) return;
+    CacheEntry ** buckets = calloc(count, sizeof(CacheEntry *));
+    if (!buckets) return;
+    for (CacheEntry * entry = cache->newest; entry; entry = entry->older) {
+        CacheEntry ** bucket = &buckets[entry->hash & (count - 1)];
+        entry->next = *bucket;
+        *bucket = entry;
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_count = count;
+    cache->stats.memory += added;
+}
+
+void insertResultCache(ResultCache * cache, double result) {
+    if (!cache->key_len) return;
+    const size_t size = sizeof(CacheEntry) + cache->key_len;
+    if (cache->stats.entries >= cache->bucket_count) growBuckets(cache);
+    if (!cache->buckets) return;
+    if (size > cache->memory_cap / 2) return; // Would evict most of the cache
+
+    while (cache->oldest && cache->stats.memory + size > cache->memory_cap) evictOldest(cache);
+    if (cache->stats.memory + size > cache->memory_cap) return;
+    CacheEntry * entry = malloc(size);
+    if (!entry) return;
+    entry->hash = cache->key_hash;
+    entry->result = result;
+    entry->key_len = cache->key_len;
+    memcpy(entry->key, cache->key, cache->key_len);
+
+    CacheEntry ** bucket = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+    linkNewest(cache, entry);
+    cache->stats.memory += size;
+    cache->stats.entries++;
+    cache->key_len = 0;
+}
+
+void addCacheStats(CacheStats * total, const CacheStats * stats) {
+    total->hits += stats->hits;
+    total->misses += stats->misses;
+    total->evictions += stats->evictions;
+    total->uncacheable += stats->uncacheable;
+    total->entries += stats->entries;
+    total->memory += stats->memory;
+}
@@ -0,0 +1,53 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "syntax.h"
+
+// An entry remembers the result of one normalized token stream. Values are keyed by their
+// parsed bits, so whitespace and spellings like 1.0, 1e0 and 0x1 of the same number hit alike.
+typedef struct CacheEntry {
+    uint64_t hash;
+    double result;
+    struct CacheEntry * next;  // Next entry of the same bucket
+    struct CacheEntry * newer; // Neighbours in least recently used order
+    struct CacheEntry * older;
+    size_t key_len;
+    unsigned char key[];
+} CacheEntry;
+
+typedef struct CacheStats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t uncacheable; // Lookups of expressions with variables, their result depends on the values
+    size_t entries;
+    size_t memory;      // Bytes used by entries and buckets
+} CacheStats;
+
+// Bounded LRU cache of expression results, not thread safe, every thread needs its own
+typedef struct ResultCache {
+    CacheEntry ** buckets;
+    size_t bucket_count; // Power of two
+    CacheEntry * newest;
+    CacheEntry * oldest;
+    size_t memory_cap;
+    CacheStats stats;
+    uint64_t key_hash;   // Hash of the key of the last lookup
+    size_t key_len;
+    size_t key_capacity;
+    unsigned char * key; // Normalized token stream of the last lookup
+} ResultCache;
+
+ResultCache createResultCache(size_t memory_cap); // Creates an empty cache using at most memory_cap bytes
+void freeResultCache(ResultCache cache);          // Frees Memory of ResultCache
+
+// Looks up the result of tokens. On a miss the normalized key is kept,
+// so insertResultCache can store the result once it was calculated.
+bool lookupResultCache(ResultCache * cache, const TokenVec * tokens, double * result);
+void insertResultCache(ResultCache * cache, double result); // Stores result under the key of the last missed lookup
+void addCacheStats(CacheStats * total, const CacheStats * stats);
+
+#endif // __CACHE_H__
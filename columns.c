@@ -0,0 +1,405 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "columns.h"
+#include "mathfn.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define COLUMNS_X86
+#endif
+
+#define COLUMN_L1_BYTES   (24 * 1024) // Part of L1 the stack of one block may use
+#define COLUMN_MIN_BLOCK  64
+#define COLUMN_MAX_BLOCK  2048
+
+typedef void (*KernelVV)(double * out, const double * a, const double * b, size_t n);
+typedef void (*KernelVS)(double * out, const double * a, double b, size_t n);
+typedef void (*KernelSV)(double * out, double a, const double * b, size_t n);
+typedef void (*KernelV)(double * out, const double * a, size_t n);
+
+enum { KernelAdd = 0, KernelSub, KernelMul, KernelDiv, KernelCount };
+
+typedef struct ColumnKernels {
+    const char * name;
+    KernelVV vv[KernelCount];
+    KernelVS vs[KernelCount];
+    KernelSV sv[KernelCount];
+    KernelV sqrt;
+    KernelV negate; // Flips the sign bit like -a, also of nan
+} ColumnKernels;
+
+// Defines vector-vector, vector-scalar and scalar-vector versions of one operator for one instruction set.
+// out may be the same as a or b.
+#define DEFINE_KERNEL(ISA, NAME, ATTR, VTYPE, LANES, LOADU, STOREU, SET1, VOP, SOP) \
+    ATTR static void NAME##VV##ISA(double * out, const double * a, const double * b, size_t n) { \
+        size_t i = 0; \
+        for (; i + LANES <= n; i += LANES) STOREU(out + i, VOP(LOADU(a + i), LOADU(b + i))); \
+        for (; i < n; i++) out[i] = a[i] SOP b[i]; \
+    } \
+    ATTR static void NAME##VS##ISA(double * out, const double * a, double b, size_t n) { \
+        const VTYPE vb = SET1(b); \
+        size_t i = 0; \
+        for (; i + LANES <= n; i += LANES) STOREU(out + i, VOP(LOADU(a + i), vb)); \
+        for (; i < n; i++) out[i] = a[i] SOP b; \
+    } \
+    ATTR static void NAME##SV##ISA(double * out, double a, const double * b, size_t n) { \
+        const VTYPE va = SET1(a); \
+        size_t i = 0; \
+        for (; i + LANES <= n; i += LANES) STOREU(out + i, VOP(va, LOADU(b + i))); \
+        for (; i < n; i++) out[i] = a SOP b[i]; \
+    }
+
+#define DEFINE_KERNELS(ISA, ATTR, VTYPE, LANES, LOADU, STOREU, SET1, ADD, SUB, MUL, DIV, SQRT, NEG) \
+    ATTR static void sqrtV##ISA(double * out, const double * a, size_t n) { \
+        size_t i = 0; \
+        for (; i + LANES <= n; i += LANES) STOREU(out + i, SQRT(LOADU(a + i))); \
+        for (; i < n; i++) out[i] = sqrt(a[i]); \
+    } \
+    ATTR static void negateV##ISA(double * out, const double * a, size_t n) { \
+        size_t i = 0; \
+        for (; i + LANES <= n; i += LANES) STOREU(out + i, NEG(LOADU(a + i))); \
+        for (; i < n; i++) out[i] = -a[i]; \
+    } \
+    DEFINE_KERNEL(ISA, add, ATTR, VTYPE, LANES, LOADU, STOREU, SET1, ADD, +) \
+    DEFINE_KERNEL(ISA, sub, ATTR, VTYPE, LANES, LOADU, STOREU, SET1, SUB, -) \
+    DEFINE_KERNEL(ISA, mul, ATTR, VTYPE, LANES, LOADU, STOREU, SET1, MUL, *) \
+    DEFINE_KERNEL(ISA, div, ATTR, VTYPE, LANES, LOADU, STOREU, SET1, DIV, /) \
+    static const ColumnKernels kernels##ISA = { \
+        .name = #ISA, \
+        .vv = { addVV##ISA, subVV##ISA, mulVV##ISA, divVV##ISA }, \
+        .vs = { addVS##ISA, subVS##ISA, mulVS##ISA, divVS##ISA }, \
+        .sv = { addSV##ISA, subSV##ISA, mulSV##ISA, divSV##ISA }, \
+        .sqrt = sqrtV##ISA, \
+        .negate = negateV##ISA, \
+    };
+
+#define SCALAR_LOAD(P)      (*(P))
+#define SCALAR_STORE(P, V)  (*(P) = (V))
+#define SCALAR_SET1(X)      (X)
+#define SCALAR_ADD(A, B)    ((A) + (B))
+#define SCALAR_SUB(A, B)    ((A) - (B))
+#define SCALAR_MUL(A, B)    ((A) * (B))
+#define SCALAR_DIV(A, B)    ((A) / (B))
+#define SCALAR_NEG(A)       (-(A))
+DEFINE_KERNELS(Scalar, , double, 1, SCALAR_LOAD, SCALAR_STORE, SCALAR_SET1, SCALAR_ADD, SCALAR_SUB, SCALAR_MUL, SCALAR_DIV, sqrt, SCALAR_NEG)
+
+#ifdef COLUMNS_X86
+// XOR with -0.0 flips only the sign bit, AVX512F has no XOR of doubles
+#define AVX2_NEG(A)   _mm256_xor_pd((A), _mm256_set1_pd(-0.0))
+#define AVX512_NEG(A) _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(A), _mm512_set1_epi64(INT64_MIN)))
+DEFINE_KERNELS(AVX2, __attribute__((target("avx2"))), __m256d, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd,
+               _mm256_add_pd, _mm256_sub_pd, _mm256_mul_pd, _mm256_div_pd, _mm256_sqrt_pd, AVX2_NEG)
+DEFINE_KERNELS(AVX512, __attribute__((target("avx512f"))), __m512d, 8, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_set1_pd,
+               _mm512_add_pd, _mm512_sub_pd, _mm512_mul_pd, _mm512_div_pd, _mm512_sqrt_pd, AVX512_NEG)
+#endif
+
+// MATHLANG_SIMD=scalar|avx2|avx512 limits the instruction set, mostly to compare results
+static const ColumnKernels * selectKernels(void) {
+    static const ColumnKernels * selected = NULL;
+    if (selected) return selected;
+
+    const char * limit = getenv("MATHLANG_SIMD");
+    selected = &kernelsScalar;
+#ifdef COLUMNS_X86
+    __builtin_cpu_init();
+    if (limit && strcmp(limit, "scalar") == 0) return selected;
+    if (__builtin_cpu_supports("avx2")) selected = &kernelsAVX2;
+    if (limit && strcmp(limit, "avx2") == 0) return selected;
+    if (__builtin_cpu_supports("avx512f")) selected = &kernelsAVX512;
+#else
+    (void)limit;
+#endif
+    return selected;
+}
+
+const char * columnKernelName(void) {
+    return selectKernels()->name;
+}
+
+// An entry of the block stack is either one scalar for all rows or a pointer to one value per row
+typedef struct ColumnSlot {
+    const double * vals;
+    double scalar;
+} ColumnSlot;
+
+static int opCodeToKernel(OpCode op) {
+    switch (op) {
+        case OpAdd: return KernelAdd;
+        case OpSub: return KernelSub;
+        case OpMul: return KernelMul;
+        case OpDiv: return KernelDiv;
+        default: break;
+    }
+    return -1;
+}
+
+// Array version of the elementary function of op, NULL for every other op
+static MathArrayFunction opCodeToMathFunction(const MathKernels * math, OpCode op) {
+    switch (op) {
+        case OpExp: return math->exp;
+        case OpLog: return math->log;
+        case OpSin: return math->sin;
+        case OpCos: return math->cos;
+        default: break;
+    }
+    return NULL;
+}
+
+static double applyOpCode(OpCode op, double a, double b) {
+    switch (op) {
+        case OpAdd: return a + b;
+        case OpSub: return a - b;
+        case OpMul: return a * b;
+        case OpDiv: return a / b;
+        case OpPow: return pow(a, b);
+        case OpExp: return mathExp(a);
+        case OpLog: return mathLog(a);
+        case OpSin: return mathSin(a);
+        case OpCos: return mathCos(a);
+        default: break;
+    }
+    return NAN;
+}
+
+bool evaluateColumns(const Program * program, const double * const * columns, size_t rows, double * results) {
+    const ColumnKernels * kernels = selectKernels();
+    const MathKernels * math = selectMathKernels();
+
+    const size_t slot_count = program->max_stack + program->slot_count;
+    size_t block = COLUMN_L1_BYTES / (sizeof(double) * (slot_count + 1));
+    block = block < COLUMN_MIN_BLOCK ? COLUMN_MIN_BLOCK : block > COLUMN_MAX_BLOCK ? COLUMN_MAX_BLOCK : block & ~(size_t)15;
+
+    // Shared slots follow the stack, their values are copied out of the stack buffers that get reused
+    double * buffers = aligned_alloc(64, slot_count * block * sizeof(double));
+    ColumnSlot * stack = malloc(slot_count * sizeof(ColumnSlot));
+    ColumnSlot * shared = stack + program->max_stack;
+    if (!buffers || !stack) {
+        free(buffers);
+        free(stack);
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while evaluating columns\n");
+        return false;
+    }
+
+    for (size_t row = 0; row < rows; row += block) {
+        const size_t n = rows - row < block ? rows - row : block;
+        const double * constant = program->constants;
+        size_t depth = 0;
+
+        for (const Instruction * ip = program->code;; ip++) {
+            const OpCode op = (OpCode)INSTRUCTION_OP(*ip);
+            if (op == OpReturn) break;
+            if (op == OpConst) {
+                stack[depth++] = (ColumnSlot) { NULL, *constant++ };
+                continue;
+            }
+            if (op == OpVar) {
+                stack[depth++] = (ColumnSlot) { columns[INSTRUCTION_ARG(*ip)] + row, 0 };
+                continue;
+            }
+            if (op == OpDup) {
+                stack[depth] = stack[depth - 1];
+                depth++;
+                continue;
+            }
+            if (op == OpStore) {
+                const ColumnSlot * a = &stack[depth - 1];
+                ColumnSlot * slot = &shared[INSTRUCTION_ARG(*ip)];
+                *slot = *a;
+                if (a->vals) {
+                    double * copy = buffers + (program->max_stack + INSTRUCTION_ARG(*ip)) * block;
+                    memcpy(copy, a->vals, n * sizeof(double));
+                    slot->vals = copy;
+                }
+                continue;
+            }
+            if (op == OpLoad) {
+                stack[depth++] = shared[INSTRUCTION_ARG(*ip)];
+                continue;
+            }
+
+            // The last instruction writes straight into results
+            const bool last = INSTRUCTION_OP(ip[1]) == OpReturn;
+            if (op == OpNeg || op == OpSqrt) {
+                ColumnSlot * a = &stack[depth - 1];
+                double * out = last ? results + row : buffers + (depth - 1) * block;
+                if (!a->vals) a->scalar = op == OpNeg ? -a->scalar : sqrt(a->scalar);
+                else {
+                    if (op == OpNeg) kernels->negate(out, a->vals, n);
+                    else             kernels->sqrt(out, a->vals, n);
+                    a->vals = out;
+                }
+                continue;
+            }
+            const MathArrayFunction function = opCodeToMathFunction(math, op);
+            if (function) {
+                ColumnSlot * a = &stack[depth - 1];
+                double * out = last ? results + row : buffers + (depth - 1) * block;
+                if (!a->vals) a->scalar = applyOpCode(op, a->scalar, 0);
+                else {
+                    function(out, a->vals, n);
+                    a->vals = out;
+                }
+                continue;
+            }
+
+            ColumnSlot * a = &stack[depth - 2];
+            const ColumnSlot * b = &stack[depth - 1];
+            double * out = last ? results + row : buffers + (depth - 2) * block;
+            const int kernel = opCodeToKernel(op);
+            depth--;
+            if (!a->vals && !b->vals) {
+                a->scalar = applyOpCode(op, a->scalar, b->scalar);
+                continue;
+            }
+            if (kernel < 0) {
+                for (size_t i = 0; i < n; i++) {
+                    out[i] = applyOpCode(op, a->vals ? a->vals[i] : a->scalar, b->vals ? b->vals[i] : b->scalar);
+                }
+            } else if (a->vals && b->vals) kernels->vv[kernel](out, a->vals, b->vals, n);
+            else if (a->vals)              kernels->vs[kernel](out, a->vals, b->scalar, n);
+            else                           kernels->sv[kernel](out, a->scalar, b->vals, n);
+            a->vals = out;
+        }
+
+        const ColumnSlot * top = &stack[0];
+        if (!top->vals) for (size_t i = 0; i < n; i++) results[row + i] = top->scalar;
+        else if (top->vals != results + row) memcpy(results + row, top->vals, n * sizeof(double));
+    }
+
+    free(buffers);
+    free(stack);
+    return true;
+}
+
+static double nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Reads a whitespace separated table, the first line names the columns
+static bool readColumnFile(FILE * fp, StrVec * names, double *** columns, size_t * rows) {
+    char * line = NULL;
+    size_t line_cap = 0;
+    size_t capacity = 0;
+    bool ok = true;
+
+    if (getline(&line, &line_cap, fp) < 0) {
+        snprintf(err_msg, sizeof(err_msg), "Missing header line with column names\n");
+        free(line);
+        return false;
+    }
+    for (char * name = strtok(line, " \t\r\n"); name; name = strtok(NULL, " \t\r\n")) appendStrVec(names, name);
+    *columns = calloc(names->count ? names->count : 1, sizeof(double *));
+    if (!*columns) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while reading columns\n");
+        free(line);
+        return false;
+    }
+
+    while (ok && getline(&line, &line_cap, fp) >= 0) {
+        if (*rows == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            for (size_t c = 0; c < names->count; c++) {
+                double * grown = realloc((*columns)[c], capacity * sizeof(double));
+                if (!grown) {
+                    snprintf(err_msg, sizeof(err_msg), "Out of memory while reading columns\n");
+                    ok = false;
+                    break;
+                }
+                (*columns)[c] = grown;
+            }
+        }
+        char * current = line;
+        size_t c = 0;
+        for (; ok && c < names->count; c++) {
+            char * end;
+            (*columns)[c][*rows] = strtod(current, &end);
+            if (end == current) break;
+            current = end;
+        }
+        while (*current == ' ' || *current == '\t' || *current == '\r' || *current == '\n') current++;
+        if (c == 0 && *current == '\0') continue; // Empty line
+        if (ok && (c != names->count || *current != '\0')) {
+            snprintf(err_msg, sizeof(err_msg), "Row %zu does not have %zu numbers\n", *rows + 1, names->count);
+            ok = false;
+        }
+        (*rows)++;
+    }
+
+    free(line);
+    return ok;
+}
+
+int runColumns(const char * expression, const char * filename, long runs, OptimizeMode optimize, bool share_nodes) {
+    FILE * fp = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "Could not open file >%s<\n", filename);
+        return -1;
+    }
+
+    StrVec names = createStrVec();
+    double ** columns = NULL;
+    size_t rows = 0;
+    bool ok = readColumnFile(fp, &names, &columns, &rows);
+    if (fp != stdin) fclose(fp);
+
+    TokenVec tokens = createTokenVec();
+    NodeArena arena = createNodeArena();
+    arena.share_nodes = share_nodes;
+    Program program = { 0 };
+    const double ** bound = NULL;
+    double * results = NULL;
+    NodeIndex root = NO_NODE;
+    ok = ok && tokenize(expression, &tokens)
+            && (root = createSyntaxTree(&arena, expression, &tokens)) != NO_NODE
+            && (optimize == OptimizeNone || optimizeSyntaxTree(&arena, &root, optimize == OptimizeFastMath, NULL))
+            && compileProgram(&arena, root, &program);
+
+    if (ok) {
+        bound = malloc((program.variables.count ? program.variables.count : 1) * sizeof(double *));
+        results = malloc((rows ? rows : 1) * sizeof(double));
+        ok = bound && results;
+        for (size_t i = 0; ok && i < program.variables.count; i++) {
+            const char * name = program.variables.vals[i];
+            const size_t column = findVariable(&names, name, strlen(name));
+            if (column == names.count) {
+                snprintf(err_msg, sizeof(err_msg), "Variable >%s< has no column\n", name);
+                ok = false;
+                break;
+            }
+            bound[i] = columns[column];
+        }
+    }
+
+    if (ok) {
+        const double start = nowNs();
+        for (long i = 0; ok && i < (runs > 0 ? runs : 1); i++) ok = evaluateColumns(&program, bound, rows, results);
+        const double elapsed = nowNs() - start;
+
+        if (runs > 0) {
+            const double per_run = elapsed / (double)runs;
+            const double bytes = (double)rows * (double)(program.variables.count + 1) * sizeof(double);
+            fprintf(stderr, "Columns: %zu rows, %zu variables, %s kernels\n", rows, program.variables.count, columnKernelName());
+            fprintf(stderr, "Evaluation: %.3f ns per row, %.2f GB/s (%ld runs)\n", per_run / (double)rows, bytes / per_run, runs);
+        } else {
+            for (size_t i = 0; i < rows; i++) printf("%.17g\n", results[i]);
+        }
+    }
+    if (!ok) fprintf(stderr, "%s", err_msg);
+
+    free(results);
+    free(bound);
+    freeProgram(program);
+    freeNodeArena(arena);
+    freeTokenVec(tokens);
+    for (size_t i = 0; columns && i < names.count; i++) free(columns[i]);
+    free(columns);
+    freeStrVec(names);
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,21 @@
+#ifndef __COLUMNS_H__
+#define __COLUMNS_H__
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "vm.h"
+#include "optimize.h"
+
+// Evaluates program once per row. columns[i] holds rows values of program->variables.vals[i].
+// Rows are processed in blocks that fit into L1, every instruction runs over a whole block
+// using the widest SIMD instructions the CPU supports.
+bool evaluateColumns(const Program * program, const double * const * columns, size_t rows, double * results);
+
+const char * columnKernelName(void); // Name of the instruction set evaluateColumns uses
+
+// Evaluates expression for every row of a whitespace separated table whose first line names the columns.
+// Prints one result per row, or with runs > 0 only the time evaluating all rows runs times takes.
+// With share_nodes equal subexpressions are evaluated once per block.
+int runColumns(const char * expression, const char * filename, long runs, OptimizeMode optimize, bool share_nodes);
+
+#endif // __COLUMNS_H__
@@ -4,7 +4,16 @@
 #include <string.h>
 
 static size_t calcNewVecCap(size_t capacity) {
-    return (size_t)((float)capacity + ((float)capacity / DEFAULT_CAP_VEC) * DEFAULT_CAP_VEC);
+    return growVecCapacity(capacity, DEFAULT_CAP_VEC, capacity + 1);
+}
+
+void * resizeVecMemory(void * vals, size_t capacity, size_t size, const void * inline_vals, size_t count) {
+    if (capacity > SIZE_MAX / size) return NULL;
+    if (vals != inline_vals || !vals) return realloc(vals, capacity * size);
+
+    void * res = malloc(capacity * size);
+    if (res) memcpy(res, vals, count * size);
+    return res;
 }
 
 static bool setVecCapacity(void ** start, size_t cap, size_t size) {
@@ -30,57 +39,173 @@ static char * copyCString(const char * str) {
 }
 
 #ifndef __USE_CSTRING__
-StrVec createStrVec(void) {
-    char ** vals = calloc(DEFAULT_CAP_VEC, sizeof(char *));
+#define STR_VEC_FIRST_BYTES 1024
+#define NO_STR SIZE_MAX
 
-    return (StrVec) {
-        .count = 0,
-        .capacity = DEFAULT_CAP_VEC,
-        .vals = vals
-    };
+StrVec createStrVec(void) {
+    return createStrVecEx(DEFAULT_CAP_VEC);
 }
 
 StrVec createStrVecEx(size_t capacity) {
-    char ** vals = calloc(capacity, sizeof(char *));
-
-    return (StrVec) {
-        .count = 0,
+    if (!capacity) capacity = 1;
+    StrVec str_vec = {
         .capacity = capacity,
-        .vals = vals
+        .vals = calloc(capacity, sizeof(char *)),
+        .spans = calloc(capacity, sizeof(StrSpan)),
     };
+    if (!str_vec.vals || !str_vec.spans) {
+        free(str_vec.vals);
+        free(str_vec.spans);
+        return (StrVec) { 0 };
+    }
+    return str_vec;
+}
+
+StrVec createInternedStrVec(size_t capacity) {
+    StrVec str_vec = createStrVecEx(capacity);
+    str_vec.intern = true;
+    return str_vec;
 }
 
 void freeStrVec(StrVec str_vec) {
-    for (size_t i = 0; i < str_vec.count; i++) {
-        free(str_vec.vals[i]);
-    }
     free(str_vec.vals);
+    free(str_vec.spans);
+    free(str_vec.bytes);
+    free(str_vec.table);
+}
+
+void clearStrVec(StrVec * str_vec) {
+    str_vec->count = 0;
+    str_vec->byte_count = 0;
+    str_vec->distinct = 0;
+    if (str_vec->table) memset(str_vec->table, 0xff, str_vec->table_capacity * sizeof(size_t));
+}
+
+// FNV-1a
+static size_t hashStr(const char * str, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325u;
+    for (size_t i = 0; i < len; i++) hash = (hash ^ (unsigned char)str[i]) * 0x100000001b3u;
+    return (size_t)(hash ^ (hash >> 32));
+}
+
+// Slot of the table holding the string, or the empty slot it would be inserted at
+static size_t findStrVecSlot(const StrVec * str_vec, const char * str, size_t len) {
+    const size_t mask = str_vec->table_capacity - 1;
+    size_t slot = hashStr(str, len) & mask;
+    for (size_t index; (index = str_vec->table[slot]) != NO_STR; slot = (slot + 1) & mask) {
+        if (str_vec->spans[index].length == len && memcmp(str_vec->vals[index], str, len) == 0) break;
+    }
+    return slot;
+}
+
+// Of equal strings only the first one is entered
+static void rehashStrVec(StrVec * str_vec) {
+    memset(str_vec->table, 0xff, str_vec->table_capacity * sizeof(size_t));
+    str_vec->distinct = 0;
+    for (size_t i = 0; i < str_vec->count; i++) {
+        const size_t slot = findStrVecSlot(str_vec, str_vec->vals[i], str_vec->spans[i].length);
+        if (str_vec->table[slot] != NO_STR) continue;
+        str_vec->table[slot] = i;
+        str_vec->distinct++;
+    }
+}
+
+// The table is kept at most half full
+static bool reserveStrVecTable(StrVec * str_vec, size_t distinct) {
+    if (2 * distinct <= str_vec->table_capacity) return true;
+    size_t cap = str_vec->table_capacity ? str_vec->table_capacity : 16;
+    while (cap < 2 * distinct) cap *= 2;
+    size_t * table = malloc(cap * sizeof(size_t));
+    if (!table) return false;
+    free(str_vec->table);
+    str_vec->table = table;
+    str_vec->table_capacity = cap;
+    rehashStrVec(str_vec);
+    return true;
+}
+
+// Grows the arena for additional bytes, vals are moved along with it
+static bool reserveStrVecBytes(StrVec * str_vec, size_t additional) {
+    if (str_vec->byte_count + additional <= str_vec->byte_capacity) return true;
+    const size_t cap = growVecCapacity(str_vec->byte_capacity, STR_VEC_FIRST_BYTES, str_vec->byte_count + additional);
+    char * bytes = realloc(str_vec->bytes, cap);
+    if (!bytes) return false;
+    if (bytes != str_vec->bytes) {
+        for (size_t i = 0; i < str_vec->count; i++) str_vec->vals[i] = bytes + str_vec->spans[i].offset;
+    }
+    str_vec->bytes = bytes;
+    str_vec->byte_capacity = cap;
+    return true;
 }
 
 bool appendStrVec(StrVec * str_vec, const char * str) {
-    if (!str_vec) return false;
-    char * new_str = copyCString(str);
+    return str && appendStrVecN(str_vec, str, strlen(str));
+}
 
-    str_vec->count++;
-    if (str_vec->capacity < str_vec->count) {
-        setStrVecCapacity(str_vec, calcNewVecCap(str_vec->capacity));
+bool appendStrVecN(StrVec * str_vec, const char * str, size_t len) {
+    if (!str_vec || !str_vec->vals) return false;
+    if (str_vec->count == str_vec->capacity && !setStrVecCapacity(str_vec, calcNewVecCap(str_vec->capacity))) return false;
+
+    size_t slot = 0;
+    if (str_vec->intern) {
+        if (!reserveStrVecTable(str_vec, str_vec->distinct + 1)) return false;
+        slot = findStrVecSlot(str_vec, str, len);
+    }
+
+    size_t offset;
+    if (str_vec->intern && str_vec->table[slot] != NO_STR) {
+        offset = str_vec->spans[str_vec->table[slot]].offset;
+    } else {
+        // str may point into the arena that is about to move
+        const bool inside = str_vec->bytes && str >= str_vec->bytes && str < str_vec->bytes + str_vec->byte_count;
+        const size_t inside_offset = inside ? (size_t)(str - str_vec->bytes) : 0;
+        if (!reserveStrVecBytes(str_vec, len + 1)) return false;
+        if (inside) str = str_vec->bytes + inside_offset;
+
+        offset = str_vec->byte_count;
+        memcpy(str_vec->bytes + offset, str, len);
+        str_vec->bytes[offset + len] = '\0';
+        str_vec->byte_count += len + 1;
+        if (str_vec->intern) {
+            str_vec->table[slot] = str_vec->count;
+            str_vec->distinct++;
+        }
     }
 
-    str_vec->vals[str_vec->count-1] = new_str;
+    str_vec->spans[str_vec->count] = (StrSpan) { offset, len };
+    str_vec->vals[str_vec->count] = str_vec->bytes + offset;
+    str_vec->count++;
     return true;
 }
 
-bool updateStrVec(StrVec str_vec, const char * str, size_t pos) {
-    if (pos >= str_vec.count) return false;
-    free(str_vec.vals[pos]);
-    str_vec.vals[pos] = copyCString(str);
+size_t findStrVec(const StrVec * str_vec, const char * str, size_t len) {
+    if (str_vec->intern) {
+        if (!str_vec->table) return str_vec->count;
+        const size_t index = str_vec->table[findStrVecSlot(str_vec, str, len)];
+        return index == NO_STR ? str_vec->count : index;
+    }
+    for (size_t i = 0; i < str_vec->count; i++) {
+        if (str_vec->spans[i].length == len && memcmp(str_vec->vals[i], str, len) == 0) return i;
+    }
+    return str_vec->count;
+}
+
+// The new string is appended and its span moved to pos
+bool updateStrVec(StrVec * str_vec, const char * str, size_t pos) {
+    if (!str_vec || pos >= str_vec->count) return false;
+    if (!appendStrVec(str_vec, str)) return false;
+    str_vec->count--;
+    str_vec->spans[pos] = str_vec->spans[str_vec->count];
+    str_vec->vals[pos] = str_vec->vals[str_vec->count];
+    if (str_vec->intern) rehashStrVec(str_vec);
     return true;
 }
 
 bool setStrVecCapacity(StrVec * str_vec, size_t cap) {
-    if (!str_vec) return false;
-    
-    setVecCapacity((void **)&str_vec->vals, cap, sizeof(char *));
+    if (!str_vec || cap < str_vec->count) return false;
+
+    if (!setVecCapacity((void **)&str_vec->vals, cap, sizeof(char *))) return false;
+    if (!setVecCapacity((void **)&str_vec->spans, cap, sizeof(StrSpan))) return false;
     str_vec->capacity = cap;
 
     return true;
@@ -199,7 +324,7 @@ bool appendIntVec(IntVec * int_vec, long val) {
 bool setIntVecCapacity(IntVec * int_vec, size_t cap) {
     if (!int_vec) return false;
     
-    if (!setVecCapacity((void **)&int_vec->vals, cap, sizeof(int))) return false;
+    if (!setVecCapacity((void **)&int_vec->vals, cap, sizeof(long))) return false;
     int_vec->capacity = cap;
 
     return true;
@@ -226,27 +351,27 @@ Vec createVecEx(size_t capacity) {
 }
 void freeVec(Vec vec) {
     for (size_t i = 0; i < vec.count; i++) {
-        if (vec.entries[i].type != VEC_ENTRY_OTHER) free((vec.entries + i)->val);
+        if (vec.entries[i].type == VEC_ENTRY_STR) free((vec.entries + i)->val);
     }
     free(vec.entries);
 }
 
+// Makes room for one more entry
+static bool reserveVecEntry(Vec * vec) {
+    if (vec->count < vec->capacity) return true;
+    const size_t cap = calcNewVecCap(vec->capacity);
+    if (!setVecCapacity((void **)&vec->entries, cap, sizeof(VecEntry))) return false;
+    vec->capacity = cap;
+    return true;
+}
+
 bool appendVecNum(Vec * vec, long val) {
     if (!vec) return false;
 
+    if (!reserveVecEntry(vec)) return false;
     vec->count++;
-    if (vec->capacity < vec->count) {
-        if (!setVecCapacity((void **)&vec->entries, calcNewVecCap(vec->capacity), sizeof(VecEntry))) return false;
-    }
-
-    long * new_val = malloc(sizeof(long));
-    if (!new_val) {
-        fprintf(stderr, "Malloc failed %s %d\n", __FILE__, __LINE__);
-        return false;
-    }
 
-    *new_val = val;
-    vec->entries[vec->count-1].val = new_val;
+    vec->entries[vec->count-1].num = val;
     vec->entries[vec->count-1].type = VEC_ENTRY_NUM;
 
     return true;
@@ -255,16 +380,14 @@ bool appendVecNum(Vec * vec, long val) {
 bool appendVecStr(Vec * vec, const char * str) {
     if (!vec) return false;
 
-    vec->count++;
-    if (vec->capacity < vec->count) {
-        if (!setVecCapacity((void **)&vec->entries, calcNewVecCap(vec->capacity), sizeof(VecEntry))) return false;
-    }
+    if (!reserveVecEntry(vec)) return false;
 
     char * new_val = copyCString(str);
     if (!new_val) {
         fprintf(stderr, "Malloc failed %s %d\n", __FILE__, __LINE__);
         return false;
     }
+    vec->count++;
     vec->entries[vec->count-1].val = new_val;
     vec->entries[vec->count-1].type = VEC_ENTRY_STR;
 
@@ -274,18 +397,10 @@ bool appendVecStr(Vec * vec, const char * str) {
 bool appendVecDec(Vec * vec, double val) {
     if (!vec) return false;
 
+    if (!reserveVecEntry(vec)) return false;
     vec->count++;
-    if (vec->capacity < vec->count) {
-        if (!setVecCapacity((void **)&vec->entries, calcNewVecCap(vec->capacity), sizeof(VecEntry))) return false;
-    }
 
-    double * new_val = malloc(sizeof(double));
-    if (!new_val) {
-        fprintf(stderr, "Malloc failed %s %d\n", __FILE__, __LINE__);
-        return false;
-    }
-    *new_val = val;
-    vec->entries[vec->count-1].val = new_val;
+    vec->entries[vec->count-1].dec = val;
     vec->entries[vec->count-1].type = VEC_ENTRY_DEC;
 
     return true;
@@ -294,10 +409,8 @@ bool appendVecDec(Vec * vec, double val) {
 bool appendVec(Vec * vec, void * val) {
     if (!vec) return false;
 
+    if (!reserveVecEntry(vec)) return false;
     vec->count++;
-    if (vec->capacity < vec->count) {
-        if (!setVecCapacity((void **)&vec->entries, calcNewVecCap(vec->capacity), sizeof(VecEntry))) return false;
-    }
 
     vec->entries[vec->count-1].val = val;
     vec->entries[vec->count-1].type = VEC_ENTRY_OTHER;
@@ -308,11 +421,8 @@ bool appendVec(Vec * vec, void * val) {
 void * updateVec(Vec vec, void * val, size_t i) {
     
     VecEntry * e = &vec.entries[i];
-    void * old = e->val;
-    if (e->type != VEC_ENTRY_OTHER) {
-        free(old);
-        old = NULL;
-    }
+    void * old = e->type == VEC_ENTRY_OTHER ? e->val : NULL;
+    if (e->type == VEC_ENTRY_STR) free(e->val);
     
     e->val = val;
     e->type = VEC_ENTRY_OTHER;
@@ -321,7 +431,8 @@ void * updateVec(Vec vec, void * val, size_t i) {
 
 bool deleteVec(Vec * vec, void * ptr) {
     for (size_t i = vec->count - 1;; i--) {
-        if (ptr == vec->entries[i].val) {
+        const unsigned int type = vec->entries[i].type;
+        if ((type == VEC_ENTRY_STR || type == VEC_ENTRY_OTHER) && ptr == vec->entries[i].val) {
             if (!deleteVecRange(vec, i, i)) return false;
         }
 
@@ -343,7 +454,7 @@ bool deleteVecRange(Vec * vec, size_t start, size_t end ) {
 
     for (size_t i = start; i <= end; i++) {
         VecEntry * entry = &vec->entries[i];
-        if (entry->type != VEC_ENTRY_OTHER) {
+        if (entry->type == VEC_ENTRY_STR) {
             free(entry->val);
         }
         entry->type = VEC_ENTRY_OTHER;
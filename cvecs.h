@@ -27,17 +27,111 @@
 #define __VEC_H__
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 
 #define DEFAULT_CAP_VEC     69
 
+// Capacities grow by VEC_GROWTH_NUM / VEC_GROWTH_DEN, both may be defined before cvecs.h is included
+#ifndef VEC_GROWTH_NUM
+#define VEC_GROWTH_NUM      2
+#endif
+#ifndef VEC_GROWTH_DEN
+#define VEC_GROWTH_DEN      1
+#endif
+
+// Smallest capacity reached by growing capacity that holds needed elements, first is used for an empty vec
+static inline size_t growVecCapacity(size_t capacity, size_t first, size_t needed) {
+    size_t cap = capacity ? capacity : first;
+    while (cap < needed) {
+        if (cap > SIZE_MAX / VEC_GROWTH_NUM) return needed;
+        const size_t grown = cap * VEC_GROWTH_NUM / VEC_GROWTH_DEN;
+        cap = grown > cap ? grown : cap + 1;
+    }
+    return cap;
+}
+
+// Moves count elements of vals into memory for capacity elements, vals is not freed if it is inline_vals. NULL on failure.
+void * resizeVecMemory(void * vals, size_t capacity, size_t size, const void * inline_vals, size_t count);
+
+/** BEGIN OF TYPED VEC **/
+// Vec of TYPE with its elements stored inline in one array, starting at FIRST_CAPACITY once the first one is added
+#define DEFINE_VEC(NAME, TYPE, FIRST_CAPACITY) \
+    typedef struct NAME { \
+        size_t count; \
+        size_t capacity; \
+        TYPE * vals; \
+    } NAME; \
+    static inline NAME create##NAME(void) { \
+        return (NAME) { 0 }; \
+    } \
+    static inline void free##NAME(NAME vec) { \
+        free(vec.vals); \
+    } \
+    static inline bool reserve##NAME(NAME * vec, size_t capacity) { \
+        if (capacity <= vec->capacity) return true; \
+        const size_t new_cap = growVecCapacity(vec->capacity, FIRST_CAPACITY, capacity); \
+        TYPE * vals = resizeVecMemory(vec->vals, new_cap, sizeof(TYPE), NULL, vec->count); \
+        if (!vals) return false; \
+        vec->vals = vals; \
+        vec->capacity = new_cap; \
+        return true; \
+    } \
+    static inline bool append##NAME(NAME * vec, TYPE val) { \
+        if (vec->count == vec->capacity && !reserve##NAME(vec, vec->count + 1)) return false; \
+        vec->vals[vec->count++] = val; \
+        return true; \
+    }
+
+// Same with the first INLINE_CAPACITY elements stored inside the vec itself. vals points into the vec,
+// so it has to be initialized where it stays and must not be copied.
+#define DEFINE_SMALL_VEC(NAME, TYPE, INLINE_CAPACITY) \
+    typedef struct NAME { \
+        size_t count; \
+        size_t capacity; \
+        TYPE * vals; \
+        TYPE inline_vals[INLINE_CAPACITY]; \
+    } NAME; \
+    static inline void init##NAME(NAME * vec) { \
+        vec->count = 0; \
+        vec->capacity = INLINE_CAPACITY; \
+        vec->vals = vec->inline_vals; \
+    } \
+    static inline void free##NAME(NAME * vec) { \
+        if (vec->vals != vec->inline_vals) free(vec->vals); \
+        init##NAME(vec); \
+    } \
+    static inline bool reserve##NAME(NAME * vec, size_t capacity) { \
+        if (capacity <= vec->capacity) return true; \
+        const size_t new_cap = growVecCapacity(vec->capacity, INLINE_CAPACITY, capacity); \
+        TYPE * vals = resizeVecMemory(vec->vals, new_cap, sizeof(TYPE), vec->inline_vals, vec->count); \
+        if (!vals) return false; \
+        vec->vals = vals; \
+        vec->capacity = new_cap; \
+        return true; \
+    } \
+    static inline bool append##NAME(NAME * vec, TYPE val) { \
+        if (vec->count == vec->capacity && !reserve##NAME(vec, vec->count + 1)) return false; \
+        vec->vals[vec->count++] = val; \
+        return true; \
+    }
+/** END OF TYPED VEC **/
+
+DEFINE_VEC(ByteBuf, char, 4096)
+
 /** BEGIN OF VEC **/
 #define VEC_ENTRY_OTHER     0
 #define VEC_ENTRY_NUM       1
 #define VEC_ENTRY_DEC       2
 #define VEC_ENTRY_STR       3
 
+// Numbers and decimals are stored in the entry, strings are owned copies
 typedef struct VecEntry {
-    void * val;
+    union {
+        void * val;
+        long num;
+        double dec;
+    };
     unsigned int type;
 } VecEntry;
 
@@ -56,25 +150,45 @@ bool appendVecStr(Vec * vec, const char * str);       // Appends String to Vec
 bool appendVecDec(Vec * vec, double val);             // Appends Decimal Number to Vec
 bool appendVec(Vec * vec, void * val);                // Appends generic to Vec
 void * updateVec(Vec vec, void * val, size_t i);        // Updates Value to Vec
-bool deleteVec(Vec * vec, void * ptr);                // Deletes Ptr from Vec
+bool deleteVec(Vec * vec, void * ptr);                // Deletes Ptr from Vec, numbers and decimals are never matched
 bool deleteVecRange(Vec * vec, size_t start, size_t end ); // Removes range(start, end) from vec
 /** END OF VEC **/
 
 /** BEGIN OF STRVEC **/
 #ifndef __USE_CSTRING__ // There is another Library from me called CString https://github.com/MarvinKatapult/cstring
+// Offset and length of a string inside the bytes of a StrVec
+typedef struct StrSpan {
+    size_t offset;
+    size_t length;
+} StrSpan;
+
+// Strings are stored NUL terminated back to back in one byte arena, vals[i] points at string i and is
+// moved along when the arena grows. An interned StrVec stores equal strings once and finds them by hash.
 typedef struct StrVec {
     size_t count;
     size_t capacity;
     char ** vals;
+    StrSpan * spans;
+    char * bytes;
+    size_t byte_count;
+    size_t byte_capacity;
+    size_t * table;        // Open addressing table of indices of distinct strings, only used when interning
+    size_t table_capacity;
+    size_t distinct;       // Strings entered into table
+    bool intern;
 } StrVec;
 
-StrVec createStrVec(void);              // Creates a StrVec with capacity (Normally put DEFAULT_CAP_VEC)
-StrVec createStrVecEx(size_t capacity); // Creates a StrVec with capacity (Normally put DEFAULT_CAP_VEC)
-void freeStrVec(StrVec str_vec);        // Frees Memory of StrVec
+StrVec createStrVec(void);                      // Creates a StrVec with capacity (Normally put DEFAULT_CAP_VEC)
+StrVec createStrVecEx(size_t capacity);         // Creates a StrVec with capacity (Normally put DEFAULT_CAP_VEC)
+StrVec createInternedStrVec(size_t capacity);   // Creates a StrVec that stores equal strings once
+void freeStrVec(StrVec str_vec);                // Frees Memory of StrVec
+void clearStrVec(StrVec * str_vec);             // Removes all strings but keeps the Memory
 
-bool appendStrVec(StrVec * str_vec, const char * str);           // Appends to StrVec
-bool updateStrVec(StrVec str_vec, const char * str, size_t pos); // Updates Value at position
-bool setStrVecCapacity(StrVec * str_vec, size_t cap);            // Sets Capacity and reallocs
+bool appendStrVec(StrVec * str_vec, const char * str);              // Appends to StrVec
+bool appendStrVecN(StrVec * str_vec, const char * str, size_t len); // Appends the first len characters of str
+size_t findStrVec(const StrVec * str_vec, const char * str, size_t len); // Index of the first len characters of str, count if not found
+bool updateStrVec(StrVec * str_vec, const char * str, size_t pos);  // Updates Value at position, the old bytes are kept until clearStrVec
+bool setStrVecCapacity(StrVec * str_vec, size_t cap);               // Sets Capacity and reallocs
 /** END OF STRVEC **/
 
 #else
@@ -131,10 +245,10 @@ bool setIntVecCapacity(IntVec * int_vec, size_t cap); // Sets Capacity and reall
     for (size_t i = 0; i < VEC.count; i++) { \
         switch (VEC.entries[i].type) { \
             case VEC_ENTRY_NUM: \
-                printf("%d\n", *(int *)VEC.entries[i].val); \
+                printf("%ld\n", VEC.entries[i].num); \
                 break; \
             case VEC_ENTRY_DEC: \
-                printf("%f\n", *(double *)VEC.entries[i].val); \
+                printf("%f\n", VEC.entries[i].dec); \
                 break; \
             case VEC_ENTRY_STR: \
                 printf("%s\n", (char *)VEC.entries[i].val); \
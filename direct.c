@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "direct.h"
+#include "syntax.h"
+#include "parallel.h"
+
+// The full pipeline reduces long chains with calculateResultParallel, whose last bits may differ
+#if DIRECT_MAX_LENGTH >= 2 * PARALLEL_MIN_TERMS - 1
+#error "DIRECT_MAX_LENGTH must stay below the chain length calculateResultParallel reduces"
+#endif
+
+typedef struct DirectVariables {
+    const DirectVariable * vals;
+    size_t count;
+} DirectVariables;
+
+// Same lookup as findVariable, the first binding of a name wins
+static bool findDirectValue(const void * variables, const char * name, size_t len, double * value) {
+    const DirectVariables * bound = variables;
+    for (size_t i = 0; i < bound->count; i++) {
+        if (bound->vals[i].len != len || memcmp(bound->vals[i].name, name, len) != 0) continue;
+        *value = bound->vals[i].value;
+        return true;
+    }
+    return false;
+}
+
+// Same rules and order of operations as createSyntaxTree and calculateResult
+bool evaluateDirect(const char * expression, const DirectVariable * variables, size_t variable_count, double * result, size_t * token_count) {
+    const size_t len = strnlen(expression, DIRECT_MAX_LENGTH + 1);
+    if (len > DIRECT_MAX_LENGTH) return false;
+
+    double values[DIRECT_STACK_CAPACITY];
+    StackedOperator operators[DIRECT_STACK_CAPACITY];
+    const DirectVariables bound = { variables, variable_count };
+    OperatorStacks stacks = createFixedOperatorStacks(values, operators, DIRECT_STACK_CAPACITY, findDirectValue, &bound);
+    size_t count = 0;
+    size_t pos = 0;
+    for (;;) {
+        Token token;
+        if (!nextToken(expression, len, &pos, &token)) return false;
+        if (!token.length) break;
+        count++;
+        if (!pushOperatorToken(&stacks, expression, 0, &token)) return false;
+    }
+    if (!finishOperatorStacks(&stacks, result)) return false;
+    *token_count = count;
+    return true;
+}
+
+int runDirect(int argc, char * argv[]) {
+    DirectVariable variables[DIRECT_MAX_VARIABLES];
+    size_t variable_count = 0;
+    const char * expression = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--var") == 0 && i + 1 < argc) {
+            const char * assignment = argv[++i];
+            const char * equals = strchr(assignment, '=');
+            if (!equals || variable_count == DIRECT_MAX_VARIABLES) return DIRECT_FALLBACK;
+            variables[variable_count++] = (DirectVariable) { assignment, (size_t)(equals - assignment), strtod(equals + 1, NULL) };
+            continue;
+        }
+        // Every other option changes what is printed
+        if (strncmp(argv[i], "--", 2) == 0) return DIRECT_FALLBACK;
+        expression = argv[i];
+    }
+
+    double result;
+    size_t token_count;
+    if (!expression || !evaluateDirect(expression, variables, variable_count, &result, &token_count)) return DIRECT_FALLBACK;
+
+    // stdio would allocate the buffer of stdout, the output is the one of the full pipeline
+    static char stdout_buffer[BUFSIZ];
+    setvbuf(stdout, stdout_buffer, _IOFBF, sizeof(stdout_buffer));
+    printf("Starting to calculate Result of Expression:>%s<\n", expression);
+    printf("-- Tokenizing\n");
+    printf("-- Tokenizing Sucess! (%zu Tokens)\n", token_count);
+    printf("-- Creating Syntax Tree\n");
+    printf("-- Creating Syntax Tree Sucess!\n");
+    printf("-- Resolving Syntaxtree\n");
+    printf("Result of Expression:\n%lf\n", result);
+    return 0;
+}
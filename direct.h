@@ -0,0 +1,34 @@
+#ifndef __DIRECT_H__
+#define __DIRECT_H__
+#include <stdbool.h>
+#include <stddef.h>
+
+// All may be defined when compiling direct.c
+#ifndef DIRECT_MAX_LENGTH
+#define DIRECT_MAX_LENGTH    4096 // Longer expressions go through the full pipeline
+#endif
+#ifndef DIRECT_STACK_CAPACITY
+#define DIRECT_STACK_CAPACITY 64  // Values and operators waiting at once, deeper nesting goes through the full pipeline
+#endif
+#ifndef DIRECT_MAX_VARIABLES
+#define DIRECT_MAX_VARIABLES  16
+#endif
+#define DIRECT_FALLBACK      (-2) // runDirect left the command line to the full pipeline
+
+typedef struct DirectVariable {
+    const char * name;
+    size_t len;
+    double value;
+} DirectVariable;
+
+// Evaluates expression straight from its characters with fixed OperatorStacks and without allocating.
+// Results are those of calculateResult. False if the expression is too long, nested too deep or has
+// any error, the full pipeline then evaluates it and reports the error.
+bool evaluateDirect(const char * expression, const DirectVariable * variables, size_t variable_count, double * result, size_t * token_count);
+
+// Evaluates a command line of only --var Name=Value and an expression with evaluateDirect and prints
+// what the full pipeline prints. Returns DIRECT_FALLBACK for every other command line, before anything
+// is allocated or printed.
+int runDirect(int argc, char * argv[]);
+
+#endif // __DIRECT_H__
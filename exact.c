@@ -0,0 +1,910 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "exact.h"
+#include "number.h"
+
+#define EXACT_MAX_BITS        (1ull << 30) // Largest numerator or denominator a power may create
+#define EXACT_MAX_EXPONENT    1000000      // Largest exponent a literal may have
+#define EXACT_FRACTION_DIGITS 40           // Digits of a fraction printed after the decimal point
+#define DECIMAL_CHUNK         10000000000000000000u // 10^19, the largest power of ten in a limb
+#define DECIMAL_CHUNK_DIGITS  19
+#define MIN_KARATSUBA         4            // Karatsuba needs halves of at least two limbs
+
+typedef unsigned __int128 DoubleLimb;
+
+size_t exact_karatsuba_threshold = 32;
+
+LimbPool createLimbPool(void) {
+    return (LimbPool) { 0 };
+}
+
+void freeLimbPool(LimbPool * pool) {
+    for (size_t c = 0; c < LIMB_POOL_CLASSES; c++) {
+        uint64_t * block = pool->free_blocks[c];
+        while (block) {
+            uint64_t * next;
+            memcpy(&next, block, sizeof(next));
+            free(block);
+            block = next;
+        }
+        pool->free_blocks[c] = NULL;
+    }
+}
+
+static size_t blockClass(size_t count) {
+    size_t c = 0;
+    while (c < LIMB_POOL_CLASSES && ((size_t)4 << c) < count) c++;
+    return c;
+}
+
+// Returns a buffer of at least count limbs, its real size is stored in capacity
+static uint64_t * takeLimbs(LimbPool * pool, size_t count, size_t * capacity) {
+    const size_t c = blockClass(count);
+    if (c >= LIMB_POOL_CLASSES) return NULL;
+    *capacity = (size_t)4 << c;
+    uint64_t * block = pool->free_blocks[c];
+    if (block) {
+        memcpy(&pool->free_blocks[c], block, sizeof(block));
+        pool->reused++;
+        return block;
+    }
+    block = malloc(*capacity * sizeof(uint64_t));
+    if (block) pool->allocated++;
+    return block;
+}
+
+static void giveLimbs(LimbPool * pool, uint64_t * block, size_t capacity) {
+    if (!block) return;
+    const size_t c = blockClass(capacity);
+    memcpy(block, &pool->free_blocks[c], sizeof(block));
+    pool->free_blocks[c] = block;
+}
+
+/** Limb arrays **/
+
+// r = a + b for an >= bn, r has an limbs and may be a or b. Returns the carry.
+static uint64_t addLimbs(uint64_t * r, const uint64_t * a, size_t an, const uint64_t * b, size_t bn) {
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < bn; i++) {
+        const uint64_t sum = a[i] + carry;
+        const uint64_t overflow = sum < carry;
+        r[i] = sum + b[i];
+        carry = overflow | (r[i] < b[i]);
+    }
+    for (; i < an; i++) {
+        r[i] = a[i] + carry;
+        carry = r[i] < carry;
+    }
+    return carry;
+}
+
+// r = a - b for a >= b and an >= bn, r has an limbs and may be a or b. Returns the borrow.
+static uint64_t subLimbs(uint64_t * r, const uint64_t * a, size_t an, const uint64_t * b, size_t bn) {
+    uint64_t borrow = 0;
+    size_t i = 0;
+    for (; i < bn; i++) {
+        const uint64_t diff = a[i] - b[i];
+        const uint64_t underflow = a[i] < b[i];
+        r[i] = diff - borrow;
+        borrow = underflow | (diff < borrow);
+    }
+    for (; i < an; i++) {
+        const uint64_t diff = a[i] - borrow;
+        borrow = a[i] < borrow;
+        r[i] = diff;
+    }
+    return borrow;
+}
+
+static int compareLimbs(const uint64_t * a, size_t an, const uint64_t * b, size_t bn) {
+    if (an != bn) return an < bn ? -1 : 1;
+    for (size_t i = an; i-- > 0;) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// r = a * b with an + bn limbs, r must not overlap a or b
+static void mulSchoolbook(uint64_t * r, const uint64_t * a, size_t an, const uint64_t * b, size_t bn) {
+    memset(r, 0, (an + bn) * sizeof(uint64_t));
+    for (size_t i = 0; i < an; i++) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < bn; j++) {
+            const DoubleLimb t = (DoubleLimb)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = (uint64_t)t;
+            carry = (uint64_t)(t >> 64);
+        }
+        r[i + bn] = carry;
+    }
+}
+
+// r = a * b for n limbs each, r has 2n limbs and must not overlap a or b.
+// a * b = z2 * B^2h + (z1 - z2 - z0) * B^h + z0 with z1 = (a0 + a1)(b0 + b1), three half size products instead of four.
+static bool mulKaratsuba(LimbPool * pool, uint64_t * r, const uint64_t * a, const uint64_t * b, size_t n) {
+    if (n < exact_karatsuba_threshold || n < MIN_KARATSUBA) {
+        mulSchoolbook(r, a, n, b, n);
+        return true;
+    }
+    const size_t h = n / 2;
+    const size_t m = n - h;
+    size_t capacity;
+    uint64_t * scratch = takeLimbs(pool, 4 * (m + 1), &capacity);
+    if (!scratch) return false;
+    uint64_t * sum_a = scratch;
+    uint64_t * sum_b = scratch + m + 1;
+    uint64_t * z1 = scratch + 2 * (m + 1);
+
+    bool ok = mulKaratsuba(pool, r, a, b, h) && mulKaratsuba(pool, r + 2 * h, a + h, b + h, m);
+    if (ok) {
+        sum_a[m] = addLimbs(sum_a, a + h, m, a, h);
+        sum_b[m] = addLimbs(sum_b, b + h, m, b, h);
+        ok = mulKaratsuba(pool, z1, sum_a, sum_b, m + 1);
+    }
+    if (ok) {
+        size_t z1_count = 2 * (m + 1);
+        subLimbs(z1, z1, z1_count, r, 2 * h);
+        subLimbs(z1, z1, z1_count, r + 2 * h, 2 * m);
+        while (z1_count && !z1[z1_count - 1]) z1_count--;
+        addLimbs(r + h, r + h, 2 * n - h, z1, z1_count);
+    }
+    giveLimbs(pool, scratch, capacity);
+    return ok;
+}
+
+// r = a * b with an + bn limbs, r must not overlap a or b. Unbalanced operands are
+// multiplied in slices of the shorter length so every slice can use Karatsuba.
+static bool mulLimbs(LimbPool * pool, uint64_t * r, const uint64_t * a, size_t an, const uint64_t * b, size_t bn) {
+    if (an < bn) return mulLimbs(pool, r, b, bn, a, an);
+    if (bn < exact_karatsuba_threshold || bn < MIN_KARATSUBA) {
+        mulSchoolbook(r, a, an, b, bn);
+        return true;
+    }
+    if (an == bn) return mulKaratsuba(pool, r, a, b, an);
+
+    size_t capacity;
+    uint64_t * slice = takeLimbs(pool, 2 * bn, &capacity);
+    if (!slice) return false;
+    memset(r, 0, (an + bn) * sizeof(uint64_t));
+    bool ok = true;
+    size_t offset = 0;
+    for (; ok && offset + bn <= an; offset += bn) {
+        ok = mulKaratsuba(pool, slice, a + offset, b, bn);
+        if (ok) addLimbs(r + offset, r + offset, an + bn - offset, slice, 2 * bn);
+    }
+    if (ok && offset < an) {
+        ok = mulLimbs(pool, slice, b, bn, a + offset, an - offset);
+        if (ok) addLimbs(r + offset, r + offset, an + bn - offset, slice, bn + an - offset);
+    }
+    giveLimbs(pool, slice, capacity);
+    return ok;
+}
+
+// q = a / d for one limb d, q may be a. Returns the remainder.
+static uint64_t divSmall(uint64_t * q, const uint64_t * a, size_t n, uint64_t d) {
+    DoubleLimb rem = 0;
+    for (size_t i = n; i-- > 0;) {
+        const DoubleLimb cur = (rem << 64) | a[i];
+        q[i] = (uint64_t)(cur / d);
+        rem = cur % d;
+    }
+    return (uint64_t)rem;
+}
+
+static uint64_t modSmall(const uint64_t * a, size_t n, uint64_t d) {
+    DoubleLimb rem = 0;
+    for (size_t i = n; i-- > 0;) rem = ((rem << 64) | a[i]) % d;
+    return (uint64_t)rem;
+}
+
+// q = a / b and rem = a % b for an >= bn >= 2 with Knuth's algorithm D. q has an - bn + 1 limbs,
+// rem bn limbs, either may be NULL.
+static bool divLimbs(LimbPool * pool, uint64_t * q, uint64_t * rem, const uint64_t * a, size_t an, const uint64_t * b, size_t bn) {
+    size_t u_capacity, v_capacity;
+    uint64_t * u = takeLimbs(pool, an + 1, &u_capacity);
+    uint64_t * v = takeLimbs(pool, bn, &v_capacity);
+    if (!u || !v) {
+        giveLimbs(pool, u, u_capacity);
+        giveLimbs(pool, v, v_capacity);
+        return false;
+    }
+
+    // Shifting both until the top bit of b is set keeps every estimate of a quotient limb at most two too large
+    const int shift = __builtin_clzll(b[bn - 1]);
+    for (size_t i = bn; i-- > 0;) v[i] = shift ? (b[i] << shift) | (i ? b[i - 1] >> (64 - shift) : 0) : b[i];
+    u[an] = shift ? a[an - 1] >> (64 - shift) : 0;
+    for (size_t i = an; i-- > 0;) u[i] = shift ? (a[i] << shift) | (i ? a[i - 1] >> (64 - shift) : 0) : a[i];
+
+    for (size_t j = an - bn + 1; j-- > 0;) {
+        const DoubleLimb top = ((DoubleLimb)u[j + bn] << 64) | u[j + bn - 1];
+        DoubleLimb qhat = top / v[bn - 1];
+        DoubleLimb rhat = top % v[bn - 1];
+        while ((qhat >> 64) || qhat * v[bn - 2] > ((rhat << 64) | u[j + bn - 2])) {
+            qhat--;
+            rhat += v[bn - 1];
+            if (rhat >> 64) break;
+        }
+
+        uint64_t borrow = 0;
+        uint64_t carry = 0;
+        for (size_t i = 0; i < bn; i++) {
+            const DoubleLimb product = qhat * v[i] + carry;
+            carry = (uint64_t)(product >> 64);
+            const uint64_t low = (uint64_t)product;
+            const uint64_t diff = u[i + j] - low;
+            const uint64_t underflow = u[i + j] < low;
+            u[i + j] = diff - borrow;
+            borrow = underflow + (diff < borrow);
+        }
+        const DoubleLimb subtracted = (DoubleLimb)carry + borrow;
+        const bool negative = u[j + bn] < subtracted;
+        u[j + bn] = (uint64_t)(u[j + bn] - subtracted);
+        if (negative) {
+            qhat--;
+            u[j + bn] += addLimbs(u + j, u + j, bn, v, bn);
+        }
+        if (q) q[j] = (uint64_t)qhat;
+    }
+
+    if (rem) for (size_t i = 0; i < bn; i++) rem[i] = shift ? (u[i] >> shift) | (u[i + 1] << (64 - shift)) : u[i];
+    giveLimbs(pool, u, u_capacity);
+    giveLimbs(pool, v, v_capacity);
+    return true;
+}
+
+/** BigInt **/
+
+static void releaseBigInt(LimbPool * pool, BigInt * x) {
+    giveLimbs(pool, x->limbs, x->capacity);
+    *x = (BigInt) { 0 };
+}
+
+// Replaces x with value, which must not share limbs with x
+static void moveBigInt(LimbPool * pool, BigInt * x, BigInt * value) {
+    releaseBigInt(pool, x);
+    *x = *value;
+    *value = (BigInt) { 0 };
+}
+
+static void trimBigInt(BigInt * x) {
+    while (x->count && !x->limbs[x->count - 1]) x->count--;
+    if (!x->count) x->negative = false;
+}
+
+// Grows x to hold count limbs, keeps its value
+static bool reserveBigInt(LimbPool * pool, BigInt * x, size_t count) {
+    if (count <= x->capacity) return true;
+    size_t capacity;
+    uint64_t * limbs = takeLimbs(pool, count, &capacity);
+    if (!limbs) return false;
+    if (x->count) memcpy(limbs, x->limbs, x->count * sizeof(uint64_t));
+    giveLimbs(pool, x->limbs, x->capacity);
+    x->limbs = limbs;
+    x->capacity = capacity;
+    return true;
+}
+
+static bool setBigInt(LimbPool * pool, BigInt * x, uint64_t value) {
+    x->count = 0;
+    x->negative = false;
+    if (!value) return true;
+    if (!reserveBigInt(pool, x, 1)) return false;
+    x->limbs[0] = value;
+    x->count = 1;
+    return true;
+}
+
+static bool copyBigInt(LimbPool * pool, BigInt * dst, const BigInt * src) {
+    dst->count = 0;
+    if (!reserveBigInt(pool, dst, src->count)) return false;
+    if (src->count) memcpy(dst->limbs, src->limbs, src->count * sizeof(uint64_t));
+    dst->count = src->count;
+    dst->negative = src->negative;
+    return true;
+}
+
+static bool isOne(const BigInt * x) {
+    return x->count == 1 && x->limbs[0] == 1 && !x->negative;
+}
+
+// x = x * factor + add
+static bool mulAddSmall(LimbPool * pool, BigInt * x, uint64_t factor, uint64_t add) {
+    if (!reserveBigInt(pool, x, x->count + 1)) return false;
+    uint64_t carry = add;
+    for (size_t i = 0; i < x->count; i++) {
+        const DoubleLimb t = (DoubleLimb)x->limbs[i] * factor + carry;
+        x->limbs[i] = (uint64_t)t;
+        carry = (uint64_t)(t >> 64);
+    }
+    x->limbs[x->count++] = carry;
+    trimBigInt(x);
+    return true;
+}
+
+// r = a + b, or a - b with subtract. r may be a or b.
+static bool addBigInt(LimbPool * pool, BigInt * r, const BigInt * a, const BigInt * b, bool subtract) {
+    const bool b_negative = b->negative != subtract;
+    const BigInt * larger = a;
+    const BigInt * smaller = b;
+    bool negative = a->negative;
+    if (a->negative != b_negative && compareLimbs(a->limbs, a->count, b->limbs, b->count) < 0) {
+        larger = b;
+        smaller = a;
+        negative = b_negative;
+    } else if (a->negative == b_negative && a->count < b->count) {
+        larger = b;
+        smaller = a;
+    }
+
+    BigInt out = { 0 };
+    if (!reserveBigInt(pool, &out, larger->count + 1)) return false;
+    if (a->negative == b_negative) {
+        out.limbs[larger->count] = addLimbs(out.limbs, larger->limbs, larger->count, smaller->limbs, smaller->count);
+        out.count = larger->count + 1;
+    } else {
+        subLimbs(out.limbs, larger->limbs, larger->count, smaller->limbs, smaller->count);
+        out.count = larger->count;
+    }
+    out.negative = negative;
+    trimBigInt(&out);
+    moveBigInt(pool, r, &out);
+    return true;
+}
+
+// r = a * b, r may be a or b
+static bool mulBigInt(LimbPool * pool, BigInt * r, const BigInt * a, const BigInt * b) {
+    BigInt out = { 0 };
+    if (a->count && b->count) {
+        if (!reserveBigInt(pool, &out, a->count + b->count)) return false;
+        if (!mulLimbs(pool, out.limbs, a->limbs, a->count, b->limbs, b->count)) {
+            releaseBigInt(pool, &out);
+            return false;
+        }
+        out.count = a->count + b->count;
+        out.negative = a->negative != b->negative;
+        trimBigInt(&out);
+    }
+    moveBigInt(pool, r, &out);
+    return true;
+}
+
+// q = a / b truncated and rem = a % b with the sign of a for b != 0, either may be NULL or a or b
+static bool divModBigInt(LimbPool * pool, BigInt * q, BigInt * rem, const BigInt * a, const BigInt * b) {
+    BigInt quotient = { 0 };
+    BigInt remainder = { 0 };
+    if (compareLimbs(a->limbs, a->count, b->limbs, b->count) < 0) {
+        if (rem && !copyBigInt(pool, &remainder, a)) return false;
+    } else if (b->count == 1) {
+        if (!reserveBigInt(pool, &quotient, a->count) || !reserveBigInt(pool, &remainder, 1)) goto out_of_memory;
+        remainder.limbs[0] = divSmall(quotient.limbs, a->limbs, a->count, b->limbs[0]);
+        quotient.count = a->count;
+        remainder.count = 1;
+    } else {
+        if (!reserveBigInt(pool, &quotient, a->count - b->count + 1) || !reserveBigInt(pool, &remainder, b->count)) goto out_of_memory;
+        if (!divLimbs(pool, quotient.limbs, remainder.limbs, a->limbs, a->count, b->limbs, b->count)) goto out_of_memory;
+        quotient.count = a->count - b->count + 1;
+        remainder.count = b->count;
+    }
+    quotient.negative = a->negative != b->negative;
+    remainder.negative = a->negative;
+    trimBigInt(&quotient);
+    trimBigInt(&remainder);
+    if (q) moveBigInt(pool, q, &quotient);
+    if (rem) moveBigInt(pool, rem, &remainder);
+    releaseBigInt(pool, &quotient);
+    releaseBigInt(pool, &remainder);
+    return true;
+
+out_of_memory:
+    releaseBigInt(pool, &quotient);
+    releaseBigInt(pool, &remainder);
+    return false;
+}
+
+// g = gcd(|a|, |b|) with Euclid's algorithm
+static bool gcdBigInt(LimbPool * pool, BigInt * g, const BigInt * a, const BigInt * b) {
+    BigInt x = { 0 };
+    BigInt y = { 0 };
+    BigInt rem = { 0 };
+    if ((a->count == 1 && a->limbs[0] == 1) || (b->count == 1 && b->limbs[0] == 1)) return setBigInt(pool, g, 1);
+    bool ok = copyBigInt(pool, &x, a) && copyBigInt(pool, &y, b);
+    x.negative = y.negative = false;
+    while (ok && y.count) {
+        // Once one operand fits into a limb the rest of the algorithm runs on plain integers
+        if (y.count == 1) {
+            uint64_t u = y.limbs[0];
+            uint64_t v = modSmall(x.limbs, x.count, u);
+            while (v) {
+                const uint64_t next = u % v;
+                u = v;
+                v = next;
+            }
+            ok = setBigInt(pool, &x, u);
+            break;
+        }
+        ok = divModBigInt(pool, NULL, &rem, &x, &y);
+        BigInt swap = x;
+        x = y;
+        y = rem;
+        rem = swap;
+    }
+    if (ok) moveBigInt(pool, g, &x);
+    releaseBigInt(pool, &x);
+    releaseBigInt(pool, &y);
+    releaseBigInt(pool, &rem);
+    return ok;
+}
+
+// r = base^exponent by squaring, r may be base
+static bool powBigInt(LimbPool * pool, BigInt * r, const BigInt * base, uint64_t exponent) {
+    BigInt result = { 0 };
+    BigInt square = { 0 };
+    bool ok = setBigInt(pool, &result, 1) && copyBigInt(pool, &square, base);
+    for (; ok && exponent; exponent >>= 1) {
+        if (exponent & 1) ok = mulBigInt(pool, &result, &result, &square);
+        if (ok && exponent > 1) ok = mulBigInt(pool, &square, &square, &square);
+    }
+    if (ok) moveBigInt(pool, r, &result);
+    releaseBigInt(pool, &result);
+    releaseBigInt(pool, &square);
+    return ok;
+}
+
+static size_t bitLength(const BigInt * x) {
+    if (!x->count) return 0;
+    return x->count * 64 - (size_t)__builtin_clzll(x->limbs[x->count - 1]);
+}
+
+// Decimal digits of |x|, chunks of 19 digits are divided off from the lowest
+static char * bigIntToStr(LimbPool * pool, const BigInt * x) {
+    BigInt rest = { 0 };
+    const size_t chunk_count = x->count * 64 / 63 + 1; // 10^19 > 2^63
+    uint64_t * chunks = malloc(chunk_count * sizeof(uint64_t));
+    char * str = malloc(chunk_count * DECIMAL_CHUNK_DIGITS + 1);
+    if (!chunks || !str || !copyBigInt(pool, &rest, x)) {
+        free(chunks);
+        free(str);
+        releaseBigInt(pool, &rest);
+        return NULL;
+    }
+
+    size_t count = 0;
+    do {
+        chunks[count++] = divSmall(rest.limbs, rest.limbs, rest.count, DECIMAL_CHUNK);
+        trimBigInt(&rest);
+    } while (rest.count);
+
+    size_t len = (size_t)sprintf(str, "%llu", (unsigned long long)chunks[count - 1]);
+    for (size_t i = count - 1; i-- > 0;) len += (size_t)sprintf(str + len, "%019llu", (unsigned long long)chunks[i]);
+    free(chunks);
+    releaseBigInt(pool, &rest);
+    return str;
+}
+
+/** Rational **/
+
+void freeRational(LimbPool * pool, Rational * value) {
+    releaseBigInt(pool, &value->num);
+    releaseBigInt(pool, &value->den);
+}
+
+// Divides numerator and denominator by their greatest common divisor and moves the sign into the numerator
+static bool normalizeRational(LimbPool * pool, Rational * x) {
+    if (x->den.negative) {
+        x->den.negative = false;
+        x->num.negative = !x->num.negative && x->num.count;
+    }
+    if (!x->num.count) return setBigInt(pool, &x->den, 1);
+    if (isOne(&x->den)) return true;
+
+    BigInt g = { 0 };
+    bool ok = gcdBigInt(pool, &g, &x->num, &x->den);
+    if (ok && !isOne(&g)) {
+        BigInt q = { 0 };
+        ok = divModBigInt(pool, &q, NULL, &x->num, &g);
+        if (ok) moveBigInt(pool, &x->num, &q);
+        ok = ok && divModBigInt(pool, &q, NULL, &x->den, &g);
+        if (ok) moveBigInt(pool, &x->den, &q);
+        releaseBigInt(pool, &q);
+    }
+    releaseBigInt(pool, &g);
+    return ok;
+}
+
+// r = a / g for a g that divides a, r may be a
+static bool divExact(LimbPool * pool, BigInt * r, const BigInt * a, const BigInt * g) {
+    if (isOne(g)) return copyBigInt(pool, r, a);
+    return divModBigInt(pool, r, NULL, a, g);
+}
+
+// Both operands are in lowest terms, so only the gcd of the denominators can be a common factor (Knuth 4.5.1)
+static bool addRational(LimbPool * pool, const Rational * a, const Rational * b, bool subtract, Rational * out) {
+    BigInt g = { 0 };
+    BigInt t = { 0 };
+    bool ok = gcdBigInt(pool, &g, &a->den, &b->den);
+    if (ok && isOne(&g)) {
+        ok = mulBigInt(pool, &out->num, &a->num, &b->den)
+          && mulBigInt(pool, &t, &b->num, &a->den)
+          && addBigInt(pool, &out->num, &out->num, &t, subtract)
+          && mulBigInt(pool, &out->den, &a->den, &b->den);
+    } else if (ok) {
+        // num = a.num * (b.den / g) + b.num * (a.den / g) can only share factors of g with the denominator
+        ok = divExact(pool, &t, &b->den, &g)
+          && mulBigInt(pool, &out->num, &a->num, &t)
+          && mulBigInt(pool, &out->den, &a->den, &t)
+          && divExact(pool, &t, &a->den, &g)
+          && mulBigInt(pool, &t, &b->num, &t)
+          && addBigInt(pool, &out->num, &out->num, &t, subtract)
+          && gcdBigInt(pool, &t, &out->num, &g);
+        if (ok && !isOne(&t) && out->num.count) {
+            ok = divExact(pool, &out->num, &out->num, &t) && divExact(pool, &out->den, &out->den, &t);
+        }
+    }
+    if (ok && !out->num.count) ok = setBigInt(pool, &out->den, 1);
+    releaseBigInt(pool, &g);
+    releaseBigInt(pool, &t);
+    return ok;
+}
+
+// (a.num / g1) * (b.num / g2) / ((a.den / g2) * (b.den / g1)) with g1 = gcd(a.num, b.den) and g2 = gcd(b.num, a.den)
+static bool mulRational(LimbPool * pool, const BigInt * a_num, const BigInt * a_den, const BigInt * b_num, const BigInt * b_den, Rational * out) {
+    BigInt g1 = { 0 };
+    BigInt g2 = { 0 };
+    BigInt t = { 0 };
+    bool ok = gcdBigInt(pool, &g1, a_num, b_den)
+           && gcdBigInt(pool, &g2, b_num, a_den)
+           && divExact(pool, &out->num, a_num, &g1)
+           && divExact(pool, &t, b_num, &g2)
+           && mulBigInt(pool, &out->num, &out->num, &t)
+           && divExact(pool, &out->den, a_den, &g2)
+           && divExact(pool, &t, b_den, &g1)
+           && mulBigInt(pool, &out->den, &out->den, &t);
+    releaseBigInt(pool, &g1);
+    releaseBigInt(pool, &g2);
+    releaseBigInt(pool, &t);
+    if (ok && out->den.negative) {
+        out->den.negative = false;
+        out->num.negative = !out->num.negative && out->num.count;
+    }
+    if (ok && !out->num.count) ok = setBigInt(pool, &out->den, 1);
+    return ok;
+}
+
+static bool copyRational(LimbPool * pool, Rational * dst, const Rational * src) {
+    return copyBigInt(pool, &dst->num, &src->num) && copyBigInt(pool, &dst->den, &src->den);
+}
+
+// x = x * base^exponent for base 2 or 10 and a possibly negative exponent
+static bool scaleRational(LimbPool * pool, Rational * x, uint64_t base, int64_t exponent) {
+    if (!exponent) return true;
+    const uint64_t magnitude = (uint64_t)(exponent < 0 ? -exponent : exponent);
+    BigInt power = { 0 };
+    bool ok;
+    if (magnitude < (base == 2 ? 64 : DECIMAL_CHUNK_DIGITS + 1)) {
+        uint64_t value = 1;
+        for (uint64_t i = 0; i < magnitude; i++) value *= base;
+        ok = setBigInt(pool, &power, value);
+    } else {
+        ok = setBigInt(pool, &power, base) && powBigInt(pool, &power, &power, magnitude);
+    }
+    if (ok) ok = exponent > 0 ? mulBigInt(pool, &x->num, &x->num, &power) : mulBigInt(pool, &x->den, &x->den, &power);
+    releaseBigInt(pool, &power);
+    return ok && normalizeRational(pool, x);
+}
+
+static int digitValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') return (c | 0x20) - 'a' + 10;
+    return -1;
+}
+
+// The literal was already accepted by parseNumber, so only its digits and exponent are read again
+bool parseExact(LimbPool * pool, const char * str, size_t len, Rational * value) {
+    double unused;
+    if (!len || parseNumber(str, len, &unused) != len) {
+        snprintf(err_msg, sizeof(err_msg), "Invalid Number >%.*s<\n", (int)len, str);
+        return false;
+    }
+    const bool hex = len > 2 && str[0] == '0' && (str[1] | 0x20) == 'x';
+    const unsigned radix = hex ? 16 : 10;
+    const char exponent_letter = hex ? 'p' : 'e';
+
+    freeRational(pool, value);
+    if (!setBigInt(pool, &value->num, 0) || !setBigInt(pool, &value->den, 1)) goto out_of_memory;
+
+    // Digits are collected into one limb until the next digit could overflow it
+    uint64_t chunk = 0;
+    uint64_t chunk_scale = 1;
+    int64_t exponent = 0;
+    bool fraction = false;
+    size_t i = hex ? 2 : 0;
+    for (; i < len && (str[i] | 0x20) != exponent_letter; i++) {
+        if (str[i] == '_') continue;
+        if (str[i] == '.') {
+            fraction = true;
+            continue;
+        }
+        chunk = chunk * radix + (uint64_t)digitValue(str[i]);
+        chunk_scale *= radix;
+        if (fraction) exponent -= hex ? 4 : 1;
+        if (chunk_scale > UINT64_MAX / 16) {
+            if (!mulAddSmall(pool, &value->num, chunk_scale, chunk)) goto out_of_memory;
+            chunk = 0;
+            chunk_scale = 1;
+        }
+    }
+    if (chunk_scale > 1 && !mulAddSmall(pool, &value->num, chunk_scale, chunk)) goto out_of_memory;
+
+    if (i < len) {
+        bool negative = false;
+        int64_t written = 0;
+        for (i++; i < len; i++) {
+            if (str[i] == '-') negative = true;
+            if (str[i] < '0' || str[i] > '9' || written > EXACT_MAX_EXPONENT) continue;
+            written = written * 10 + (str[i] - '0');
+        }
+        exponent += negative ? -written : written;
+    }
+    if (exponent > EXACT_MAX_EXPONENT || exponent < -EXACT_MAX_EXPONENT) {
+        snprintf(err_msg, sizeof(err_msg), "Exponent of >%.*s< is too large for exact mode\n", (int)len, str);
+        freeRational(pool, value);
+        return false;
+    }
+    if (!value->num.count) return true;
+    if (!scaleRational(pool, value, hex ? 2 : 10, exponent)) goto out_of_memory;
+    return true;
+
+out_of_memory:
+    snprintf(err_msg, sizeof(err_msg), "Out of memory in exact mode\n");
+    freeRational(pool, value);
+    return false;
+}
+
+// result = base^exponent for an integer exponent
+static bool powRational(LimbPool * pool, const Rational * base, const Rational * exponent, Rational * result) {
+    if (!isOne(&exponent->den) || exponent->num.count > 1 || (exponent->num.count && exponent->num.limbs[0] > INT64_MAX)) {
+        snprintf(err_msg, sizeof(err_msg), "Exact mode only supports integer exponents that fit into 63 bits\n");
+        return false;
+    }
+    const uint64_t power = exponent->num.count ? exponent->num.limbs[0] : 0;
+    const bool reciprocal = exponent->num.negative;
+    if (reciprocal && !base->num.count) {
+        snprintf(err_msg, sizeof(err_msg), "Division by zero\n");
+        return false;
+    }
+    // Only 0, 1 and -1 can be raised to any power, everything else grows by its bits each time
+    const size_t bits = bitLength(&base->num) > bitLength(&base->den) ? bitLength(&base->num) : bitLength(&base->den);
+    if (bits > 1 && power > EXACT_MAX_BITS / (bits - 1)) {
+        snprintf(err_msg, sizeof(err_msg), "Result of >^< is too large for exact mode\n");
+        return false;
+    }
+    if (bits <= 1) {
+        if (!copyRational(pool, result, base)) return false;
+        if (!power) return setBigInt(pool, &result->num, 1);
+        result->num.negative = result->num.negative && (power & 1);
+        return true;
+    }
+
+    Rational out = { 0 };
+    bool ok = powBigInt(pool, &out.num, reciprocal ? &base->den : &base->num, power)
+           && powBigInt(pool, &out.den, reciprocal ? &base->num : &base->den, power);
+    // Powers of coprime numbers stay coprime, only the sign may have to move into the numerator
+    if (ok && out.den.negative) {
+        out.den.negative = false;
+        out.num.negative = !out.num.negative;
+    }
+    if (ok) {
+        freeRational(pool, result);
+        *result = out;
+    } else {
+        freeRational(pool, &out);
+    }
+    return ok;
+}
+
+bool applyExactOperator(LimbPool * pool, const Rational * a, const Rational * b, Operator operator, Rational * result) {
+    Rational out = { 0 };
+    bool ok = true;
+    switch (operator) {
+        case OperatorPlus:
+        case OperatorMinus:
+            if (isOne(&a->den) && isOne(&b->den)) {
+                ok = addBigInt(pool, &out.num, &a->num, &b->num, operator == OperatorMinus) && setBigInt(pool, &out.den, 1);
+                break;
+            }
+            ok = addRational(pool, a, b, operator == OperatorMinus, &out);
+            break;
+        case OperatorMult:
+            ok = mulRational(pool, &a->num, &a->den, &b->num, &b->den, &out);
+            break;
+        case OperatorDiv:
+            if (!b->num.count) {
+                snprintf(err_msg, sizeof(err_msg), "Division by zero\n");
+                return false;
+            }
+            ok = mulRational(pool, &a->num, &a->den, &b->den, &b->num, &out);
+            break;
+        case OperatorPower:
+            if (!powRational(pool, a, b, &out)) {
+                freeRational(pool, &out);
+                return false;
+            }
+            break;
+        case OperatorNegate:
+            ok = copyRational(pool, &out, a);
+            out.num.negative = !out.num.negative && out.num.count;
+            break;
+        case OperatorSqrt:
+        case OperatorExp:
+        case OperatorLog:
+        case OperatorSin:
+        case OperatorCos:
+            snprintf(err_msg, sizeof(err_msg), "Function >%s< has no exact value\n", operatorToStr(operator));
+            return false;
+        case NoOperator:
+            snprintf(err_msg, sizeof(err_msg), "Cannot apply Operator >%s<\n", operatorToStr(operator));
+            return false;
+    }
+    if (!ok) {
+        freeRational(pool, &out);
+        snprintf(err_msg, sizeof(err_msg), "Out of memory in exact mode\n");
+        return false;
+    }
+    freeRational(pool, result);
+    *result = out;
+    return true;
+}
+
+// -123/45 = -2.7333333333333333333333333333333333333333...
+char * exactToStr(LimbPool * pool, const Rational * value) {
+    char * num = bigIntToStr(pool, &value->num);
+    if (!num) return NULL;
+    const char * sign = value->num.negative ? "-" : "";
+    if (isOne(&value->den)) {
+        char * str = malloc(strlen(num) + 2);
+        if (str) sprintf(str, "%s%s", sign, num);
+        free(num);
+        return str;
+    }
+
+    // Integer part and the first EXACT_FRACTION_DIGITS digits of the remainder times 10^digits / den
+    BigInt whole = { 0 };
+    BigInt rest = { 0 };
+    BigInt digits = { 0 };
+    BigInt scale = { 0 };
+    char * den = bigIntToStr(pool, &value->den);
+    char * whole_str = NULL;
+    char * digits_str = NULL;
+    char * str = NULL;
+    if (den && divModBigInt(pool, &whole, &rest, &value->num, &value->den) && setBigInt(pool, &scale, 10)
+        && powBigInt(pool, &scale, &scale, EXACT_FRACTION_DIGITS) && mulBigInt(pool, &rest, &rest, &scale)
+        && divModBigInt(pool, &digits, &rest, &rest, &value->den)) {
+        whole_str = bigIntToStr(pool, &whole);
+        digits_str = bigIntToStr(pool, &digits);
+    }
+    if (whole_str && digits_str) {
+        char fraction[EXACT_FRACTION_DIGITS + 1];
+        const size_t digit_len = strlen(digits_str);
+        memset(fraction, '0', EXACT_FRACTION_DIGITS);
+        memcpy(fraction + EXACT_FRACTION_DIGITS - digit_len, digits_str, digit_len);
+        size_t fraction_len = EXACT_FRACTION_DIGITS;
+        while (fraction_len > 1 && fraction[fraction_len - 1] == '0') fraction_len--;
+        fraction[fraction_len] = '\0';
+        str = malloc(strlen(num) + strlen(den) + strlen(whole_str) + EXACT_FRACTION_DIGITS + 16);
+        if (str) sprintf(str, "%s%s/%s = %s%s.%s%s", sign, num, den, sign, whole_str, fraction, rest.count ? "..." : "");
+    }
+    free(num);
+    free(den);
+    free(whole_str);
+    free(digits_str);
+    releaseBigInt(pool, &whole);
+    releaseBigInt(pool, &rest);
+    releaseBigInt(pool, &digits);
+    releaseBigInt(pool, &scale);
+    return str;
+}
+
+// Without sharing every node is used once and value nodes are created in the order of their tokens
+bool calculateExact(LimbPool * pool, const NodeArena * arena, NodeIndex root, const char * expression, const TokenVec * tokens,
+                    const Rational * variables, Rational * result) {
+    Rational * values = calloc((size_t)root + 1, sizeof(Rational));
+    if (!values) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory in exact mode\n");
+        return false;
+    }
+
+    bool ok = true;
+    size_t token = 0;
+    for (NodeIndex current = 0; ok && current <= root; current++) {
+        if (arena->types[current] == TokenValue) {
+            while (tokens->vals[token].type != TokenValue) token++;
+            const Token * literal = &tokens->vals[token++];
+            const char * text = expression + literal->offset;
+            if (isalpha((unsigned char)text[0])) {
+                snprintf(err_msg, sizeof(err_msg), "Constant >%.*s< has no exact value\n", (int)literal->length, text);
+                ok = false;
+            } else {
+                ok = parseExact(pool, text, literal->length, &values[current]);
+            }
+            continue;
+        }
+        if (arena->types[current] == TokenVariable) {
+            if (!variables) {
+                snprintf(err_msg, sizeof(err_msg), "Variable >%s< has no value\n", arena->variables.vals[arena->lefts[current]]);
+                ok = false;
+                continue;
+            }
+            ok = copyRational(pool, &values[current], &variables[arena->lefts[current]]);
+            if (!ok) snprintf(err_msg, sizeof(err_msg), "Out of memory in exact mode\n");
+            continue;
+        }
+
+        const Operator operator = arena->operators[current];
+        const NodeIndex left = arena->lefts[current];
+        const NodeIndex right = isUnaryOperator(operator) ? left : arena->rights[current];
+        ok = applyExactOperator(pool, &values[left], &values[right], operator, &values[current]);
+        freeRational(pool, &values[left]);
+        freeRational(pool, &values[right]);
+    }
+
+    if (ok) {
+        freeRational(pool, result);
+        *result = values[root];
+        values[root] = (Rational) { 0 };
+    }
+    for (NodeIndex current = 0; current <= root; current++) freeRational(pool, &values[current]);
+    free(values);
+    return ok;
+}
+
+int runExact(const char * expression, const StrVec * bound_names, const char * const * bound_texts) {
+    TokenVec tokens = createTokenVec();
+    NodeArena arena = createNodeArena();
+    LimbPool pool = createLimbPool();
+    Rational * variables = NULL;
+    Rational result = { 0 };
+    char * str = NULL;
+    int status = -1;
+
+    if (!tokenize(expression, &tokens)) goto done;
+    const NodeIndex root = createSyntaxTree(&arena, expression, &tokens);
+    if (root == NO_NODE) goto done;
+
+    variables = calloc(arena.variables.count + 1, sizeof(Rational));
+    if (!variables) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory in exact mode\n");
+        goto done;
+    }
+    for (size_t i = 0; i < arena.variables.count; i++) {
+        const char * name = arena.variables.vals[i];
+        const size_t bound = findVariable(bound_names, name, strlen(name));
+        if (bound == bound_names->count) {
+            snprintf(err_msg, sizeof(err_msg), "Variable >%s< has no value\n", name);
+            goto done;
+        }
+        if (!parseExact(&pool, bound_texts[bound], strlen(bound_texts[bound]), &variables[i])) goto done;
+    }
+
+    if (!calculateExact(&pool, &arena, root, expression, &tokens, variables, &result)) goto done;
+    str = exactToStr(&pool, &result);
+    if (!str) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory in exact mode\n");
+        goto done;
+    }
+    printf("Result of Expression:\n%s\n", str);
+    status = 0;
+
+done:
+    if (status) fprintf(stderr, "%s", err_msg);
+    free(str);
+    freeRational(&pool, &result);
+    if (variables) for (size_t i = 0; i < arena.variables.count; i++) freeRational(&pool, &variables[i]);
+    free(variables);
+    freeLimbPool(&pool);
+    freeNodeArena(arena);
+    freeTokenVec(tokens);
+    return status;
+}
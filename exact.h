@@ -0,0 +1,53 @@
+#ifndef __EXACT_H__
+#define __EXACT_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cvecs.h"
+#include "syntax.h"
+
+#define LIMB_POOL_CLASSES 40 // Block sizes 4 << class limbs
+
+// Reuses limb buffers of freed numbers. Buffers are grouped by power of two size, a freed buffer
+// stores the next free buffer of its size in its first limb.
+typedef struct LimbPool {
+    uint64_t * free_blocks[LIMB_POOL_CLASSES];
+    size_t allocated; // Buffers taken from malloc
+    size_t reused;    // Buffers taken from the free lists
+} LimbPool;
+
+// Magnitude in little endian 64 bit limbs without leading zero limbs, zero has no limbs
+typedef struct BigInt {
+    uint64_t * limbs;
+    size_t count;
+    size_t capacity;
+    bool negative;
+} BigInt;
+
+// num / den in lowest terms with den > 0, an integer has den 1
+typedef struct Rational {
+    BigInt num;
+    BigInt den;
+} Rational;
+
+// Operands with at least this many limbs are multiplied with Karatsuba, SIZE_MAX always uses schoolbook
+extern size_t exact_karatsuba_threshold;
+
+LimbPool createLimbPool(void);                        // Creates an empty LimbPool
+void freeLimbPool(LimbPool * pool);                   // Frees every cached buffer
+void freeRational(LimbPool * pool, Rational * value); // Returns the limbs of value to pool
+
+bool parseExact(LimbPool * pool, const char * str, size_t len, Rational * value); // Exact value of a numeric literal
+bool applyExactOperator(LimbPool * pool, const Rational * a, const Rational * b, Operator operator, Rational * result);
+char * exactToStr(LimbPool * pool, const Rational * value); // Integer or num/den followed by its decimal expansion, NULL if out of memory
+
+// Evaluates the tree of tokens created without sharing or optimizing, literals are read again from expression.
+// variables holds one value per entry of arena->variables and may be NULL if there are none.
+bool calculateExact(LimbPool * pool, const NodeArena * arena, NodeIndex root, const char * expression, const TokenVec * tokens,
+                    const Rational * variables, Rational * result);
+
+// Evaluates expression exactly and prints the result, bound_texts[i] is the literal bound to bound_names->vals[i]
+int runExact(const char * expression, const StrVec * bound_names, const char * const * bound_texts);
+
+#endif // __EXACT_H__
@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "jit.h"
+#include "mathfn.h"
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+
+#define JIT_REGISTER_SLOTS 14      // Stack slots 0..13 live in xmm0..xmm13, the rest in the frame
+#define JIT_SCRATCH_A      14
+#define JIT_SCRATCH_B      15
+#define JIT_MAX_STACK      (1 << 16)
+
+#define REG_RSP 4
+#define REG_RBX 3
+
+#define SSE_PREFIX_SD  0xf2
+#define SSE_PREFIX_PD  0x66
+#define SSE_MOVSD_LOAD  0x10
+#define SSE_MOVSD_STORE 0x11
+#define SSE_MOVAPD      0x28
+#define SSE_SQRT        0x51
+#define SSE_ADD         0x58
+#define SSE_MUL         0x59
+#define SSE_SUB         0x5c
+#define SSE_DIV         0x5e
+
+typedef struct JitBuf {
+    size_t count;
+    size_t capacity;
+    uint8_t * vals;
+    bool failed;
+} JitBuf;
+
+static void emitBytes(JitBuf * buf, const void * bytes, size_t len) {
+    if (buf->count + len > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity : 4096;
+        while (capacity < buf->count + len) capacity *= 2;
+        uint8_t * vals = realloc(buf->vals, capacity);
+        if (!vals) {
+            buf->failed = true;
+            return;
+        }
+        buf->vals = vals;
+        buf->capacity = capacity;
+    }
+    memcpy(buf->vals + buf->count, bytes, len);
+    buf->count += len;
+}
+
+static void emitByte(JitBuf * buf, uint8_t byte) {
+    emitBytes(buf, &byte, 1);
+}
+
+static void emitInt32(JitBuf * buf, int32_t value) {
+    emitBytes(buf, &value, sizeof(value));
+}
+
+// prefix 0F opcode with two xmm registers
+static void emitSseRegs(JitBuf * buf, uint8_t prefix, uint8_t opcode, int reg, int rm) {
+    emitByte(buf, prefix);
+    if (reg >= 8 || rm >= 8) emitByte(buf, (uint8_t)(0x40 | ((reg >> 3) << 2) | (rm >> 3)));
+    emitByte(buf, 0x0f);
+    emitByte(buf, opcode);
+    emitByte(buf, (uint8_t)(0xc0 | ((reg & 7) << 3) | (rm & 7)));
+}
+
+// prefix 0F opcode with an xmm register and [base + disp], base is rsp or rbx
+static void emitSseMem(JitBuf * buf, uint8_t prefix, uint8_t opcode, int reg, int base, int32_t disp) {
+    emitByte(buf, prefix);
+    if (reg >= 8) emitByte(buf, 0x44);
+    emitByte(buf, 0x0f);
+    emitByte(buf, opcode);
+    emitByte(buf, (uint8_t)(0x80 | ((reg & 7) << 3) | base));
+    if (base == REG_RSP) emitByte(buf, 0x24);
+    emitInt32(buf, disp);
+}
+
+// movsd reg, [rip + disp], returns the position of disp so it can be patched later
+static size_t emitLoadRip(JitBuf * buf, int reg) {
+    emitByte(buf, SSE_PREFIX_SD);
+    if (reg >= 8) emitByte(buf, 0x44);
+    emitByte(buf, 0x0f);
+    emitByte(buf, SSE_MOVSD_LOAD);
+    emitByte(buf, (uint8_t)(0x05 | ((reg & 7) << 3)));
+    const size_t position = buf->count;
+    emitInt32(buf, 0);
+    return position;
+}
+
+// The first JIT_REGISTER_SLOTS doubles of the frame save registers, so slot i is always at [rsp + 8 * i]
+static int32_t slotOffset(size_t slot) {
+    return (int32_t)(slot * sizeof(double));
+}
+
+static bool slotInRegister(size_t slot) {
+    return slot < JIT_REGISTER_SLOTS;
+}
+
+// Makes the value of slot available in a register, scratch is used for slots in memory
+static int loadSlot(JitBuf * buf, size_t slot, int scratch) {
+    if (slotInRegister(slot)) return (int)slot;
+    emitSseMem(buf, SSE_PREFIX_SD, SSE_MOVSD_LOAD, scratch, REG_RSP, slotOffset(slot));
+    return scratch;
+}
+
+static void copyToRegister(JitBuf * buf, int reg, size_t slot) {
+    if (!slotInRegister(slot)) emitSseMem(buf, SSE_PREFIX_SD, SSE_MOVSD_LOAD, reg, REG_RSP, slotOffset(slot));
+    else if ((int)slot != reg) emitSseRegs(buf, SSE_PREFIX_PD, SSE_MOVAPD, reg, (int)slot);
+}
+
+// Register the value of slot has to be computed in, storeSlot writes it back if slot is in memory
+static int targetRegister(size_t slot) {
+    return slotInRegister(slot) ? (int)slot : JIT_SCRATCH_A;
+}
+
+static void storeSlot(JitBuf * buf, int reg, size_t slot) {
+    if (!slotInRegister(slot)) emitSseMem(buf, SSE_PREFIX_SD, SSE_MOVSD_STORE, reg, REG_RSP, slotOffset(slot));
+}
+
+static void emitNegate(JitBuf * buf, int reg) {
+    const uint8_t rex = reg >= 8 ? 0x4c : 0x48;
+    const uint8_t modrm = (uint8_t)(0xc0 | ((reg & 7) << 3));
+    const uint8_t bytes[] = {
+        0x66, rex, 0x0f, 0x7e, modrm,   // movq rax, xmm
+        0x48, 0x0f, 0xba, 0xf8, 0x3f,   // btc rax, 63
+        0x66, rex, 0x0f, 0x6e, modrm,   // movq xmm, rax
+    };
+    emitBytes(buf, bytes, sizeof(bytes));
+}
+
+// Calls function with the top one or two slots as arguments, its result replaces them.
+// Calls clobber every xmm register, the live slots below the operands are saved at [rsp].
+static void emitCall(JitBuf * buf, size_t depth, size_t operands, uintptr_t function) {
+    const size_t result = depth - operands;
+    const size_t live = result < JIT_REGISTER_SLOTS ? result : JIT_REGISTER_SLOTS;
+    for (size_t slot = 0; slot < live; slot++) {
+        emitSseMem(buf, SSE_PREFIX_SD, SSE_MOVSD_STORE, (int)slot, REG_RSP, (int32_t)(slot * sizeof(double)));
+    }
+    for (size_t operand = 0; operand < operands; operand++) copyToRegister(buf, (int)operand, result + operand);
+
+    const uint64_t address = function;
+    const uint8_t mov_rax[] = {0x48, 0xb8};
+    const uint8_t call_rax[] = {0xff, 0xd0};
+    emitBytes(buf, mov_rax, sizeof(mov_rax));
+    emitBytes(buf, &address, sizeof(address));
+    emitBytes(buf, call_rax, sizeof(call_rax));
+
+    if (slotInRegister(result)) {
+        if (result != 0) emitSseRegs(buf, SSE_PREFIX_PD, SSE_MOVAPD, (int)result, 0);
+    } else {
+        storeSlot(buf, 0, result);
+    }
+    for (size_t slot = 0; slot < live; slot++) {
+        emitSseMem(buf, SSE_PREFIX_SD, SSE_MOVSD_LOAD, (int)slot, REG_RSP, (int32_t)(slot * sizeof(double)));
+    }
+}
+
+static uint8_t opCodeToSse(OpCode op) {
+    switch (op) {
+        case OpAdd: return SSE_ADD;
+        case OpSub: return SSE_SUB;
+        case OpMul: return SSE_MUL;
+        default:    return SSE_DIV;
+    }
+}
+
+bool compileJit(const Program * program, JitCode * jit) {
+    *jit = (JitCode) { 0 };
+    if (program->max_stack + program->slot_count > JIT_MAX_STACK) {
+        snprintf(err_msg, sizeof(err_msg), "Expression is too deep to compile to native code\n");
+        return false;
+    }
+
+    // Frame: saved registers around calls, then the slots that do not fit into registers, then the shared slots
+    const size_t spilled = program->max_stack > JIT_REGISTER_SLOTS ? program->max_stack - JIT_REGISTER_SLOTS : 0;
+    const size_t shared = JIT_REGISTER_SLOTS + spilled;
+    const int32_t frame = (int32_t)(((shared + program->slot_count) * sizeof(double) + 15) & ~(size_t)15);
+    size_t * constant_fixups = malloc((program->constant_count ? program->constant_count : 1) * sizeof(size_t));
+    JitBuf buf = { 0 };
+    if (!constant_fixups) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while compiling to native code\n");
+        return false;
+    }
+
+    // push rbx; mov rbx, rdi; sub rsp, frame. The push aligns rsp to 16 bytes for calls.
+    const uint8_t prologue[] = {0x53, 0x48, 0x89, 0xfb, 0x48, 0x81, 0xec};
+    emitBytes(&buf, prologue, sizeof(prologue));
+    emitInt32(&buf, frame);
+
+    size_t depth = 0;
+    size_t constant = 0;
+    for (const Instruction * ip = program->code; INSTRUCTION_OP(*ip) != OpReturn; ip++) {
+        const OpCode op = (OpCode)INSTRUCTION_OP(*ip);
+        switch (op) {
+            case OpConst: {
+                const int reg = targetRegister(depth);
+                constant_fixups[constant++] = emitLoadRip(&buf, reg);
+                storeSlot(&buf, reg, depth++);
+                break;
+            }
+            case OpVar: {
+                const int reg = targetRegister(depth);
+                emitSseMem(&buf, SSE_PREFIX_SD, SSE_MOVSD_LOAD, reg, REG_RBX, (int32_t)(INSTRUCTION_ARG(*ip) * sizeof(double)));
+                storeSlot(&buf, reg, depth++);
+                break;
+            }
+            case OpDup: {
+                const int reg = targetRegister(depth);
+                copyToRegister(&buf, reg, depth - 1);
+                storeSlot(&buf, reg, depth++);
+                break;
+            }
+            case OpStore: {
+                const int reg = loadSlot(&buf, depth - 1, JIT_SCRATCH_A);
+                emitSseMem(&buf, SSE_PREFIX_SD, SSE_MOVSD_STORE, reg, REG_RSP, slotOffset(shared + INSTRUCTION_ARG(*ip)));
+                break;
+            }
+            case OpLoad: {
+                const int reg = targetRegister(depth);
+                emitSseMem(&buf, SSE_PREFIX_SD, SSE_MOVSD_LOAD, reg, REG_RSP, slotOffset(shared + INSTRUCTION_ARG(*ip)));
+                storeSlot(&buf, reg, depth++);
+                break;
+            }
+            case OpNeg:
+            case OpSqrt: {
+                const int reg = loadSlot(&buf, depth - 1, JIT_SCRATCH_A);
+                if (op == OpNeg) emitNegate(&buf, reg);
+                else             emitSseRegs(&buf, SSE_PREFIX_SD, SSE_SQRT, reg, reg);
+                storeSlot(&buf, reg, depth - 1);
+                break;
+            }
+            case OpPow:
+                emitCall(&buf, depth--, 2, (uintptr_t)pow);
+                break;
+            case OpExp:
+                emitCall(&buf, depth, 1, (uintptr_t)mathExp);
+                break;
+            case OpLog:
+                emitCall(&buf, depth, 1, (uintptr_t)mathLog);
+                break;
+            case OpSin:
+                emitCall(&buf, depth, 1, (uintptr_t)mathSin);
+                break;
+            case OpCos:
+                emitCall(&buf, depth, 1, (uintptr_t)mathCos);
+                break;
+            default: {
+                const int a = loadSlot(&buf, depth - 2, JIT_SCRATCH_A);
+                const int b = loadSlot(&buf, depth - 1, JIT_SCRATCH_B);
+                emitSseRegs(&buf, SSE_PREFIX_SD, opCodeToSse(op), a, b);
+                storeSlot(&buf, a, depth - 2);
+                depth--;
+                break;
+            }
+        }
+    }
+
+    // add rsp, frame; pop rbx; ret. The result is in slot 0, which is xmm0.
+    const uint8_t epilogue_add[] = {0x48, 0x81, 0xc4};
+    const uint8_t epilogue_ret[] = {0x5b, 0xc3};
+    emitBytes(&buf, epilogue_add, sizeof(epilogue_add));
+    emitInt32(&buf, frame);
+    emitBytes(&buf, epilogue_ret, sizeof(epilogue_ret));
+
+    // Constants follow the code, 8 byte aligned and addressed relative to rip
+    while (buf.count % sizeof(double)) emitByte(&buf, 0xcc);
+    const size_t constants = buf.count;
+    emitBytes(&buf, program->constants, program->constant_count * sizeof(double));
+    if (buf.failed) {
+        free(buf.vals);
+        free(constant_fixups);
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while compiling to native code\n");
+        return false;
+    }
+    for (size_t i = 0; i < constant; i++) {
+        const int32_t disp = (int32_t)(constants + i * sizeof(double) - (constant_fixups[i] + sizeof(int32_t)));
+        memcpy(buf.vals + constant_fixups[i], &disp, sizeof(disp));
+    }
+    free(constant_fixups);
+
+    // Written while writable, executed once it is read only
+    void * memory = mmap(NULL, buf.count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        free(buf.vals);
+        snprintf(err_msg, sizeof(err_msg), "Cannot map memory for native code\n");
+        return false;
+    }
+    memcpy(memory, buf.vals, buf.count);
+    free(buf.vals);
+    if (mprotect(memory, buf.count, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, buf.count);
+        snprintf(err_msg, sizeof(err_msg), "Cannot make native code executable\n");
+        return false;
+    }
+
+    jit->memory = memory;
+    jit->size = buf.count;
+    // Converting an object pointer to a function pointer is what dlsym relies on as well
+    *(void **)&jit->run = memory;
+    return true;
+}
+
+void freeJit(JitCode jit) {
+    if (jit.memory) munmap(jit.memory, jit.size);
+}
+
+#else
+
+bool compileJit(const Program * program, JitCode * jit) {
+    (void)program;
+    *jit = (JitCode) { 0 };
+    snprintf(err_msg, sizeof(err_msg), "Native code is only generated on x86-64\n");
+    return false;
+}
+
+void freeJit(JitCode jit) {
+    (void)jit;
+}
+
+#endif
+
+static bool sameResult(double a, double b) {
+    if (isnan(a) || isnan(b)) return isnan(a) && isnan(b);
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+bool verifyJit(const JitCode * jit, NodeArena * arena, NodeIndex root, size_t samples) {
+    static const double specials[] = {0.0, -0.0, 1.0, -1.0, 0.5, 2.0, 3.0, INFINITY, -INFINITY, NAN, 1e308, -1e308, 4.9e-324, 2.2e-308};
+    const size_t special_count = sizeof(specials) / sizeof(specials[0]);
+    const size_t variable_count = arena->variables.count;
+    double * variables = malloc((variable_count + 1) * sizeof(double));
+    if (!variables) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while verifying native code\n");
+        return false;
+    }
+
+    uint64_t state = 0x9e3779b97f4a7c15u;
+    for (size_t sample = 0; sample < samples; sample++) {
+        for (size_t i = 0; i < variable_count; i++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            if (state & 1) variables[i] = specials[(state >> 1) % special_count];
+            else           variables[i] = (double)(int64_t)(state >> 11) / (double)(1ull << 49) - 4.0;
+        }
+        double expected;
+        if (!calculateResult(arena, root, variables, &expected)) {
+            free(variables);
+            return false;
+        }
+        const double result = jit->run(variables);
+        if (!sameResult(result, expected)) {
+            snprintf(err_msg, sizeof(err_msg), "Native code returned %.17g where calculateResult returned %.17g\n", result, expected);
+            free(variables);
+            return false;
+        }
+    }
+    free(variables);
+    return true;
+}
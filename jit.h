@@ -0,0 +1,27 @@
+#ifndef __JIT_H__
+#define __JIT_H__
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "syntax.h"
+#include "vm.h"
+
+// Native code of a Program, variables are in the order of program->variables
+typedef double (*JitFunction)(const double * variables);
+
+typedef struct JitCode {
+    JitFunction run;
+    void * memory; // Executable mapping holding code and constants
+    size_t size;
+} JitCode;
+
+// Lowers program to x86-64 SSE2 code. Fails with err_msg on other architectures,
+// callers then keep evaluating program with runProgram.
+bool compileJit(const Program * program, JitCode * jit);
+void freeJit(JitCode jit); // Unmaps the code of jit
+
+// Compares jit against calculateResult on samples inputs mixing random values with
+// +-0, +-inf, nan and subnormals. Results have to be bit identical, every nan counts as equal.
+bool verifyJit(const JitCode * jit, NodeArena * arena, NodeIndex root, size_t samples);
+
+#endif // __JIT_H__
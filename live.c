@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+#include "live.h"
+
+#define LIVE_READ_SIZE 4096
+#define LIVE_MIN_WIDTH 20
+
+// Characters that always end the token in front of them, unlike + and - which may belong to an exponent
+#define IS_TOKEN_BREAK(C) (C == ' ' || C == '\n' || C == '\t' || C == '\r' || C == '*' || C == '/' || C == '^' || C == '(' || C == ')')
+#define IS_OPERAND_END(T) ((T)->type == TokenValue || (T)->type == TokenVariable || (T)->type == TokenParenClose)
+
+LiveExpression createLiveExpression(const StrVec * bound_names, const double * bound_values) {
+    LiveExpression live = {
+        .tokens = createTokenVec(),
+        .scratch = createTokenVec(),
+        .arena = createNodeArena(),
+        .bound_names = bound_names,
+        .bound_values = bound_values,
+    };
+    // The empty expression is a single empty term
+    if (reserveLiveTermVec(&live.terms, 1)) {
+        live.terms.vals[live.terms.count++] = (LiveTerm) { 0 };
+        live.invalid_terms = 1;
+    }
+    return live;
+}
+
+void freeLiveExpression(LiveExpression live) {
+    free(live.text);
+    freeTokenVec(live.tokens);
+    freeTokenVec(live.scratch);
+    freeLiveTermVec(live.terms);
+    freeLiveTermVec(live.new_terms);
+    free(live.variables);
+    freeNodeArena(live.arena);
+}
+
+// Tokenizes the pending characters and splices their tokens in place of the old ones.
+// Tokens first to old_end were replaced by the tokens first to new_end.
+static bool updateTokens(LiveExpression * live, size_t * first, size_t * old_end, size_t * new_end) {
+    TokenVec * tokens = &live->tokens;
+    const size_t count = tokens->count;
+    const size_t shift = live->len - live->lexed_len; // Wraps around for shorter texts, offsets wrap back
+
+    // A token ending right at the change may grow into it, so it is tokenized again
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if ((size_t)tokens->vals[mid].offset + tokens->vals[mid].length < live->pending_start) lo = mid + 1;
+        else                                                                                    hi = mid;
+    }
+    const size_t start = lo < count && tokens->vals[lo].offset < live->pending_start ? tokens->vals[lo].offset : live->pending_start;
+
+    // Old tokens are kept from the first one behind the change that cannot merge with the characters in front of it
+    size_t keep = lo;
+    while (keep < count && tokens->vals[keep].offset <= live->pending_end) keep++;
+    while (keep < count && !IS_TOKEN_BREAK(live->text[tokens->vals[keep].offset - 1 + shift])) keep++;
+    const size_t end = keep < count ? tokens->vals[keep].offset + shift : live->len;
+
+    live->scratch.count = 0;
+    if (!tokenizeRange(live->text, start, end, &live->scratch)) return false;
+    const size_t added = live->scratch.count;
+    if (!reserveTokenVec(tokens, count - (keep - lo) + added)) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while tokenizing\n");
+        return false;
+    }
+    // Both vals may still be NULL when nothing is moved
+    if (count - keep) memmove(tokens->vals + lo + added, tokens->vals + keep, (count - keep) * sizeof(Token));
+    if (added)        memcpy(tokens->vals + lo, live->scratch.vals, added * sizeof(Token));
+    tokens->count = count - (keep - lo) + added;
+    for (size_t i = lo + added; i < tokens->count; i++) tokens->vals[i].offset = (uint32_t)(tokens->vals[i].offset + shift);
+
+    live->lexed_len = live->len;
+    live->pending = false;
+    *first = lo;
+    *old_end = keep;
+    *new_end = lo + added;
+    return true;
+}
+
+// Returns the last term starting at or before token
+static size_t findTerm(const LiveTermVec * terms, size_t token) {
+    size_t lo = 0;
+    size_t hi = terms->count;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (terms->vals[mid].first_token <= token) lo = mid + 1;
+        else                                       hi = mid;
+    }
+    return lo ? lo - 1 : 0;
+}
+
+static void calculateTerm(LiveExpression * live, LiveTerm * term) {
+    const size_t separator = term->first_token ? 1 : 0;
+    const TokenVec tokens = {
+        .count = term->token_count - separator,
+        .capacity = term->token_count - separator,
+        .vals = live->tokens.vals + term->first_token + separator,
+    };
+    if (separator && !tokens.count) {
+        const Token * last = &live->tokens.vals[term->first_token];
+        snprintf(err_msg, sizeof(err_msg), "Syntax Error at Token >%.*s< at column %u. Expected Value next\n", (int)last->length, live->text + last->offset, last->offset + 1);
+        term->valid = false;
+        return;
+    }
+
+    resetNodeArena(&live->arena);
+    const NodeIndex root = createSyntaxTree(&live->arena, live->text, &tokens);
+    if (root == NO_NODE) {
+        term->valid = false;
+        return;
+    }
+    const size_t variable_count = live->arena.variables.count;
+    if (variable_count > live->variable_capacity) {
+        double * variables = realloc(live->variables, variable_count * sizeof(double));
+        if (!variables) {
+            snprintf(err_msg, sizeof(err_msg), "Out of memory while calculating\n");
+            term->valid = false;
+            return;
+        }
+        live->variables = variables;
+        live->variable_capacity = variable_count;
+    }
+    term->valid = bindVariables(&live->arena.variables, live->bound_names, live->bound_values, live->variables)
+               && calculateResult(&live->arena, root, live->variables, &term->value);
+}
+
+// Splits tokens first to old_end, which became first to new_end, into terms again. Starts one term
+// early since the first changed token may decide whether the separator of its term still is one,
+// and continues until the separator of the next old term separates like before.
+static bool updateTerms(LiveExpression * live, size_t first, size_t old_end, size_t new_end) {
+    if (old_end == first && new_end == first) return true;
+    LiveTermVec * terms = &live->terms;
+    const Token * tokens = live->tokens.vals;
+    const size_t token_count = live->tokens.count;
+    const size_t shift = new_end - old_end; // Wraps around if tokens were removed
+
+    size_t from = findTerm(terms, first);
+    if (from) from--;
+    size_t to = findTerm(terms, old_end > first ? old_end - 1 : first);
+
+    live->new_terms.count = 0;
+    size_t term_start = terms->vals[from].first_token;
+    long depth = 0;
+    size_t i = term_start;
+    size_t region_end;
+    while (true) {
+        region_end = to + 1 < terms->count ? terms->vals[to + 1].first_token + shift : token_count;
+        for (; i < region_end; i++) {
+            const Token * token = &tokens[i];
+            if      (token->type == TokenParenOpen)  depth++;
+            else if (token->type == TokenParenClose) depth--;
+            else if (depth == 0 && i > term_start && (token->operator == OperatorPlus || token->operator == OperatorMinus)
+                     && token->type == TokenOperator && IS_OPERAND_END(&tokens[i - 1])) {
+                if (!reserveLiveTermVec(&live->new_terms, live->new_terms.count + 1)) goto out_of_memory;
+                live->new_terms.vals[live->new_terms.count++] = (LiveTerm) { .first_token = term_start, .token_count = i - term_start };
+                term_start = i;
+            }
+        }
+        if (to + 1 >= terms->count) break;
+        if (depth == 0 && region_end > term_start && IS_OPERAND_END(&tokens[region_end - 1])) break;
+        to++;
+    }
+    if (!reserveLiveTermVec(&live->new_terms, live->new_terms.count + 1)) goto out_of_memory;
+    live->new_terms.vals[live->new_terms.count++] = (LiveTerm) { .first_token = term_start, .token_count = region_end - term_start };
+
+    const size_t added = live->new_terms.count;
+    const size_t removed = to + 1 - from;
+    if (!reserveLiveTermVec(terms, terms->count - removed + added)) goto out_of_memory;
+    for (size_t t = from; t <= to; t++) live->invalid_terms -= !terms->vals[t].valid;
+    memmove(terms->vals + from + added, terms->vals + to + 1, (terms->count - to - 1) * sizeof(LiveTerm));
+    terms->count = terms->count - removed + added;
+    for (size_t t = from + added; t < terms->count; t++) terms->vals[t].first_token += shift;
+
+    for (size_t t = 0; t < added; t++) {
+        LiveTerm * term = &terms->vals[from + t];
+        *term = live->new_terms.vals[t];
+        calculateTerm(live, term);
+        live->invalid_terms += !term->valid;
+    }
+    return true;
+
+out_of_memory:
+    snprintf(err_msg, sizeof(err_msg), "Out of memory while parsing\n");
+    return false;
+}
+
+// Chains the results of the terms like the syntax tree of the whole expression would
+static bool updateResult(LiveExpression * live) {
+    const LiveTermVec * terms = &live->terms;
+    if (live->invalid_terms) {
+        // Calculating the first broken term again brings back its message
+        for (size_t t = 0; t < terms->count; t++) {
+            if (terms->vals[t].valid) continue;
+            calculateTerm(live, &terms->vals[t]);
+            break;
+        }
+        return live->valid = false;
+    }
+    double result = terms->vals[0].value;
+    for (size_t t = 1; t < terms->count; t++) {
+        applyOperator(result, terms->vals[t].value, live->tokens.vals[terms->vals[t].first_token].operator, &result);
+    }
+    live->result = result;
+    return live->valid = true;
+}
+
+bool editLiveExpression(LiveExpression * live, size_t pos, size_t removed, const char * inserted, size_t inserted_len) {
+    if (!live->terms.count) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory\n");
+        return live->valid = false;
+    }
+    if (pos > live->len) pos = live->len;
+    if (removed > live->len - pos) removed = live->len - pos;
+    const size_t len = live->len - removed + inserted_len;
+    if (len + 1 > live->capacity) {
+        const size_t capacity = (len + 1) * 2;
+        char * text = realloc(live->text, capacity);
+        if (!text) {
+            snprintf(err_msg, sizeof(err_msg), "Out of memory\n");
+            return live->valid = false;
+        }
+        live->text = text;
+        live->capacity = capacity;
+    }
+
+    // Merges the edit into the characters not tokenized yet, they are given in positions of the tokenized text
+    if (!live->pending) {
+        live->pending_start = pos;
+        live->pending_end = pos + removed;
+    } else {
+        const size_t changed_end = live->pending_end + live->len - live->lexed_len;
+        if (pos + removed > changed_end) live->pending_end += pos + removed - changed_end;
+        if (pos < live->pending_start) live->pending_start = pos;
+    }
+    live->pending = true;
+
+    memmove(live->text + pos + inserted_len, live->text + pos + removed, live->len - pos - removed);
+    memcpy(live->text + pos, inserted, inserted_len);
+    live->len = len;
+    live->text[len] = '\0';
+
+    size_t first, old_end, new_end;
+    if (!updateTokens(live, &first, &old_end, &new_end) || !updateTerms(live, first, old_end, new_end)) return live->valid = false;
+    return updateResult(live);
+}
+
+static struct termios original_termios;
+
+static void restoreTerminal(void) {
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &original_termios);
+}
+
+static double nowUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+// Shows the part of the expression around the cursor and its result in the line below
+static void renderLive(const LiveExpression * live, size_t cursor, double us) {
+    struct winsize ws;
+    const size_t width = ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col >= LIVE_MIN_WIDTH ? ws.ws_col : 80;
+    const size_t visible = width - 3;
+    size_t first = 0;
+    if (live->len > visible && cursor > visible / 2) {
+        first = cursor - visible / 2;
+        if (first > live->len - visible) first = live->len - visible;
+    }
+    const size_t shown = live->len - first < visible ? live->len - first : visible;
+    printf("\r\x1b[2K> %.*s\r\n\x1b[2K", (int)shown, live->text ? live->text + first : "");
+    if (live->valid) {
+        printf("= %.17g  (%.1f us)", live->result, us);
+    } else if (live->len) {
+        const size_t msg_len = strcspn(err_msg, "\n");
+        printf("%.*s", (int)(msg_len < width - 1 ? msg_len : width - 1), err_msg);
+    }
+    printf("\x1b[1A\r\x1b[%zuC", 2 + cursor - first);
+    fflush(stdout);
+}
+
+// Without a terminal the result of every line is printed, errors go to stderr
+static void printLiveResult(const LiveExpression * live) {
+    if (live->valid) {
+        printf("%.17g\n", live->result);
+    } else if (live->len) {
+        fprintf(stderr, "%s", err_msg);
+        printf("nan\n");
+    }
+}
+
+int runLive(const StrVec * bound_names, const double * bound_values) {
+    const bool terminal = isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+    if (terminal) {
+        struct termios raw;
+        tcgetattr(STDIN_FILENO, &original_termios);
+        raw = original_termios;
+        raw.c_lflag &= ~(tcflag_t)(ECHO | ICANON | ISIG | IEXTEN);
+        raw.c_iflag &= ~(tcflag_t)(IXON | ICRNL);
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+        atexit(restoreTerminal);
+        printf("Live mode, Enter starts a new expression, Ctrl-C or Ctrl-D quits\r\n");
+    }
+
+    LiveExpression live = createLiveExpression(bound_names, bound_values);
+    size_t cursor = 0;
+    double us = 0;
+    if (terminal) renderLive(&live, cursor, us);
+
+    char buf[LIVE_READ_SIZE];
+    ssize_t n;
+    bool quit = false;
+    while (!quit && (n = read(STDIN_FILENO, buf, sizeof(buf))) > 0) {
+        const double start = nowUs();
+        size_t i = 0;
+        while (i < (size_t)n && !quit) {
+            // Typed or pasted text is inserted at once
+            size_t run = i;
+            while (run < (size_t)n && buf[run] >= ' ' && buf[run] < 127) run++;
+            if (run > i) {
+                editLiveExpression(&live, cursor, 0, buf + i, run - i);
+                cursor += run - i;
+                i = run;
+                continue;
+            }
+
+            const char c = buf[i++];
+            if ((c == 127 || c == '\b') && cursor) {
+                editLiveExpression(&live, --cursor, 1, "", 0);
+            } else if (c == 1) { // Ctrl-A
+                cursor = 0;
+            } else if (c == 5) { // Ctrl-E
+                cursor = live.len;
+            } else if (c == 21) { // Ctrl-U
+                editLiveExpression(&live, 0, cursor, "", 0);
+                cursor = 0;
+            } else if (c == 11) { // Ctrl-K
+                editLiveExpression(&live, cursor, live.len - cursor, "", 0);
+            } else if (c == '\r' || c == '\n') {
+                if (terminal) printf("\x1b[1B\r\n");
+                else          printLiveResult(&live);
+                editLiveExpression(&live, 0, live.len, "", 0);
+                cursor = 0;
+            } else if (c == 3 || (c == 4 && !live.len)) {
+                quit = true;
+            } else if (c == 27 && i + 1 < (size_t)n && buf[i] == '[') {
+                // Arrow keys, Home, End and Delete
+                const char key = buf[i + 1];
+                const bool tilde = i + 2 < (size_t)n && buf[i + 2] == '~';
+                i += tilde ? 3 : 2;
+                if      (key == 'C' && cursor < live.len)     cursor++;
+                else if (key == 'D' && cursor)                cursor--;
+                else if (key == 'H' || (tilde && key == '1')) cursor = 0;
+                else if (key == 'F' || (tilde && key == '4')) cursor = live.len;
+                else if (tilde && key == '3' && cursor < live.len) editLiveExpression(&live, cursor, 1, "", 0);
+            }
+        }
+        us = nowUs() - start;
+        if (terminal) renderLive(&live, cursor, us);
+    }
+    if (terminal)      printf("\x1b[1B\r\n");
+    else if (live.len) printLiveResult(&live);
+
+    freeLiveExpression(live);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef __LIVE_H__
+#define __LIVE_H__
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "syntax.h"
+
+// The top level of an expression is a chain t0 + t1 - t2 ... of terms, every term is parsed and
+// calculated on its own. Its tokens are the separating + or - (except for the first term) and
+// the tokens of the term itself.
+typedef struct LiveTerm {
+    size_t first_token;
+    size_t token_count;
+    double value;
+    bool valid; // value holds the result of the term, otherwise it has a syntax or variable error
+} LiveTerm;
+
+DEFINE_VEC(LiveTermVec, LiveTerm, DEFAULT_CAP_VEC)
+
+// An expression that is edited in place. Tokens and terms are kept between edits, an edit
+// tokenizes only the changed characters and parses and calculates only the terms it touched.
+typedef struct LiveExpression {
+    char * text;
+    size_t len;
+    size_t capacity;
+    TokenVec tokens;        // Tokens of the text as it was last tokenized successfully
+    size_t lexed_len;       // Length of that text
+    bool pending;           // Characters pending_start to pending_end of that text were replaced since,
+    size_t pending_start;   // they are tokenized together with the next edit
+    size_t pending_end;
+    LiveTermVec terms;
+    size_t invalid_terms;
+    NodeArena arena;        // Holds the tree of one term while it is calculated
+    double * variables;
+    size_t variable_capacity;
+    TokenVec scratch;       // Tokens of the changed characters
+    LiveTermVec new_terms;  // Terms of the changed tokens
+    const StrVec * bound_names;
+    const double * bound_values;
+    double result;
+    bool valid;             // result is up to date, otherwise err_msg of the last edit tells why not
+} LiveExpression;
+
+LiveExpression createLiveExpression(const StrVec * bound_names, const double * bound_values); // Creates an empty expression
+void freeLiveExpression(LiveExpression live);                                                // Frees Memory of LiveExpression
+
+// Replaces removed characters at pos with inserted and updates result.
+// Returns false if the expression is not valid now, err_msg tells why.
+bool editLiveExpression(LiveExpression * live, size_t pos, size_t removed, const char * inserted, size_t inserted_len);
+
+// Edits an expression line by line in the terminal and shows its result after every keystroke.
+// Without a terminal every input line is evaluated the same way and its result printed.
+int runLive(const StrVec * bound_names, const double * bound_values);
+
+#endif // __LIVE_H__
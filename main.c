@@ -1,390 +1,321 @@
-
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
 #include <stdlib.h>
-#include <assert.h>
-#include <math.h>
+#include <time.h>
 
 #include "cvecs.h"
-
-typedef enum TokenType {
-    TokenValue = 0,
-    TokenOperator
-} TokenType;
-
-typedef enum Operator {
-    NoOperator = 0,
-    OperatorPlus,
-    OperatorMinus,
-    OperatorMult,
-    OperatorDiv,
-    OperatorPower,
-} Operator;
-
-typedef struct SyntaxNode SyntaxNode;
-typedef struct SyntaxNode {
-    TokenType type;
-    SyntaxNode * left;
-    SyntaxNode * right;
-    double value;
-    Operator operator;
-} SyntaxNode;
-
-typedef enum OperationStep {
-    Exp = 0,
-    MultDiv,
-    AddSub,
-} OperationStep;
-
-#define MAX_TOKEN_SIZE 1048
-
-#define IS_WHITE_SPACE_TOKEN(C) (C == ' ' || C == '\n' || C == '\t' || c == '\0')
-#define IS_OPERATOR(C)     (C == '+' || C == '-' || C == '*' || C == '/' || C == '(' || C == ')' || C == '^')
+#include "syntax.h"
+#include "vm.h"
+#include "jit.h"
+#include "trace.h"
+#include "optimize.h"
+#include "batch.h"
+#include "server.h"
+#include "live.h"
+#include "columns.h"
+#include "exact.h"
+#include "stream.h"
+#include "progcache.h"
+#include "parallel.h"
+#include "direct.h"
 
 #define BOOL_TO_STR(B)     ((B) ? "true" : "false")
 #define ABS(X) ((X) > 0 ? (X) : (-(X)))
 
-static char err_msg[1024];
+#define JIT_VERIFY_SAMPLES 256
+
+// Stack and slots of the VM, most expressions fit without an allocation
+DEFINE_SMALL_VEC(DoubleStack, double, 64)
+
 #define SHOW_ERROR    fprintf(stderr, err_msg)
 #define SHOW_ERROR_AND_ABORT SHOW_ERROR; exit(-1)
 
-size_t find_dot_pos(const char * str) {
-    const char * current = str;
-    while (*current) {
-        if (*current == '.') return (size_t)(current - str);
-        current++;
-    }
-    return 0;
+static double nowUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
 }
 
-const char * operatorToStr(Operator op) {
-    switch (op) {
-        case NoOperator: return "";
-        case OperatorPlus: return "+";
-        case OperatorMinus: return "-";
-        case OperatorMult: return "*";
-        case OperatorDiv: return "/";
-        case OperatorPower: return "^";
+static void printOptimizeStats(const OptimizeStats * stats) {
+    printf("Optimized: %zu -> %zu nodes\n", stats->nodes_before, stats->nodes_after);
+    for (int rule = 0; rule < OptimizeRuleCount; rule++) {
+        if (!stats->applied[rule]) continue;
+        printf("  %-15s applied %zu times, eliminated %ld nodes\n", optimizeRuleToStr((OptimizeRule)rule), stats->applied[rule], stats->eliminated[rule]);
     }
-    assert(false);
 }
 
-SyntaxNode * createSyntaxNode(SyntaxNode * const left, SyntaxNode * const right, TokenType type, double value, Operator operator) {
-    SyntaxNode * ret = malloc(sizeof(SyntaxNode));
-    assert(ret);
-    ret->left = left;
-    ret->right = right;
-    ret->type = type;
-    ret->value = value;
-    ret->operator = operator;
-    
-    return ret;
+// Nodes the tree would have without sharing against the nodes stored for the DAG
+static void printShareStats(const NodeArena * arena) {
+    const size_t tree_nodes = arena->count + arena->reused;
+    printf("Shared: %zu tree nodes stored as %zu DAG nodes (deduplication ratio %.2f)\n",
+           tree_nodes, arena->count, (double)tree_nodes / (double)arena->count);
 }
 
-void append_token_and_reset_buffer(char * buf, StrVec * tokens) {
-    // printf("Appending Token:>%s<\n", buf);
-    appendStrVec(tokens, buf);
-    memset(buf, 0, MAX_TOKEN_SIZE);
-}
+// Compiles expression once and runs it runs times, timing both separately
+int timeExpression(const char * expression, long runs, OptimizeMode optimize, bool use_jit, bool share_nodes, const StrVec * bound_names, const double * bound_values) {
+    const double start = nowUs();
+    TokenVec tokens = createTokenVec();
+    if (!tokenize(expression, &tokens)) {
+        SHOW_ERROR_AND_ABORT;
+    }
+    const double tokenized = nowUs();
 
-bool strToValue(const char * str, double * val) {
-    size_t dot_pos = find_dot_pos(str);
-    if (dot_pos) dot_pos++;
-    const size_t len = strlen(str);
-    bool after_decimal = false;
-    for (size_t i = 0; i < len; i++) {
-        if (str[i] == '.' && !after_decimal) {
-            after_decimal = true;
-            continue;
-        }
-        if (!isdigit(str[i])) return false;
+    NodeArena arena = createNodeArena();
+    arena.share_nodes = share_nodes;
+    NodeIndex root = createSyntaxTree(&arena, expression, &tokens);
+    if (root == NO_NODE) {
+        SHOW_ERROR_AND_ABORT;
+    }
+    const double parsed = nowUs();
+    const size_t stored = arena.count;
+    const size_t tree_nodes = arena.count + arena.reused;
 
-        double add = str[i] - '0';
-        const size_t mult_count = dot_pos ? dot_pos - 2 - i : len - i - 1;
-        const size_t div_count  = i - (dot_pos - 1);
-        if (!after_decimal) for (size_t j = 0; j < mult_count; j++) add *= 10.;
-        else                for (size_t j = 0; j < div_count;  j++) add /= 10.;
-        *val += add;
+    OptimizeStats stats;
+    if (optimize != OptimizeNone && !optimizeSyntaxTree(&arena, &root, optimize == OptimizeFastMath, &stats)) {
+        SHOW_ERROR_AND_ABORT;
     }
-    return true;
-}
+    const double optimized = nowUs();
 
-bool tokenize(const char * expression, StrVec * tokens);
-bool tokenize_file(const char * filename, StrVec * tokens) {
-    FILE * fp = fopen(filename, "r");
-    if (!fp) {
-        sprintf(err_msg, "Could not open file >%s<\n", filename);
-        return false;
+    Program program;
+    if (!compileProgram(&arena, root, &program)) {
+        SHOW_ERROR_AND_ABORT;
     }
-    
-    char buf[MAX_TOKEN_SIZE];
-    while(fgets(buf, sizeof(buf), fp)) {
-        if (!tokenize(buf, tokens)) {
-            return false;
+    DoubleStack stack;
+    initDoubleStack(&stack);
+    if (!reserveDoubleStack(&stack, program.max_stack + program.slot_count)) {
+        fprintf(stderr, "Out of memory\n");
+        exit(-1);
+    }
+    double * variables = malloc((program.variables.count + 1) * sizeof(double));
+    if (!variables) {
+        fprintf(stderr, "Out of memory\n");
+        exit(-1);
+    }
+    if (!bindVariables(&program.variables, bound_names, bound_values, variables)) {
+        SHOW_ERROR_AND_ABORT;
+    }
+    const double compiled = nowUs();
+
+    JitCode jit = { 0 };
+    if (use_jit && !compileJit(&program, &jit)) {
+        SHOW_ERROR;
+        fprintf(stderr, "Falling back to the interpreter\n");
+    }
+    const double jitted = nowUs();
+
+    volatile double result = 0;
+    if (jit.run) for (long i = 0; i < runs; i++) result = jit.run(variables);
+    else         for (long i = 0; i < runs; i++) result = runProgram(&program, variables, stack.vals);
+    const double evaluated = nowUs();
+
+    printf("Result of Expression:\n%lf\n", result);
+    printf("Compile:    %.3f us (tokenize %.3f us, parse %.3f us, optimize %.3f us, bytecode %.3f us, %zu instructions)\n",
+           compiled - start, tokenized - start, parsed - tokenized, optimized - parsed, compiled - optimized, program.code_count);
+    if (jit.run) printf("Native:     %.3f us, %zu bytes of x86-64 code\n", jitted - compiled, jit.size);
+    if (share_nodes) printf("Shared:     %zu -> %zu nodes (deduplication ratio %.2f), %zu operators kept in slots\n",
+                            tree_nodes, stored, (double)tree_nodes / (double)stored, program.slot_count);
+    printf("Evaluation: %.3f ns per run (%ld runs)\n", (evaluated - jitted) * 1e3 / (double)runs, runs);
+    if (optimize != OptimizeNone) printOptimizeStats(&stats);
+    if (jit.run) {
+        if (!verifyJit(&jit, &arena, root, JIT_VERIFY_SAMPLES)) {
+            SHOW_ERROR_AND_ABORT;
         }
+        printf("Native code matches calculateResult on %d inputs\n", JIT_VERIFY_SAMPLES);
     }
-    fclose(fp);
 
-    return true;
+    freeJit(jit);
+    free(variables);
+    freeDoubleStack(&stack);
+    freeProgram(program);
+    freeNodeArena(arena);
+    freeTokenVec(tokens);
+    return 0;
 }
 
-bool tokenize(const char * expression, StrVec * tokens) {
-
-    char buf[MAX_TOKEN_SIZE] = { 0 };
-    const size_t len = strlen(expression) + 1;
-    for (size_t i = 0; i < len; i++) {
-        char c = expression[i];
-        const bool whitespace = IS_WHITE_SPACE_TOKEN(c);
-        const bool operator = IS_OPERATOR(c);
-        assert(!(whitespace && operator));
+int main(int argc, char * argv[]) {
 
-        if (whitespace) {
-            if (strlen(buf) != 0) {
-                append_token_and_reset_buffer(buf, tokens);
+    // Short one-shot expressions are evaluated without allocating anything
+    const int direct = runDirect(argc, argv);
+    if (direct != DIRECT_FALLBACK) return direct;
+
+    const char * expression = NULL;
+    const char * column_file = NULL;
+    const char * program_cache = NULL;
+    long time_runs = 0;
+    OptimizeMode optimize = OptimizeNone;
+    bool use_jit = false;
+    bool share_nodes = false;
+    bool exact = false;
+    size_t thread_count = 0;
+    size_t cache_bytes = 0;
+    StrVec bound_names = createStrVec();
+    double * bound_values = malloc((size_t)argc * sizeof(double));
+    const char ** bound_texts = malloc((size_t)argc * sizeof(char *));
+    if (!bound_values || !bound_texts) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--var") == 0 && i + 1 < argc) {
+            char * assignment = argv[++i];
+            char * equals = strchr(assignment, '=');
+            if (!equals) {
+                fprintf(stderr, "Expected Name=Value after --var, got >%s<\n", assignment);
+                return -1;
             }
+            *equals = '\0';
+            bound_values[bound_names.count] = strtod(equals + 1, NULL);
+            bound_texts[bound_names.count] = equals + 1;
+            appendStrVec(&bound_names, assignment);
             continue;
         }
-
-        if (operator) {
-            if (strlen(buf) != 0) append_token_and_reset_buffer(buf, tokens);
-            buf[0] = c;
-            append_token_and_reset_buffer(buf, tokens);
+        if (strcmp(argv[i], "--columns") == 0 && i + 1 < argc) {
+            column_file = argv[++i];
             continue;
         }
-
-        buf[strlen(buf)] = c; 
-    }
-
-    return true;
-}
-
-void appendSyntaxNode(SyntaxNode ** current_node, SyntaxNode ** new_node, bool first_token, SyntaxNode ** first) {
-    if (first_token) {
-        *current_node = *new_node;
-        *first = *current_node; 
-    } else {
-        (*current_node)->right = *new_node;
-        (*new_node)->left = *current_node;
-        *current_node = *new_node;
-    }
-}
-
-SyntaxNode * createSyntaxTree(const StrVec * tokens) {
-
-    SyntaxNode * first = NULL;
-    SyntaxNode * current_node = NULL;
-
-    for (size_t i = 0; i < tokens->count; i++) {
-        const char * token = tokens->vals[i];
-        const bool first_token = i == 0;
-        double val = 0;
-        bool is_value = strToValue(token, &val);
-        if (is_value) {
-            SyntaxNode * new_node = createSyntaxNode(current_node, NULL, TokenValue, val, NoOperator);
-            appendSyntaxNode(&current_node, &new_node, first_token, &first);
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            thread_count = (size_t)strtoul(argv[++i], NULL, 10);
+            continue;
+        }
+        if (strcmp(argv[i], "--load-cache") == 0 && i + 1 < argc) {
+            program_cache = argv[++i];
             continue;
         }
-            
-        if (strcmp(token, "+") == 0) {
-            SyntaxNode * new_node = createSyntaxNode(current_node, NULL, TokenOperator, 0, OperatorPlus);
-            appendSyntaxNode(&current_node, &new_node, first_token, &first);
+        if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            char * end;
+            const double mib = strtod(argv[++i], &end);
+            // Negated so NaN is rejected too
+            if (end == argv[i] || *end != '\0' || !(mib >= 0 && mib * 1024 * 1024 < (double)SIZE_MAX)) {
+                fprintf(stderr, "Expected a size in MiB after --cache, got >%s<\n", argv[i]);
+                return -1;
+            }
+            cache_bytes = (size_t)(mib * 1024 * 1024);
             continue;
-        } else if (strcmp(token, "-") == 0) {
-            SyntaxNode * new_node = createSyntaxNode(current_node, NULL, TokenOperator, 0, OperatorMinus);
-            appendSyntaxNode(&current_node, &new_node, first_token, &first);
+        }
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            if (!openTrace(argv[++i])) {
+                SHOW_ERROR_AND_ABORT;
+            }
+            atexit(closeTrace);
             continue;
-        } else if (strcmp(token, "*") == 0) {
-            SyntaxNode * new_node = createSyntaxNode(current_node, NULL, TokenOperator, 0, OperatorMult);
-            appendSyntaxNode(&current_node, &new_node, first_token, &first);
+        }
+        if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            time_runs = strtol(argv[++i], NULL, 10);
             continue;
-        } else if (strcmp(token, "/") == 0) {
-            SyntaxNode * new_node = createSyntaxNode(current_node, NULL, TokenOperator, 0, OperatorDiv);
-            appendSyntaxNode(&current_node, &new_node, first_token, &first);
+        }
+        if (strcmp(argv[i], "--optimize") == 0) {
+            if (optimize == OptimizeNone) optimize = OptimizeStrict;
             continue;
-        } else if (strcmp(token, "^") == 0) {
-            SyntaxNode * new_node = createSyntaxNode(current_node, NULL, TokenOperator, 0, OperatorPower);
-            appendSyntaxNode(&current_node, &new_node, first_token, &first);
+        }
+        if (strcmp(argv[i], "--jit") == 0) {
+            use_jit = true;
             continue;
         }
-
-        sprintf(err_msg, "Unknown Operator >%s<\n", token);
-        return NULL;
-    }
-
-    return first;
-}
-
-bool checkSyntax(const SyntaxNode * root) {
-    assert(!root->left); // Root has to be a root
-
-    const SyntaxNode * current = root;
-    while (current) {
-        TokenType tokentype = current->type;
-        switch (tokentype) {
-            case TokenValue:
-                if (current->right) {
-                    if (current->right->type != TokenOperator) {
-                        sprintf(err_msg, "Syntax Error at Token with Value:%lf. Expected Operator\n", current->value);
-                        return false;
-                    }
-                }
-                break;
-            case TokenOperator:
-                if (!current->left || !current->right) {
-                    sprintf(err_msg, "Syntax Error at Token with Operator:%s. Expected Value %s\n", operatorToStr(current->operator), current->left ? "next" : "before");
-                    return false;
-                }
-                if (current->left->type != TokenValue || current->right->type != TokenValue) {
-                    sprintf(err_msg, "Syntax Error at Token with Operator:%s. Expected Value next\n", operatorToStr(current->operator));
-                    return false;
-                }
-                break;
+        if (strcmp(argv[i], "--share") == 0) {
+            share_nodes = true;
+            continue;
         }
-        current = current->right;
-    }
-    return true;
-}
-
-bool applyOperator(double a, double b, Operator operator, double * result) {
-    if (!result) return false;
-    switch (operator) {
-        case OperatorPlus:
-            *result = a + b;
-            return true;
-            break;
-        case OperatorMinus:
-            *result = a - b;
-            return true;
-            break;
-        case OperatorMult:
-            *result = a * b;
-            return true;
-            break;
-        case OperatorDiv:
-            *result = a / b;
-            return true;
-            break;
-        case OperatorPower:
-            *result = pow(a, b);
-            return true;
-        case NoOperator:
-            break;
-    }
-    return false;
-}
-
-bool calculateResult(SyntaxNode * root, double * result) {
-
-    OperationStep current_step = Exp;
-    SyntaxNode * current = root;
-    while (true) {
-        while (current) {
-            if (current->type == TokenValue) {
-                current = current->right;
-                continue;
-            }
-            bool calc = false;
-            switch (current_step) {
-                case Exp:
-                    calc = current->operator == OperatorPower;
-                    break;
-                case MultDiv:
-                    calc = current->operator == OperatorMult || current->operator == OperatorDiv;
-                    break;
-                case AddSub:
-                    calc = current->operator == OperatorPlus || current->operator == OperatorMinus;
-                    break;
-
-            }
-            if (calc) {
-                printf("--- Applying Operation: %lf %s %lf\n", current->left->value, operatorToStr(current->operator), current->right->value);
-                if(!applyOperator(current->left->value, current->right->value, current->operator, &current->value)) {
-                    sprintf(err_msg, "Cannot apply Operator >%s<\n", operatorToStr(current->operator));
-                    return false;
-                }
-                current->operator = NoOperator;
-                current->type = TokenValue;
-
-                if (current->left->left) {
-                    current->left->left->right = current;
-                    SyntaxNode * new_left = current->left->left;
-                    free(current->left);
-                    current->left = new_left;
-                } else {
-                    free(current->left);
-                    current->left = NULL;
-                    root = current;
-                }
-
-                if (current->right->right) {
-                    current->right->right->left = current;
-                    SyntaxNode * new_right = current->right->right;
-                    free(current->right);
-                    current->right = new_right;
-                } else {
-                    free(current->right);
-                    current->right = NULL;
-                }
-            }
-
-            current = current->right;
+        if (strcmp(argv[i], "--exact") == 0) {
+            exact = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--fast-math") == 0) {
+            optimize = OptimizeFastMath;
+            continue;
+        }
+        if (strcmp(argv[i], "--live") == 0) {
+            return runLive(&bound_names, bound_values);
+        }
+        if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            return runServer(argv[i + 1], cache_bytes);
+        }
+        if (strcmp(argv[i], "--stream") == 0) {
+            return runStream(i + 1 < argc ? argv[i + 1] : NULL, &bound_names, bound_values);
+        }
+        if (strcmp(argv[i], "--build-cache") == 0 && i + 2 < argc) {
+            const long skipped = buildProgramCache(argv[i + 1], argv[i + 2], optimize, share_nodes);
+            if (skipped < 0) fprintf(stderr, "%s", err_msg);
+            return skipped ? -1 : 0;
+        }
+        if (strcmp(argv[i], "--batch") == 0) {
+            return runBatch(i + 1 < argc ? argv[i + 1] : NULL, thread_count, cache_bytes);
         }
-        current = root;
-        if (current_step == AddSub) break;
-        current_step += 1;
+        expression = argv[i];
     }
 
-    *result = current->value;
-    free(current);
-    return true;
-}
-
-int main(int argc, char * argv[]) {
-
-    if (argc <= 1) {
-        fprintf(stderr, "Usage: %s [Expression]\n", argv[0]);
+    if (!expression) {
+        fprintf(stderr, "Usage: %s [--trace File] [--share] [--optimize | --fast-math] [--time Runs [--jit]] [--threads N] [--var Name=Value]... [Expression]\n", argv[0]);
+        fprintf(stderr, "       %s [--trace File] [--share] [--optimize | --fast-math] [--time Runs] --columns File [Expression]\n", argv[0]);
+        fprintf(stderr, "       %s [--trace File] [--threads N] [--cache MiB] --batch [File]\n", argv[0]);
+        fprintf(stderr, "       %s [--cache MiB] --serve SocketPath\n", argv[0]);
+        fprintf(stderr, "       %s [--var Name=Value]... --exact Expression\n", argv[0]);
+        fprintf(stderr, "       %s [--var Name=Value]... --live\n", argv[0]);
+        fprintf(stderr, "       %s [--var Name=Value]... --stream [File]\n", argv[0]);
+        fprintf(stderr, "       %s [--share] [--optimize | --fast-math] --build-cache Library File\n", argv[0]);
+        fprintf(stderr, "       %s [--share] [--optimize | --fast-math] [--var Name=Value]... --load-cache File Expression\n", argv[0]);
         return -1;
     }
+    if (exact) return runExact(expression, &bound_names, bound_texts);
+    if (program_cache) return runProgramCache(program_cache, expression, optimize, share_nodes, &bound_names, bound_values);
+    if (column_file) return runColumns(expression, column_file, time_runs, optimize, share_nodes);
+    if (time_runs > 0) return timeExpression(expression, time_runs, optimize, use_jit, share_nodes, &bound_names, bound_values);
 
-    printf("Starting to calculate Result of Expression:>%s<\n", argv[1]);
-
+    printf("Starting to calculate Result of Expression:>%s<\n", expression);
     printf("-- Tokenizing\n");
-    StrVec tokens = createStrVec();
-    if (!tokenize(argv[1], &tokens)) {
-        return -1;
+    TokenVec tokens = createTokenVec();
+    if (!tokenize(expression, &tokens)) {
+        SHOW_ERROR_AND_ABORT;
     }
-    printf("Tokens:\n");
-    for (size_t i = 0; i < tokens.count; i++) printf("%s\n", tokens.vals[i]);
+    printf("-- Tokenizing Sucess! (%zu Tokens)\n", tokens.count);
 
     printf("-- Creating Syntax Tree\n");
-    SyntaxNode * root = createSyntaxTree(&tokens);
-    if (!root) {
+    NodeArena arena = createNodeArena();
+    arena.share_nodes = share_nodes;
+    NodeIndex root = createSyntaxTree(&arena, expression, &tokens);
+    if (root == NO_NODE) {
         SHOW_ERROR_AND_ABORT;
     }
     printf("-- Creating Syntax Tree Sucess!\n");
+    if (share_nodes) printShareStats(&arena);
+
+    if (optimize != OptimizeNone) {
+        printf("-- Optimizing Syntax Tree%s\n", optimize == OptimizeFastMath ? " (fast math)" : "");
+        OptimizeStats stats;
+        if (!optimizeSyntaxTree(&arena, &root, optimize == OptimizeFastMath, &stats)) {
+            SHOW_ERROR_AND_ABORT;
+        }
+        printOptimizeStats(&stats);
+    }
 
     /*
-    SyntaxNode * current_node = root;
-    while (current_node) {
-        printf("%p -- %p -- %p (OperatorType:>%s<)\n", current_node->left, current_node, current_node->right, operatorToStr(current_node->operator));
-        current_node = current_node->right;
+    for (NodeIndex current_node = 0; current_node <= root; current_node++) {
+        printf("%u -- %u -- %u (OperatorType:>%s<)\n", arena.lefts[current_node], current_node, arena.rights[current_node], operatorToStr(arena.operators[current_node]));
     }
     */
 
-    printf("-- Checking Syntax\n");
-    if (!checkSyntax(root)) {
+    double * variables = malloc((arena.variables.count + 1) * sizeof(double));
+    if (!variables) {
+        fprintf(stderr, "Out of memory\n");
+        exit(-1);
+    }
+    if (!bindVariables(&arena.variables, &bound_names, bound_values, variables)) {
         SHOW_ERROR_AND_ABORT;
     }
-    printf("-- Syntax Check Sucess!!\n");
 
     printf("-- Resolving Syntaxtree\n");
     double result;
-    if (!calculateResult(root, &result)) {
+    ParallelStats parallel;
+    if (!calculateResultParallel(&arena, root, variables, thread_count, &result, &parallel)) {
         SHOW_ERROR_AND_ABORT;
     }
+    if (parallel.terms) printf("-- Reduced a chain of %zu terms in %zu blocks on %zu threads\n", parallel.terms, parallel.blocks, parallel.threads);
     printf("Result of Expression:\n%lf\n", result);
 
-    freeStrVec(tokens);
+    free(variables);
+    free(bound_values);
+    free(bound_texts);
+    freeStrVec(bound_names);
+    freeNodeArena(arena);
+    freeTokenVec(tokens);
     return 0;
 }
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "mathfn.h"
+
+// a * b + c has to round twice everywhere, a fused multiply add in some kernels would change their results
+#pragma GCC optimize("fp-contract=off")
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MATHFN_X86
+#endif
+
+#define MATH_ROUND_SHIFT      0x1.8p52
+#define MATH_ROUND_SHIFT_BITS 0x4338000000000000u
+#define MATH_ONE_BITS         0x3ff0000000000000u
+#define MATH_SQRT1_2_BITS     0x3fe6a09e667f3bcdu // sqrt(2)/2
+#define MATH_MANTISSA_MASK    0x000fffffffffffffu
+#define MATH_SIGN_BIT         0x8000000000000000u
+#define MATH_INFINITY         (double)INFINITY
+#define MATH_NAN              (double)NAN
+
+#define MATH_LOG2E   1.44269504088896338700e+00
+#define MATH_LN2_HI  6.93147180369123816490e-01 // Trailing zeros keep k * MATH_LN2_HI exact
+#define MATH_LN2_LO  1.90821492927058770002e-10
+
+#define MATH_TRIG_MAX 0x1p20
+#define MATH_2_PI     6.36619772367581382433e-01
+#define MATH_PIO2_1   1.57079632673412561417e+00 // First 33 bits of pi/2
+#define MATH_PIO2_2   6.07710050630396597660e-11 // Next 33 bits
+#define MATH_PIO2_3   2.02226624871116645580e-21 // Next 33 bits
+#define MATH_PIO2_3T  8.47842766036889956997e-32 // pi/2 - (MATH_PIO2_1 + MATH_PIO2_2 + MATH_PIO2_3)
+
+// Coefficients of fdlibm's exp, log, sin and cos kernels
+#define LOG_LG1 6.666666666666735130e-01
+#define LOG_LG2 3.999999999940941908e-01
+#define LOG_LG3 2.857142874366239149e-01
+#define LOG_LG4 2.222219843214978396e-01
+#define LOG_LG5 1.818357216161805012e-01
+#define LOG_LG6 1.531383769920937332e-01
+#define LOG_LG7 1.479819860511658591e-01
+
+#define SIN_S1 -1.66666666666666324348e-01
+#define SIN_S2  8.33333333332248946124e-03
+#define SIN_S3 -1.98412698298579493134e-04
+#define SIN_S4  2.75573137070700676789e-06
+#define SIN_S5 -2.50507602534068634195e-08
+#define SIN_S6  1.58969099521155010221e-10
+
+#define COS_C1  4.16666666666666019037e-02
+#define COS_C2 -1.38888888888741095749e-03
+#define COS_C3  2.48015872894767294178e-05
+#define COS_C4 -2.75573143513906633035e-07
+#define COS_C5  2.08757232129817482790e-09
+#define COS_C6 -1.13596475577881948265e-11
+
+#define EXP_P1  1.66666666666666019037e-01
+#define EXP_P2 -2.77777777770155933842e-03
+#define EXP_P3  6.61375632143793436117e-05
+#define EXP_P4 -1.65339022054652515390e-06
+#define EXP_P5  4.13813679705723846039e-08
+
+#define MATH_ISA Scalar
+#define MATH_LANES 1
+#define MATH_ATTR
+#define MATH_KERNEL_NAME "scalar"
+#include "mathfn_kernels.h"
+#undef MATH_ISA
+#undef MATH_LANES
+#undef MATH_KERNEL_NAME
+
+#ifdef MATHFN_X86
+// SSE2 is part of x86-64, the compiler lowers two lanes to it without a target attribute
+#define MATH_ISA SSE2
+#define MATH_LANES 2
+#define MATH_KERNEL_NAME "sse2"
+#include "mathfn_kernels.h"
+#undef MATH_ISA
+#undef MATH_LANES
+#undef MATH_ATTR
+#undef MATH_KERNEL_NAME
+
+#define MATH_ISA AVX2
+#define MATH_LANES 4
+#define MATH_ATTR __attribute__((target("avx2")))
+#define MATH_KERNEL_NAME "avx2"
+#include "mathfn_kernels.h"
+#undef MATH_ISA
+#undef MATH_LANES
+#undef MATH_ATTR
+#undef MATH_KERNEL_NAME
+
+#define MATH_ISA AVX512
+#define MATH_LANES 8
+#define MATH_ATTR __attribute__((target("avx512f")))
+#define MATH_KERNEL_NAME "avx512"
+#include "mathfn_kernels.h"
+#undef MATH_ISA
+#undef MATH_LANES
+#undef MATH_ATTR
+#undef MATH_KERNEL_NAME
+#endif
+
+double mathExp(double x) {
+    return expVecScalar((MathVecDScalar){ x })[0];
+}
+
+double mathLog(double x) {
+    return logVecScalar((MathVecDScalar){ x })[0];
+}
+
+double mathSin(double x) {
+    return sinVecScalar((MathVecDScalar){ x })[0];
+}
+
+double mathCos(double x) {
+    return cosVecScalar((MathVecDScalar){ x })[0];
+}
+
+const MathKernels * findMathKernels(const char * name) {
+    if (strcmp(name, "scalar") == 0) return &mathKernelsScalar;
+#ifdef MATHFN_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0) return &mathKernelsSSE2;
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) return &mathKernelsAVX2;
+    if (strcmp(name, "avx512") == 0 && __builtin_cpu_supports("avx512f")) return &mathKernelsAVX512;
+#endif
+    return NULL;
+}
+
+const MathKernels * selectMathKernels(void) {
+    static const MathKernels * selected = NULL;
+    if (selected) return selected;
+
+    static const char * const names[] = {"scalar", "sse2", "avx2", "avx512"};
+    const char * limit = getenv("MATHLANG_SIMD");
+    selected = &mathKernelsScalar;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        const MathKernels * kernels = findMathKernels(names[i]);
+        if (kernels) selected = kernels;
+        if (limit && strcmp(limit, names[i]) == 0) break;
+    }
+    return selected;
+}
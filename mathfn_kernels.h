@@ -0,0 +1,167 @@
+// Kernels of mathfn.c, included once per instruction set with MATH_ISA, MATH_LANES and MATH_ATTR defined.
+// Only +, -, *, / and integer operations on whole vectors are used and mathfn.c turns off contraction
+// into fma, so every instance computes bit identical results. The one lane instance is the scalar path.
+
+#define MATH_PASTE(A, B) A##B
+#define MATH_EXPAND(A, B) MATH_PASTE(A, B)
+#define MATH_NAME(NAME)   MATH_EXPAND(NAME, MATH_ISA)
+
+#define VD MATH_NAME(MathVecD)
+#define VU MATH_NAME(MathVecU)
+#define SPLAT(C) ((VD){ 0 } + (C))
+
+typedef double VD __attribute__((vector_size(MATH_LANES * sizeof(double))));
+typedef uint64_t VU __attribute__((vector_size(MATH_LANES * sizeof(double))));
+
+MATH_ATTR static inline VD MATH_NAME(select)(VU mask, VD a, VD b) {
+    return (VD)((mask & (VU)a) | (~mask & (VU)b));
+}
+
+// Rounds to the nearest integer, ties to even, for |x| < 2^51
+MATH_ATTR static inline VD MATH_NAME(roundInt)(VD x) {
+    return (x + MATH_ROUND_SHIFT) - MATH_ROUND_SHIFT;
+}
+
+// Integer value of a rounded x as two's complement, for |x| < 2^51
+MATH_ATTR static inline VU MATH_NAME(toInt)(VD x) {
+    return (VU)(x + MATH_ROUND_SHIFT) - MATH_ROUND_SHIFT_BITS;
+}
+
+MATH_ATTR static inline VD MATH_NAME(toDouble)(VU i) {
+    return (VD)(i + MATH_ROUND_SHIFT_BITS) - MATH_ROUND_SHIFT;
+}
+
+// 2^k for integer k with -1022 <= k <= 1023
+MATH_ATTR static inline VD MATH_NAME(pow2)(VD k) {
+    return (VD)((MATH_NAME(toInt)(k) + 1023) << 52);
+}
+
+// exp(x) = 2^k * exp(hi - lo) with |hi - lo| <= ln(2)/2, exp(r) uses the rational form of fdlibm.
+// Clamping keeps k within [-1076, 1024], 2^k is applied in two halves so results overflow
+// to infinity and underflow into subnormals.
+MATH_ATTR static VD MATH_NAME(expVec)(VD x) {
+    VD c = MATH_NAME(select)((VU)(x > 710.0), SPLAT(710.0), x);
+    c = MATH_NAME(select)((VU)(c < -746.0), SPLAT(-746.0), c);
+    const VD k = MATH_NAME(roundInt)(c * MATH_LOG2E);
+    const VD hi = c - k * MATH_LN2_HI;
+    const VD lo = k * MATH_LN2_LO;
+    const VD r = hi - lo;
+
+    const VD t = r * r;
+    const VD p = r - t * (EXP_P1 + t * (EXP_P2 + t * (EXP_P3 + t * (EXP_P4 + t * EXP_P5))));
+    const VD y = 1.0 - ((lo - (r * p) / (2.0 - p)) - hi);
+
+    const VD half = MATH_NAME(roundInt)(k * 0.5);
+    return MATH_NAME(select)((VU)(x != x), x + x, (y * MATH_NAME(pow2)(half)) * MATH_NAME(pow2)(k - half));
+}
+
+// log(x) = e * ln(2) + log(m) with m in [sqrt(2)/2, sqrt(2)), log(m) = 2 atanh(s) for s = (m - 1) / (m + 1)
+// as in fdlibm. Subnormals are scaled by 2^54 first.
+MATH_ATTR static VD MATH_NAME(logVec)(VD x) {
+    const VU subnormal = (VU)(x < 0x1p-1022);
+    const VU bits = (VU)MATH_NAME(select)(subnormal, x * 0x1p54, x) + (MATH_ONE_BITS - MATH_SQRT1_2_BITS);
+    const VD e = MATH_NAME(toDouble)((bits >> 52) - 1023 - (subnormal & 54));
+    const VD f = (VD)((bits & MATH_MANTISSA_MASK) + MATH_SQRT1_2_BITS) - 1.0;
+
+    const VD hfsq = 0.5 * f * f;
+    const VD s = f / (2.0 + f);
+    const VD z = s * s;
+    const VD w = z * z;
+    const VD t1 = w * (LOG_LG2 + w * (LOG_LG4 + w * LOG_LG6));
+    const VD t2 = z * (LOG_LG1 + w * (LOG_LG3 + w * (LOG_LG5 + w * LOG_LG7)));
+    VD result = e * MATH_LN2_HI - ((hfsq - (s * (hfsq + t1 + t2) + e * MATH_LN2_LO)) - f);
+
+    result = MATH_NAME(select)((VU)(x < 0.0), SPLAT(MATH_NAN), result);
+    result = MATH_NAME(select)((VU)(x == 0.0), SPLAT(-MATH_INFINITY), result);
+    return MATH_NAME(select)((VU)(x != x) | (VU)(x == MATH_INFINITY), x + x, result);
+}
+
+// a + b = s + error exactly, whatever their magnitudes
+#define MATH_TWO_SUM(A, B, S, ERROR) do { \
+        S = (A) + (B); \
+        const VD bb = S - (A); \
+        ERROR = ((A) - (S - bb)) + ((B) - bb); \
+    } while (0)
+
+// x = k * pi/2 + r + rr with |r| <= pi/4. pi/2 is split into four parts whose products with k are exact
+// for |x| <= MATH_TRIG_MAX, r + rr keeps the reduced argument in double double so no bits cancel away.
+// The kernels of fdlibm take the tail rr into account. offset 0 gives sin, offset 1 cos.
+// Larger x are wrong, callers use libm.
+MATH_ATTR static VD MATH_NAME(sinCosVec)(VD x, uint64_t offset) {
+    const VD k = MATH_NAME(roundInt)(x * MATH_2_PI);
+    const VD t = x - k * MATH_PIO2_1;
+    VD hi, lo, r, rr;
+    MATH_TWO_SUM(t, -(k * MATH_PIO2_2), hi, lo);
+    MATH_TWO_SUM(hi, lo - (k * MATH_PIO2_3 + k * MATH_PIO2_3T), r, rr);
+    const VU quadrant = MATH_NAME(toInt)(k) + offset;
+
+    const VD z = r * r;
+    const VD v = z * r;
+    const VD sin_poly = SIN_S2 + z * (SIN_S3 + z * (SIN_S4 + z * (SIN_S5 + z * SIN_S6)));
+    const VD sin_r = r - ((z * (0.5 * rr - v * sin_poly) - rr) - v * SIN_S1);
+    const VD w = z * z;
+    const VD cos_poly = z * (COS_C1 + z * (COS_C2 + z * COS_C3)) + w * w * (COS_C4 + z * (COS_C5 + z * COS_C6));
+    const VD hz = 0.5 * z;
+    const VD one_minus_hz = 1.0 - hz;
+    const VD cos_r = one_minus_hz + (((1.0 - one_minus_hz) - hz) + (z * cos_poly - r * rr));
+
+    VD result = MATH_NAME(select)(-(quadrant & 1), cos_r, sin_r);
+    result = (VD)((VU)result ^ ((quadrant & 2) << 62));
+    // sin(x) rounds to x for |x| < 2^-27, this also keeps the sign of -0
+    if (!offset) result = MATH_NAME(select)((VU)((VD)((VU)x & ~MATH_SIGN_BIT) < 0x1p-27), x, result);
+    return result;
+}
+
+// Whole vectors are loaded unaligned, the tail goes through one zero padded vector
+#define MATH_DEFINE_ARRAY(NAME, KERNEL) \
+    MATH_ATTR static void MATH_NAME(NAME)(double * out, const double * in, size_t n) { \
+        size_t i = 0; \
+        for (; i + MATH_LANES <= n; i += MATH_LANES) { \
+            VD x; \
+            memcpy(&x, in + i, sizeof(x)); \
+            x = KERNEL(x); \
+            memcpy(out + i, &x, sizeof(x)); \
+        } \
+        if (i < n) { \
+            VD x = { 0 }; \
+            memcpy(&x, in + i, (n - i) * sizeof(double)); \
+            x = KERNEL(x); \
+            memcpy(out + i, &x, (n - i) * sizeof(double)); \
+        } \
+    }
+
+// Lanes out of range of the reduction, infinities and nan are replaced with libm
+#define MATH_DEFINE_TRIG(NAME, OFFSET, LIBM) \
+    MATH_ATTR static inline VD MATH_NAME(NAME##Vec)(VD x) { \
+        VD y = MATH_NAME(sinCosVec)(x, OFFSET); \
+        const VU large = ~(VU)(((VD)((VU)x & ~MATH_SIGN_BIT)) <= MATH_TRIG_MAX); \
+        uint64_t any = 0; \
+        for (int lane = 0; lane < MATH_LANES; lane++) any |= large[lane]; \
+        if (any) for (int lane = 0; lane < MATH_LANES; lane++) if (large[lane]) y[lane] = LIBM(x[lane]); \
+        return y; \
+    }
+
+MATH_DEFINE_TRIG(sin, 0, sin)
+MATH_DEFINE_TRIG(cos, 1, cos)
+MATH_DEFINE_ARRAY(expArray, MATH_NAME(expVec))
+MATH_DEFINE_ARRAY(logArray, MATH_NAME(logVec))
+MATH_DEFINE_ARRAY(sinArray, MATH_NAME(sinVec))
+MATH_DEFINE_ARRAY(cosArray, MATH_NAME(cosVec))
+
+static const MathKernels MATH_NAME(mathKernels) = {
+    .name = MATH_KERNEL_NAME,
+    .exp = MATH_NAME(expArray),
+    .log = MATH_NAME(logArray),
+    .sin = MATH_NAME(sinArray),
+    .cos = MATH_NAME(cosArray),
+};
+
+#undef MATH_TWO_SUM
+#undef MATH_DEFINE_ARRAY
+#undef MATH_DEFINE_TRIG
+#undef SPLAT
+#undef VD
+#undef VU
+#undef MATH_NAME
+#undef MATH_EXPAND
+#undef MATH_PASTE
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+
+#include "mathlang.h"
+#include "syntax.h"
+#include "optimize.h"
+#include "vm.h"
+
+struct MathContext {
+    MathAllocator allocator;
+    MathOptimize optimize;
+    TokenVec tokens;  // Scratch of compileMathExpression, kept between calls
+    NodeArena arena;
+    char error[sizeof(err_msg)];
+};
+
+// Lives in one allocation together with its code, constants and variable names
+struct MathExpression {
+    MathAllocator allocator;
+    Program program;       // Its variables are empty, the names are in names
+    const char ** names;
+    size_t variable_count;
+};
+
+static void * mallocAllocate(void * user, size_t size) {
+    (void)user;
+    return malloc(size);
+}
+
+static void mallocRelease(void * user, void * ptr) {
+    (void)user;
+    free(ptr);
+}
+
+static size_t alignUp(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// Internal functions only leave a message in the err_msg of the calling thread, its start tells limits and out of memory apart
+static MathStatus failMath(MathContext * context, MathStatus status) {
+    if (strncmp(err_msg, "Out of memory", 13) == 0) status = MathErrorMemory;
+    else if (strncmp(err_msg, "Expression is too long", 22) == 0) status = MathErrorLimit;
+    memcpy(context->error, err_msg, sizeof(context->error));
+    return status;
+}
+
+static MathStatus failMathWith(MathContext * context, MathStatus status, const char * message) {
+    snprintf(context->error, sizeof(context->error), "%s", message);
+    return status;
+}
+
+MathStatus createMathContext(const MathOptions * options, MathContext ** context) {
+    if (!context) return MathErrorArgument;
+    *context = NULL;
+    MathOptions defaults = { 0 };
+    if (!options) options = &defaults;
+    MathAllocator allocator = options->allocator;
+    if (!allocator.allocate != !allocator.release) return MathErrorArgument;
+    if (!allocator.allocate) allocator = (MathAllocator) { mallocAllocate, mallocRelease, NULL };
+
+    MathContext * created = allocator.allocate(allocator.user, sizeof(MathContext));
+    if (!created) return MathErrorMemory;
+    *created = (MathContext) {
+        .allocator = allocator,
+        .optimize = options->optimize,
+        .tokens = createTokenVec(),
+        .arena = createNodeArena(),
+    };
+    created->arena.share_nodes = options->share_nodes;
+    *context = created;
+    return MathOk;
+}
+
+void freeMathContext(MathContext * context) {
+    if (!context) return;
+    freeTokenVec(context->tokens);
+    freeNodeArena(context->arena);
+    context->allocator.release(context->allocator.user, context);
+}
+
+const char * mathContextError(const MathContext * context) {
+    return context ? context->error : "";
+}
+
+const char * mathStatusToStr(MathStatus status) {
+    switch (status) {
+        case MathOk:            return "Ok";
+        case MathErrorArgument: return "Invalid argument";
+        case MathErrorSyntax:   return "Syntax error";
+        case MathErrorLimit:    return "Limit exceeded";
+        case MathErrorMemory:   return "Out of memory";
+    }
+    return "Unknown status";
+}
+
+// Moves program into one allocation of the allocator of context
+static MathStatus storeMathExpression(MathContext * context, Program * program, MathExpression ** expression) {
+    const size_t variable_count = program->variables.count;
+    const size_t names_offset = alignUp(sizeof(MathExpression), alignof(const char *));
+    const size_t constants_offset = alignUp(names_offset + variable_count * sizeof(const char *), alignof(double));
+    const size_t code_offset = alignUp(constants_offset + program->constant_count * sizeof(double), alignof(Instruction));
+    const size_t text_offset = code_offset + program->code_count * sizeof(Instruction);
+    size_t size = text_offset;
+    for (size_t i = 0; i < variable_count; i++) size += program->variables.spans[i].length + 1;
+
+    unsigned char * block = context->allocator.allocate(context->allocator.user, size);
+    if (!block) return failMathWith(context, MathErrorMemory, "Out of memory while storing the expression\n");
+    MathExpression * stored = (MathExpression *)block;
+    *stored = (MathExpression) {
+        .allocator = context->allocator,
+        .program = {
+            .code = (Instruction *)(block + code_offset),
+            .code_count = program->code_count,
+            .constants = (double *)(block + constants_offset),
+            .constant_count = program->constant_count,
+            .max_stack = program->max_stack,
+            .slot_count = program->slot_count,
+        },
+        .names = (const char **)(block + names_offset),
+        .variable_count = variable_count,
+    };
+    memcpy(stored->program.code, program->code, program->code_count * sizeof(Instruction));
+    memcpy(stored->program.constants, program->constants, program->constant_count * sizeof(double));
+    char * text = (char *)(block + text_offset);
+    for (size_t i = 0; i < variable_count; i++) {
+        const size_t len = program->variables.spans[i].length + 1;
+        memcpy(text, program->variables.vals[i], len);
+        stored->names[i] = text;
+        text += len;
+    }
+    *expression = stored;
+    return MathOk;
+}
+
+MathStatus compileMathExpression(MathContext * context, const char * source, size_t len, MathExpression ** expression) {
+    if (!context || !expression || (!source && len)) return MathErrorArgument;
+    *expression = NULL;
+    context->error[0] = '\0';
+
+    context->tokens.count = 0;
+    resetNodeArena(&context->arena);
+    if (!tokenizeN(source, len, &context->tokens)) return failMath(context, MathErrorSyntax);
+    NodeIndex root = createSyntaxTree(&context->arena, source, &context->tokens);
+    if (root == NO_NODE) return failMath(context, MathErrorSyntax);
+    if (context->optimize != MathOptimizeNone && !optimizeSyntaxTree(&context->arena, &root, context->optimize == MathOptimizeFastMath, NULL)) {
+        return failMath(context, MathErrorMemory);
+    }
+    Program program;
+    if (!compileProgram(&context->arena, root, &program)) return failMath(context, MathErrorLimit);
+
+    const MathStatus status = storeMathExpression(context, &program, expression);
+    freeProgram(program);
+    return status;
+}
+
+void freeMathExpression(MathExpression * expression) {
+    if (expression) expression->allocator.release(expression->allocator.user, expression);
+}
+
+size_t mathExpressionVariableCount(const MathExpression * expression) {
+    return expression ? expression->variable_count : 0;
+}
+
+const char * mathExpressionVariableName(const MathExpression * expression, size_t index) {
+    return expression && index < expression->variable_count ? expression->names[index] : NULL;
+}
+
+size_t findMathVariable(const MathExpression * expression, const char * name) {
+    if (!expression || !name) return mathExpressionVariableCount(expression);
+    for (size_t i = 0; i < expression->variable_count; i++) {
+        if (strcmp(expression->names[i], name) == 0) return i;
+    }
+    return expression->variable_count;
+}
+
+MathStatus evaluateMathExpression(const MathExpression * expression, const double * values, double * result) {
+    if (!expression || !result || (!values && expression->variable_count)) return MathErrorArgument;
+    const Program * program = &expression->program;
+    const size_t stack_size = program->max_stack + program->slot_count;
+    if (stack_size <= MATH_STACK_INLINE) {
+        double stack[MATH_STACK_INLINE];
+        *result = runProgram(program, values, stack);
+        return MathOk;
+    }
+
+    const MathAllocator * allocator = &expression->allocator;
+    double * stack = allocator->allocate(allocator->user, stack_size * sizeof(double));
+    if (!stack) return MathErrorMemory;
+    *result = runProgram(program, values, stack);
+    allocator->release(allocator->user, stack);
+    return MathOk;
+}
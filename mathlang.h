@@ -0,0 +1,73 @@
+#ifndef __MATHLANG_H__
+#define __MATHLANG_H__
+#include <stdbool.h>
+#include <stddef.h>
+
+// Embeddable evaluator of libmathlang. A MathContext compiles expressions into MathExpressions, which are
+// evaluated with one value per variable. No function prints, exits or keeps global state, errors are
+// returned as MathStatus and the message of the last failed call is kept in its context.
+//
+// Thread safety:
+// - A MathContext is used by one thread at a time, any number of contexts are used by different threads at once.
+// - A compiled MathExpression is never modified. Any number of threads may evaluate it at the same time, also
+//   while its context compiles other expressions. It is freed once no thread evaluates it anymore.
+// - The allocator of a context has to be thread safe if expressions evaluated on several threads need
+//   more than MATH_STACK_INLINE doubles of stack, see evaluateMathExpression.
+
+#if defined(__GNUC__) && defined(MATHLANG_BUILD_SHARED)
+#define MATHLANG_API __attribute__((visibility("default")))
+#else
+#define MATHLANG_API
+#endif
+
+#define MATH_STACK_INLINE 256 // Doubles of stack evaluateMathExpression keeps on the C stack
+
+typedef enum MathStatus {
+    MathOk = 0,
+    MathErrorArgument, // NULL where something is needed
+    MathErrorSyntax,   // The expression could not be tokenized or parsed
+    MathErrorLimit,    // The expression is too long or has too many variables or nodes
+    MathErrorMemory,   // An allocation failed
+} MathStatus;
+
+// Holds contexts, compiled expressions and large evaluation stacks. Scratch memory of parsing and
+// compiling is kept by the context between calls and comes from malloc.
+typedef struct MathAllocator {
+    void * (*allocate)(void * user, size_t size);
+    void (*release)(void * user, void * ptr);
+    void * user;
+} MathAllocator;
+
+typedef enum MathOptimize {
+    MathOptimizeNone = 0,
+    MathOptimizeStrict,   // Same as --optimize, only rewrites that keep results bit identical
+    MathOptimizeFastMath, // Same as --fast-math
+} MathOptimize;
+
+typedef struct MathOptions {
+    MathAllocator allocator; // All NULL for malloc and free
+    MathOptimize optimize;
+    bool share_nodes;        // Same as --share
+} MathOptions;
+
+typedef struct MathContext MathContext;
+typedef struct MathExpression MathExpression;
+
+MATHLANG_API MathStatus createMathContext(const MathOptions * options, MathContext ** context); // options may be NULL for the defaults
+MATHLANG_API void freeMathContext(MathContext * context);                                       // Frees context but not its expressions
+MATHLANG_API const char * mathContextError(const MathContext * context);                        // Message of the last failed call, "" if none
+MATHLANG_API const char * mathStatusToStr(MathStatus status);
+
+// Compiles the first len characters of source. The expression keeps the allocator of context and may outlive it.
+MATHLANG_API MathStatus compileMathExpression(MathContext * context, const char * source, size_t len, MathExpression ** expression);
+MATHLANG_API void freeMathExpression(MathExpression * expression);
+
+MATHLANG_API size_t mathExpressionVariableCount(const MathExpression * expression);
+MATHLANG_API const char * mathExpressionVariableName(const MathExpression * expression, size_t index);
+MATHLANG_API size_t findMathVariable(const MathExpression * expression, const char * name); // Variable count if expression has no such variable
+
+// values holds one value per variable in the order of mathExpressionVariableName and may be NULL without
+// variables. Only expressions needing more than MATH_STACK_INLINE doubles of stack allocate.
+MATHLANG_API MathStatus evaluateMathExpression(const MathExpression * expression, const double * values, double * result);
+
+#endif // __MATHLANG_H__
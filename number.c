@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "number.h"
+#include "pow5_table.h"
+
+#define MAX_MANTISSA_DIGITS 19     // Every number of 19 decimal digits fits into a uint64_t
+#define MAX_EXPONENT        100000 // Larger exponents are clamped, they over- or underflow anyway
+#define MAX_EXACT_MANTISSA  (1ull << 53)
+#define MAX_EXACT_POWER     22     // 10^22 is the largest power of ten a double holds exactly
+#define FALLBACK_BUFFER     128
+
+#define IS_DIGIT(C) ((C) >= '0' && (C) <= '9')
+
+typedef struct Decimal {
+    uint64_t mantissa;
+    int64_t exponent;
+    int digits;     // Significant digits in mantissa
+    bool truncated; // Nonzero digits did not fit into mantissa anymore
+} Decimal;
+
+static const double exact_powers_of_ten[MAX_EXACT_POWER + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static int hexDigit(char c) {
+    if (IS_DIGIT(c)) return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Underscores are only part of a number between two digits
+static bool isSeparator(const char * str, size_t len, size_t i, bool hex) {
+    if (str[i] != '_' || i == 0 || i + 1 >= len) return false;
+    if (hex) return hexDigit(str[i - 1]) >= 0 && hexDigit(str[i + 1]) >= 0;
+    return IS_DIGIT(str[i - 1]) && IS_DIGIT(str[i + 1]);
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SWAR_DIGITS 8
+
+static bool isEightDigits(uint64_t chunk) {
+    return ((chunk & 0xf0f0f0f0f0f0f0f0u) | (((chunk + 0x0606060606060606u) & 0xf0f0f0f0f0f0f0f0u) >> 4)) == 0x3333333333333333u;
+}
+
+// Combines neighbouring digits pairwise: 8 digits -> 4 two digit -> 2 four digit numbers -> 1
+static uint64_t parseEightDigits(uint64_t chunk) {
+    const uint64_t mask = 0x000000ff000000ffu;
+    const uint64_t mul1 = 100 + (1000000ull << 32);
+    const uint64_t mul2 = 1 + (10000ull << 32);
+    chunk -= 0x3030303030303030u;
+    chunk = chunk * 10 + (chunk >> 8);
+    return (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+}
+#endif
+
+// Reads the digits before and after the decimal point into decimal, returns the index behind them
+static size_t scanMantissa(const char * str, size_t len, Decimal * decimal, size_t * count) {
+    bool fraction = false;
+    size_t i = 0;
+    for (; i < len; i++) {
+#ifdef SWAR_DIGITS
+        // Past the leading zeros, eight digits at once as long as they fit into the mantissa
+        uint64_t chunk;
+        if (decimal->mantissa && decimal->digits + SWAR_DIGITS <= MAX_MANTISSA_DIGITS && i + SWAR_DIGITS <= len
+                && (memcpy(&chunk, str + i, sizeof(chunk)), isEightDigits(chunk))) {
+            decimal->mantissa = decimal->mantissa * 100000000 + parseEightDigits(chunk);
+            decimal->digits += SWAR_DIGITS;
+            if (fraction) decimal->exponent -= SWAR_DIGITS;
+            *count += SWAR_DIGITS;
+            i += SWAR_DIGITS - 1;
+            continue;
+        }
+#endif
+        const char c = str[i];
+        if (!IS_DIGIT(c)) {
+            if (c == '.' && !fraction) fraction = true;
+            else if (!isSeparator(str, len, i, false)) break;
+            continue;
+        }
+        (*count)++;
+        if (decimal->digits < MAX_MANTISSA_DIGITS) {
+            decimal->mantissa = decimal->mantissa * 10 + (uint64_t)(c - '0');
+            if (decimal->mantissa) decimal->digits++;
+            if (fraction) decimal->exponent--;
+        } else {
+            if (c != '0') decimal->truncated = true;
+            if (!fraction) decimal->exponent++;
+        }
+    }
+    return i;
+}
+
+// Parses e-9 or p+3 if str[i] starts one, otherwise the letter is not part of the number
+static size_t scanExponent(const char * str, size_t len, size_t i, char letter, int64_t * exponent) {
+    if (i >= len || (str[i] | 0x20) != letter) return i;
+    size_t j = i + 1;
+    bool negative = false;
+    if (j < len && (str[j] == '+' || str[j] == '-')) negative = str[j++] == '-';
+    if (j >= len || !IS_DIGIT(str[j])) return i;
+
+    int64_t value = 0;
+    for (; j < len; j++) {
+        if (!IS_DIGIT(str[j])) {
+            if (isSeparator(str, len, j, false)) continue;
+            break;
+        }
+        if (value < MAX_EXPONENT) value = value * 10 + (str[j] - '0');
+    }
+    *exponent += negative ? -value : value;
+    return j;
+}
+
+static uint64_t multiplyFull(uint64_t a, uint64_t b, uint64_t * high) {
+#ifdef __SIZEOF_INT128__
+    const unsigned __int128 product = (unsigned __int128)a * b;
+    *high = (uint64_t)(product >> 64);
+    return (uint64_t)product;
+#else
+    const uint64_t a_lo = (uint32_t)a, a_hi = a >> 32, b_lo = (uint32_t)b, b_hi = b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    const uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    *high = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    return (cross << 32) | (uint32_t)lo_lo;
+#endif
+}
+
+// Eisel-Lemire: mantissa * 10^exponent from a 128 bit approximation of 5^exponent.
+// Returns false if the approximation cannot decide the rounding or the result is subnormal.
+static bool eiselLemire(uint64_t mantissa, int64_t exponent, double * value) {
+    if (exponent < POW5_SMALLEST_POWER) {
+        *value = 0;
+        return true;
+    }
+    if (exponent > POW5_LARGEST_POWER) {
+        *value = INFINITY;
+        return true;
+    }
+
+    const uint64_t * power = pow5_table[exponent - POW5_SMALLEST_POWER];
+    int leading_zeros = __builtin_clzll(mantissa);
+    mantissa <<= leading_zeros;
+
+    uint64_t upper;
+    uint64_t lower = multiplyFull(mantissa, power[0], &upper);
+    if ((upper & 0x1ff) == 0x1ff && lower + mantissa < lower) {
+        // The truncated low bits could still carry into the result, include the second half of 5^exponent
+        uint64_t middle;
+        const uint64_t low = multiplyFull(mantissa, power[1], &middle);
+        const uint64_t sum = lower + middle;
+        if (sum < lower) upper++;
+        if (sum + 1 == 0 && (upper & 0x1ff) == 0x1ff && low + mantissa < low) return false;
+        lower = sum;
+    }
+
+    const uint64_t upper_bit = upper >> 63;
+    uint64_t bits = upper >> (upper_bit + 9);
+    leading_zeros += (int)(1 ^ upper_bit);
+    // Exactly halfway between two doubles, only an exact comparison can round this to even
+    if (lower == 0 && (upper & 0x1ff) == 0 && (bits & 3) == 1) return false;
+
+    bits += bits & 1;
+    bits >>= 1;
+    if (bits >= MAX_EXACT_MANTISSA) {
+        bits = MAX_EXACT_MANTISSA / 2;
+        leading_zeros--;
+    }
+    bits &= ~(MAX_EXACT_MANTISSA / 2);
+
+    // floor(log2(10^exponent)) + 63 + bias
+    const int64_t biased_exponent = (((152170 + 65536) * exponent) >> 16) + 1024 + 63 - leading_zeros;
+    if (biased_exponent < 1 || biased_exponent > 2046) return false;
+    bits |= (uint64_t)biased_exponent << 52;
+    memcpy(value, &bits, sizeof(*value));
+    return true;
+}
+
+// strtod is correctly rounded as well, it only has to do without the separators
+static double parseFallback(const char * str, size_t len) {
+    char stack_buffer[FALLBACK_BUFFER];
+    char * buffer = len < FALLBACK_BUFFER ? stack_buffer : malloc(len + 1);
+    if (!buffer) return NAN;
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (str[i] != '_') buffer[count++] = str[i];
+    }
+    buffer[count] = '\0';
+    const double value = strtod(buffer, NULL);
+    if (buffer != stack_buffer) free(buffer);
+    return value;
+}
+
+static double decimalToDouble(const Decimal * decimal, const char * str, size_t len) {
+    if (!decimal->mantissa) return 0;
+
+    // Clinger's fast path, both operands are exact so the single rounding is the correct one
+    if (!decimal->truncated && decimal->mantissa <= MAX_EXACT_MANTISSA
+            && decimal->exponent >= -MAX_EXACT_POWER && decimal->exponent <= MAX_EXACT_POWER) {
+        const double mantissa = (double)decimal->mantissa;
+        if (decimal->exponent < 0) return mantissa / exact_powers_of_ten[-decimal->exponent];
+        return mantissa * exact_powers_of_ten[decimal->exponent];
+    }
+
+    // A truncated mantissa lies between mantissa and mantissa + 1, if both round alike that is the result
+    double value;
+    if (eiselLemire(decimal->mantissa, decimal->exponent, &value)) {
+        double upper;
+        if (!decimal->truncated) return value;
+        if (eiselLemire(decimal->mantissa + 1, decimal->exponent, &upper) && upper == value) return value;
+    }
+    return parseFallback(str, len);
+}
+
+static size_t parseHex(const char * str, size_t len, double * value) {
+    uint64_t mantissa = 0;
+    size_t digits = 0;
+    bool exact = true;
+    size_t i = 2;
+    for (; i < len; i++) {
+        const int digit = hexDigit(str[i]);
+        if (digit < 0) {
+            if (isSeparator(str, len, i, true)) continue;
+            break;
+        }
+        if (mantissa >> 60) exact = false;
+        mantissa = mantissa << 4 | (uint64_t)digit;
+        digits++;
+    }
+    if (i < len && str[i] == '.') {
+        exact = false;
+        for (i++; i < len; i++) {
+            if (hexDigit(str[i]) < 0) {
+                if (isSeparator(str, len, i, true)) continue;
+                break;
+            }
+            digits++;
+        }
+    }
+    if (!digits) return 0;
+    int64_t exponent = 0;
+    const size_t end = scanExponent(str, len, i, 'p', &exponent);
+    if (end != i) exact = false;
+
+    // Converting a uint64_t rounds correctly, so plain hex integers never need strtod
+    *value = exact ? (double)mantissa : parseFallback(str, end);
+    return end;
+}
+
+size_t parseNumber(const char * str, size_t len, double * value) {
+    if (len > 2 && str[0] == '0' && (str[1] | 0x20) == 'x') {
+        const size_t end = parseHex(str, len, value);
+        if (end) return end;
+    }
+
+    Decimal decimal = { 0 };
+    size_t count = 0;
+    size_t i = scanMantissa(str, len, &decimal, &count);
+    if (!count) return 0;
+    i = scanExponent(str, len, i, 'e', &decimal.exponent);
+
+    *value = decimalToDouble(&decimal, str, i);
+    return i;
+}
@@ -0,0 +1,12 @@
+#ifndef __NUMBER_H__
+#define __NUMBER_H__
+#include <stdbool.h>
+#include <stddef.h>
+
+// Parses the numeric literal at the start of str and returns how many characters it spans, 0 if there is none.
+// Decimals may have a fraction and an exponent (1.5e-9), hexadecimals start with 0x and may have a
+// fraction and a binary exponent (0x1.8p3). Underscores can separate digits (1_000_000).
+// value is the correctly rounded double, literals out of range become inf or 0.
+size_t parseNumber(const char * str, size_t len, double * value);
+
+#endif // __NUMBER_H__
@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "optimize.h"
+#include "trace.h"
+
+#define MAX_POWER_CHAIN 32
+
+typedef struct Optimizer {
+    NodeArena * arena;
+    bool fast_math;
+    OptimizeStats * stats;
+    bool failed;
+} Optimizer;
+
+const char * optimizeRuleToStr(OptimizeRule rule) {
+    switch (rule) {
+        case RuleFoldConstants: return "fold constants";
+        case RuleIdentity:      return "identity";
+        case RuleSquare:        return "square";
+        case RuleSqrt:          return "sqrt";
+        case RulePowerChain:    return "power chain";
+        case RuleReciprocal:    return "reciprocal";
+        default:                return "unknown";
+    }
+}
+
+static NodeIndex emitNode(Optimizer * opt, NodeIndex left, NodeIndex right, TokenType type, double value, Operator operator) {
+    const NodeIndex node = createSyntaxNode(opt->arena, left, right, type, value, operator);
+    if (node == NO_NODE) opt->failed = true;
+    return node;
+}
+
+static NodeIndex emitOperator(Optimizer * opt, NodeIndex left, NodeIndex right, Operator operator) {
+    return emitNode(opt, left, right, TokenOperator, 0, operator);
+}
+
+static NodeIndex emitValue(Optimizer * opt, double value) {
+    return emitNode(opt, NO_NODE, NO_NODE, TokenValue, value, NoOperator);
+}
+
+static void countRule(Optimizer * opt, OptimizeRule rule, long eliminated) {
+    opt->stats->applied[rule]++;
+    opt->stats->eliminated[rule] += eliminated;
+}
+
+// Matches a constant exactly, +0 and -0 are different constants here
+static bool isConstant(const NodeArena * arena, NodeIndex node, double value) {
+    return arena->types[node] == TokenValue && arena->values[node] == value && signbit(arena->values[node]) == signbit(value);
+}
+
+static bool isZero(const NodeArena * arena, NodeIndex node) {
+    return arena->types[node] == TokenValue && arena->values[node] == 0;
+}
+
+// x^n by square and multiply from the highest bit down. Squares share their child and every
+// multiplication shares x, compileProgram keeps shared operators in a slot.
+static NodeIndex emitPowerChain(Optimizer * opt, NodeIndex base, unsigned exponent) {
+    NodeIndex result = base;
+    long added = 0;
+    unsigned bit = 1u << 31;
+    while (!(exponent & bit)) bit >>= 1;
+    for (bit >>= 1; bit && !opt->failed; bit >>= 1) {
+        result = emitOperator(opt, result, result, OperatorMult);
+        added++;
+        if (!(exponent & bit)) continue;
+        result = emitOperator(opt, result, base, OperatorMult);
+        added++;
+    }
+    countRule(opt, RulePowerChain, 2 - added);
+    return result;
+}
+
+// Emits the optimized form of operator applied to the already optimized left and right
+static NodeIndex optimizeOperator(Optimizer * opt, Operator operator, NodeIndex left, NodeIndex right) {
+    const NodeArena * arena = opt->arena;
+    const bool unary = isUnaryOperator(operator);
+
+    if (arena->types[left] == TokenValue && (unary || arena->types[right] == TokenValue)) {
+        double result;
+        if (applyOperator(arena->values[left], unary ? 0 : arena->values[right], operator, &result)) {
+            countRule(opt, RuleFoldConstants, unary ? 1 : 2);
+            return emitValue(opt, result);
+        }
+    }
+
+    switch (operator) {
+        case OperatorNegate:
+            if (arena->types[left] == TokenOperator && arena->operators[left] == OperatorNegate) {
+                countRule(opt, RuleIdentity, 2);
+                return arena->lefts[left];
+            }
+            break;
+        case OperatorPlus:
+            if (isConstant(arena, right, -0.0) || (opt->fast_math && isZero(arena, right))) {
+                countRule(opt, RuleIdentity, 2);
+                return left;
+            }
+            if (isConstant(arena, left, -0.0) || (opt->fast_math && isZero(arena, left))) {
+                countRule(opt, RuleIdentity, 2);
+                return right;
+            }
+            break;
+        case OperatorMinus:
+            if (isConstant(arena, right, 0.0)) {
+                countRule(opt, RuleIdentity, 2);
+                return left;
+            }
+            if (opt->fast_math && isZero(arena, left)) {
+                countRule(opt, RuleIdentity, 1);
+                return emitOperator(opt, right, NO_NODE, OperatorNegate);
+            }
+            break;
+        case OperatorMult:
+            if (isConstant(arena, right, 1.0)) {
+                countRule(opt, RuleIdentity, 2);
+                return left;
+            }
+            if (isConstant(arena, left, 1.0)) {
+                countRule(opt, RuleIdentity, 2);
+                return right;
+            }
+            // x*0 is nan for infinite x and -0 for negative x, x*-1 keeps the sign of nan
+            if (!opt->fast_math) break;
+            if (isZero(arena, left) || isZero(arena, right)) {
+                countRule(opt, RuleIdentity, 1);
+                return emitValue(opt, 0);
+            }
+            if (isConstant(arena, right, -1.0)) {
+                countRule(opt, RuleIdentity, 1);
+                return emitOperator(opt, left, NO_NODE, OperatorNegate);
+            }
+            if (isConstant(arena, left, -1.0)) {
+                countRule(opt, RuleIdentity, 1);
+                return emitOperator(opt, right, NO_NODE, OperatorNegate);
+            }
+            break;
+        case OperatorDiv:
+            if (isConstant(arena, right, 1.0)) {
+                countRule(opt, RuleIdentity, 2);
+                return left;
+            }
+            if (arena->types[right] == TokenValue) {
+                // Dividing by a power of two equals multiplying with its reciprocal as long as both are normal
+                const double divisor = arena->values[right];
+                const double reciprocal = 1.0 / divisor;
+                int exponent;
+                const bool exact = isnormal(divisor) && isnormal(reciprocal) && fabs(frexp(divisor, &exponent)) == 0.5;
+                if (exact || (opt->fast_math && isfinite(divisor) && isnormal(reciprocal))) {
+                    countRule(opt, RuleReciprocal, 0);
+                    const NodeIndex constant = emitValue(opt, reciprocal);
+                    if (constant == NO_NODE) return NO_NODE;
+                    return emitOperator(opt, left, constant, OperatorMult);
+                }
+            }
+            break;
+        case OperatorPower: {
+            if (arena->types[right] != TokenValue) break;
+            const double exponent = arena->values[right];
+            // pow(x, 1) clears the sign of nan
+            if (opt->fast_math && exponent == 1) {
+                countRule(opt, RuleIdentity, 2);
+                return left;
+            }
+            if (exponent == 0) {
+                // pow(x, 0) is 1 even for nan and infinite x
+                countRule(opt, RuleIdentity, 1);
+                return emitValue(opt, 1);
+            }
+            // x*x is rounded once, pow(x, 2) may round differently
+            if (opt->fast_math && exponent == 2) {
+                countRule(opt, RuleSquare, 1);
+                return emitOperator(opt, left, left, OperatorMult);
+            }
+            // pow(-0, 0.5) is +0 and pow(-inf, 0.5) is +inf, sqrt gives -0 and nan
+            if (opt->fast_math && exponent == 0.5) {
+                countRule(opt, RuleSqrt, 1);
+                return emitOperator(opt, left, NO_NODE, OperatorSqrt);
+            }
+            if (opt->fast_math && exponent >= 3 && exponent <= MAX_POWER_CHAIN && exponent == floor(exponent)) {
+                return emitPowerChain(opt, left, (unsigned)exponent);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return emitOperator(opt, left, right, operator);
+}
+
+// Drops every node not reachable from root and closes the gaps, order of the kept nodes stays the same
+static NodeIndex compactSyntaxTree(NodeArena * arena, NodeIndex root) {
+    uint32_t * map = arena->scratch;
+    memset(map, 0, (root + 1) * sizeof(uint32_t));
+    map[root] = 1;
+    for (NodeIndex node = root + 1; node-- > 0;) {
+        if (!map[node] || arena->types[node] != TokenOperator) continue;
+        map[arena->lefts[node]] = 1;
+        if (!isUnaryOperator(arena->operators[node])) map[arena->rights[node]] = 1;
+    }
+
+    NodeIndex count = 0;
+    for (NodeIndex node = 0; node <= root; node++) {
+        if (!map[node]) continue;
+        map[node] = count;
+        arena->values[count] = arena->values[node];
+        arena->types[count] = arena->types[node];
+        arena->operators[count] = arena->operators[node];
+        if (arena->types[node] == TokenOperator) {
+            arena->lefts[count] = map[arena->lefts[node]];
+            arena->rights[count] = isUnaryOperator(arena->operators[node]) ? NO_NODE : map[arena->rights[node]];
+        } else {
+            arena->lefts[count] = arena->lefts[node];
+            arena->rights[count] = arena->rights[node];
+        }
+        count++;
+    }
+    arena->count = count;
+    return count - 1;
+}
+
+bool optimizeSyntaxTree(NodeArena * arena, NodeIndex * root, bool fast_math, OptimizeStats * stats) {
+    OptimizeStats local_stats;
+    if (!stats) stats = &local_stats;
+    memset(stats, 0, sizeof(*stats));
+
+    TRACE_STAGE(TraceOptimize, TraceBegin, *root + 1, 0);
+    const size_t node_count = (size_t)*root + 1;
+    stats->nodes_before = node_count;
+    stats->nodes_after = node_count;
+    if (!reserveNodeArenaScratch(arena, node_count) || !reserveNodeArena(arena, 2 * node_count)) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while optimizing Syntax Tree\n");
+        return false;
+    }
+
+    // map[i] is the index of the optimized node i, optimized nodes are appended behind the original tree
+    Optimizer opt = {.arena = arena, .fast_math = fast_math, .stats = stats, .failed = false};
+    uint32_t * map = arena->scratch;
+    for (NodeIndex node = 0; node < node_count && !opt.failed; node++) {
+        if (arena->types[node] != TokenOperator) {
+            map[node] = emitNode(&opt, arena->lefts[node], arena->rights[node], arena->types[node], arena->values[node], arena->operators[node]);
+            continue;
+        }
+        const Operator operator = arena->operators[node];
+        const NodeIndex left = map[arena->lefts[node]];
+        const NodeIndex right = isUnaryOperator(operator) ? NO_NODE : map[arena->rights[node]];
+        map[node] = optimizeOperator(&opt, operator, left, right);
+    }
+    const NodeIndex optimized_root = opt.failed ? NO_NODE : map[node_count - 1];
+    if (optimized_root == NO_NODE || !reserveNodeArenaScratch(arena, (size_t)optimized_root + 1)) {
+        arena->count = node_count;
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while optimizing Syntax Tree\n");
+        return false;
+    }
+
+    // The rewrites only count the nodes they drop themselves, subtrees dropped by x^0 and x*0 are identities too
+    *root = compactSyntaxTree(arena, optimized_root);
+    rehashNodeArena(arena);
+    stats->nodes_after = (size_t)*root + 1;
+    long counted = 0;
+    for (int rule = 0; rule < OptimizeRuleCount; rule++) counted += stats->eliminated[rule];
+    stats->eliminated[RuleIdentity] += (long)stats->nodes_before - (long)stats->nodes_after - counted;
+    TRACE_STAGE(TraceOptimize, TraceEnd, stats->nodes_after, 0);
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef __OPTIMIZE_H__
+#define __OPTIMIZE_H__
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "syntax.h"
+
+typedef enum OptimizeRule {
+    RuleFoldConstants = 0, // Operators with only constant operands become a constant
+    RuleIdentity,          // x*1, x/1, x-0, x+-0, x^0, --x and with fast math x^1, x+0, x*0, x*-1, 0-x
+    RuleSquare,            // x^2 -> x*x, fast math only
+    RuleSqrt,              // x^0.5 -> sqrt(x), fast math only
+    RulePowerChain,        // x^n -> chain of multiplications for small integers n, fast math only
+    RuleReciprocal,        // x/c -> x*(1/c) if 1/c is exact, with fast math for every c
+    OptimizeRuleCount,
+} OptimizeRule;
+
+typedef enum OptimizeMode {
+    OptimizeNone = 0,
+    OptimizeStrict,   // Only rewrites that keep results bit identical
+    OptimizeFastMath, // Also rewrites that may change rounding, signed zeros, infinities and nan
+} OptimizeMode;
+
+typedef struct OptimizeStats {
+    size_t applied[OptimizeRuleCount];   // How often each rule was applied
+    long eliminated[OptimizeRuleCount];  // Nodes each rule removed from the tree, negative if it added nodes
+    size_t nodes_before;
+    size_t nodes_after;
+} OptimizeStats;
+
+const char * optimizeRuleToStr(OptimizeRule rule);
+
+// Rewrites the tree of root, the arena must only hold this tree. Without fast_math every
+// rewrite gives bit identical results to calculateResult, including signed zeros, infinities and nan.
+// Nodes stay stored children first. stats may be NULL.
+bool optimizeSyntaxTree(NodeArena * arena, NodeIndex * root, bool fast_math, OptimizeStats * stats);
+
+#endif // __OPTIMIZE_H__
@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "parallel.h"
+#include "syntax.h"
+#include "trace.h"
+
+typedef enum ChainKind {
+    ChainNone = 0,
+    ChainSum,     // + and -, a - b is added as -b
+    ChainProduct, // *
+} ChainKind;
+
+// Value plus the rounding errors made while computing it
+typedef struct CompensatedValue {
+    double value;
+    double compensation;
+} CompensatedValue;
+
+DEFINE_VEC(SpineVec, NodeIndex, 1024)
+
+// The terms of one chain, term k > 0 is the right operand of spine.vals[terms - 1 - k]
+typedef struct ParallelChain {
+    NodeArena * arena;
+    const double * variables;
+    SpineVec spine;   // Operators of the chain from the head down
+    NodeIndex first;  // First node of term 0
+    size_t terms;
+    ChainKind kind;
+    CompensatedValue * blocks;
+} ParallelChain;
+
+typedef struct ParallelWorker {
+    pthread_t thread;
+    const ParallelChain * chain;
+    size_t first_block;
+    size_t end_block;
+    bool started;
+    bool ok;
+} ParallelWorker;
+
+static ChainKind chainKind(Operator operator) {
+    switch (operator) {
+        case OperatorPlus:
+        case OperatorMinus:
+            return ChainSum;
+        case OperatorMult:
+            return ChainProduct;
+        default:
+            return ChainNone;
+    }
+}
+
+// Neumaier's variant of Kahan summation, also exact when value is larger than the sum so far
+static void addCompensated(CompensatedValue * sum, double value) {
+    const double total = sum->value + value;
+    sum->compensation += fabs(sum->value) >= fabs(value) ? (sum->value - total) + value : (value - total) + sum->value;
+    sum->value = total;
+}
+
+// fma gives the exact rounding error of every multiplication
+static void multiplyCompensated(CompensatedValue * product, double value) {
+    const double total = product->value * value;
+    product->compensation = product->compensation * value + fma(product->value, value, -total);
+    product->value = total;
+}
+
+static void joinCompensated(CompensatedValue * into, CompensatedValue block, ChainKind kind) {
+    if (kind == ChainSum) {
+        addCompensated(into, block.value);
+        into->compensation += block.compensation;
+    } else {
+        const double value = into->value;
+        multiplyCompensated(into, block.value);
+        into->compensation += value * block.compensation;
+    }
+}
+
+// Once a value overflowed or became nan it stays so, its compensation is meaningless then
+static double compensatedResult(CompensatedValue value) {
+    return isfinite(value.value) ? value.value + value.compensation : value.value;
+}
+
+static bool isChainLink(const NodeArena * arena, NodeIndex node, ChainKind kind) {
+    return kind != ChainNone && arena->types[node] == TokenOperator && chainKind(arena->operators[node]) == kind;
+}
+
+// Follows the largest subtree down from root to the first chain of at least PARALLEL_MIN_TERMS terms and
+// collects its operators. A subtree of a tree is stored right before its root, so sizes follow from the
+// indices of the children.
+static bool findLongChain(ParallelChain * chain, NodeIndex root, NodeIndex * head, size_t * size) {
+    const NodeArena * arena = chain->arena;
+    NodeIndex node = root;
+    size_t node_size = (size_t)root + 1;
+    while (node_size >= 2 * PARALLEL_MIN_TERMS - 1 && arena->types[node] == TokenOperator) {
+        const Operator operator = arena->operators[node];
+        if (isUnaryOperator(operator)) {
+            node = arena->lefts[node];
+            node_size--;
+            continue;
+        }
+
+        // Every other binary operator is a chain of two terms
+        const ChainKind kind = chainKind(operator);
+        NodeIndex spine = node;
+        size_t rest = node_size;
+        NodeIndex largest = NO_NODE;
+        size_t largest_size = 0;
+        chain->spine.count = 0;
+        if (kind != ChainNone && !reserveSpineVec(&chain->spine, node_size / 2 + 1)) return false;
+        do {
+            const NodeIndex left = arena->lefts[spine];
+            const NodeIndex right = arena->rights[spine];
+            if (right <= left || rest < (size_t)(right - left) + 1) return false; // Not stored as a tree
+            if (right - left > largest_size) {
+                largest = right;
+                largest_size = right - left;
+            }
+            rest -= (size_t)(right - left) + 1;
+            if (kind != ChainNone) chain->spine.vals[chain->spine.count++] = spine;
+            spine = left;
+        } while (isChainLink(arena, spine, kind));
+
+        if (chain->spine.count + 1 >= PARALLEL_MIN_TERMS) {
+            *head = node;
+            *size = node_size;
+            chain->terms = chain->spine.count + 1;
+            chain->kind = kind;
+            return true;
+        }
+        if (rest > largest_size) {
+            largest = spine;
+            largest_size = rest;
+        }
+        node = largest;
+        node_size = largest_size;
+    }
+    return false;
+}
+
+static bool calculateTerm(const ParallelChain * chain, size_t term, double * value) {
+    NodeArena * arena = chain->arena;
+    const NodeIndex spine = chain->spine.vals[chain->terms - 1 - (term ? term : 1)];
+    const NodeIndex first = term ? arena->lefts[spine] + 1 : chain->first;
+    const NodeIndex last = term ? arena->rights[spine] : arena->lefts[spine];
+    if (first > last || !calculateSubtree(arena, first, last, chain->variables)) return false;
+    *value = term && arena->operators[spine] == OperatorMinus ? -arena->values[last] : arena->values[last];
+    return true;
+}
+
+static void * parallelWorkerThread(void * context) {
+    ParallelWorker * worker = context;
+    const ParallelChain * chain = worker->chain;
+    worker->ok = true;
+    for (size_t block = worker->first_block; block < worker->end_block && worker->ok; block++) {
+        CompensatedValue result = { chain->kind == ChainProduct ? 1 : 0, 0 };
+        const size_t end = (block + 1) * PARALLEL_BLOCK_TERMS < chain->terms ? (block + 1) * PARALLEL_BLOCK_TERMS : chain->terms;
+        for (size_t term = block * PARALLEL_BLOCK_TERMS; term < end; term++) {
+            double value;
+            if (!calculateTerm(chain, term, &value)) {
+                worker->ok = false;
+                break;
+            }
+            if (chain->kind == ChainSum) addCompensated(&result, value);
+            else                         multiplyCompensated(&result, value);
+        }
+        chain->blocks[block] = result;
+    }
+    return NULL;
+}
+
+// Reduces the terms of chain on thread_count threads, false if any term failed
+static bool reduceChain(const ParallelChain * chain, size_t block_count, size_t thread_count, double * result) {
+    ParallelWorker * workers = calloc(thread_count, sizeof(ParallelWorker));
+    if (!workers) return false;
+    for (size_t i = 0; i < thread_count; i++) {
+        workers[i] = (ParallelWorker) {
+            .chain = chain,
+            .first_block = i * block_count / thread_count,
+            .end_block = (i + 1) * block_count / thread_count,
+        };
+        workers[i].started = i && pthread_create(&workers[i].thread, NULL, parallelWorkerThread, &workers[i]) == 0;
+    }
+    // The calling thread takes the first share and every share no thread could be started for
+    bool ok = true;
+    for (size_t i = 0; i < thread_count; i++) {
+        if (!workers[i].started) parallelWorkerThread(&workers[i]);
+    }
+    for (size_t i = 0; i < thread_count; i++) {
+        if (workers[i].started) pthread_join(workers[i].thread, NULL);
+        ok = ok && workers[i].ok;
+    }
+    free(workers);
+    if (!ok) return false;
+
+    CompensatedValue total = chain->blocks[0];
+    for (size_t block = 1; block < block_count; block++) joinCompensated(&total, chain->blocks[block], chain->kind);
+    *result = compensatedResult(total);
+    return true;
+}
+
+bool calculateResultParallel(NodeArena * arena, NodeIndex root, const double * variables, size_t thread_count, double * result,
+                             ParallelStats * stats) {
+    ParallelStats local_stats;
+    if (!stats) stats = &local_stats;
+    memset(stats, 0, sizeof(*stats));
+
+    ParallelChain chain = {
+        .arena = arena,
+        .variables = variables,
+        .spine = createSpineVec(),
+    };
+    NodeIndex head;
+    size_t size;
+    if (arena->share_nodes || !findLongChain(&chain, root, &head, &size)) {
+        freeSpineVec(chain.spine);
+        return calculateResult(arena, root, variables, result);
+    }
+    chain.first = (NodeIndex)(head + 1 - size);
+    const NodeIndex first = chain.first;
+
+    // Nodes behind the chain may only use its result
+    for (NodeIndex node = head + 1; node <= root; node++) {
+        if (arena->types[node] != TokenOperator) continue;
+        const NodeIndex left = arena->lefts[node];
+        const NodeIndex right = isUnaryOperator(arena->operators[node]) ? NO_NODE : arena->rights[node];
+        if ((left >= first && left < head) || (right >= first && right < head)) {
+            freeSpineVec(chain.spine);
+            return calculateResult(arena, root, variables, result);
+        }
+    }
+
+    if (thread_count == 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cpus > 0 ? (size_t)cpus : 1;
+    }
+    const size_t block_count = (chain.terms + PARALLEL_BLOCK_TERMS - 1) / PARALLEL_BLOCK_TERMS;
+    if (thread_count > block_count) thread_count = block_count;
+    chain.blocks = malloc(block_count * sizeof(CompensatedValue));
+    bool ok = chain.blocks != NULL;
+
+    TRACE_STAGE(TraceEvaluate, TraceBegin, root + 1, 0);
+    ok = ok && (!first || calculateNodes(arena, 0, first - 1, variables)) && reduceChain(&chain, block_count, thread_count, &arena->values[head])
+      && (head == root || calculateNodes(arena, head + 1, root, variables));
+    freeSpineVec(chain.spine);
+    free(chain.blocks);
+    // A term that failed is reported the way calculateResult reports it
+    if (!ok) return calculateResult(arena, root, variables, result);
+
+    *result = arena->values[root];
+    TRACE_STAGE(TraceEvaluate, TraceEnd, root + 1, *result);
+    *stats = (ParallelStats) { .terms = chain.terms, .blocks = block_count, .threads = thread_count };
+    return true;
+}
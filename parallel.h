@@ -0,0 +1,32 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "syntax.h"
+
+// Both may be defined when compiling parallel.c
+#ifndef PARALLEL_MIN_TERMS
+#define PARALLEL_MIN_TERMS   (1 << 15) // Shorter chains are evaluated like calculateResult does
+#endif
+#ifndef PARALLEL_BLOCK_TERMS
+#define PARALLEL_BLOCK_TERMS 1024      // Terms reduced into one compensated partial result
+#endif
+
+// What calculateResultParallel did with the chain it found
+typedef struct ParallelStats {
+    size_t terms;   // Terms of the chain, 0 if the tree had no chain long enough
+    size_t blocks;
+    size_t threads; // Threads the blocks were spread over
+} ParallelStats;
+
+// Same as calculateResult, but the first chain of at least PARALLEL_MIN_TERMS terms joined by + and -
+// or by * found along the largest subtrees is reduced on thread_count threads (0 for one per CPU).
+// Its terms are cut into blocks of PARALLEL_BLOCK_TERMS, every block is summed or multiplied with
+// compensation and the blocks are joined in order. The result does not depend on thread_count and is
+// at least as accurate as reducing the chain from left to right, it may differ from calculateResult
+// in the last bits. Trees with shared nodes are evaluated by calculateResult. stats may be NULL.
+bool calculateResultParallel(NodeArena * arena, NodeIndex root, const double * variables, size_t thread_count, double * result,
+                             ParallelStats * stats);
+
+#endif // __PARALLEL_H__
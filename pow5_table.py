@@ -0,0 +1,36 @@
+#!/usr/bin/env python3
+# Generates pow5_table.h, the 128 bit approximations of 5^q Eisel-Lemire parsing in number.c needs.
+# Powers are normalized so bit 127 is set, positive powers are truncated, negative ones rounded up.
+
+SMALLEST_POWER = -342
+LARGEST_POWER = 308
+
+def approximation(q):
+    if q >= 0:
+        power = 5 ** q
+        while power < (1 << 127): power *= 2
+        while power >= (1 << 128): power //= 2
+        return power
+    power = 5 ** -q
+    z = power.bit_length()
+    b = z + 127 if q >= -27 else 2 * z + 128
+    c = 2 ** b // power + 1
+    while c >= (1 << 128): c //= 2
+    return c
+
+print("// Generated by pow5_table.py, do not edit")
+print("#ifndef __POW5_TABLE_H__")
+print("#define __POW5_TABLE_H__")
+print("#include <stdint.h>")
+print()
+print("#define POW5_SMALLEST_POWER (%d)" % SMALLEST_POWER)
+print("#define POW5_LARGEST_POWER  %d" % LARGEST_POWER)
+print()
+print("// High and low 64 bits of 5^q for q from POW5_SMALLEST_POWER to POW5_LARGEST_POWER")
+print("static const uint64_t pow5_table[%d][2] = {" % (LARGEST_POWER - SMALLEST_POWER + 1))
+for q in range(SMALLEST_POWER, LARGEST_POWER + 1):
+    c = approximation(q)
+    print("    {0x%016xu, 0x%016xu}, // 5^%d" % (c >> 64, c & ((1 << 64) - 1), q))
+print("};")
+print()
+print("#endif // __POW5_TABLE_H__")
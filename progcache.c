@@ -0,0 +1,440 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "progcache.h"
+#include "syntax.h"
+
+#define PROGRAM_CACHE_HASH_MULTIPLIER 0x9e3779b97f4a7c15u
+#define PROGRAM_CACHE_SHARE           0x100u
+#define ALIGN8(X)                     (((X) + 7) & ~(size_t)7)
+
+// A compiled line of the library waiting to be written
+typedef struct BuiltProgram {
+    uint64_t hash;
+    const char * source;
+    size_t len;
+    Program program;
+} BuiltProgram;
+
+DEFINE_VEC(BuiltProgramVec, BuiltProgram, 64)
+
+static double nowUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+// Multiplicative hash over 64 bit words, checking a file is about as fast as reading it
+static uint64_t hashBytes(uint64_t seed, const unsigned char * data, size_t len) {
+    uint64_t hash = (seed + len) * PROGRAM_CACHE_HASH_MULTIPLIER;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * PROGRAM_CACHE_HASH_MULTIPLIER;
+        hash ^= hash >> 32;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, len - i);
+    hash = (hash ^ tail) * PROGRAM_CACHE_HASH_MULTIPLIER;
+    return hash ^ (hash >> 29);
+}
+
+uint32_t programCacheOptions(OptimizeMode optimize, bool share_nodes) {
+    return (uint32_t)optimize | (share_nodes ? PROGRAM_CACHE_SHARE : 0);
+}
+
+uint64_t hashProgramSource(uint32_t options, const char * source, size_t len) {
+    return hashBytes(options, (const unsigned char *)source, len);
+}
+
+// Tokenizes, parses, optimizes and compiles source the way the options say
+static bool compileSource(TokenVec * tokens, NodeArena * arena, const char * source, size_t len, OptimizeMode optimize, bool share_nodes,
+                          Program * program) {
+    tokens->count = 0;
+    resetNodeArena(arena);
+    arena->share_nodes = share_nodes;
+    if (!tokenizeN(source, len, tokens)) return false;
+    NodeIndex root = createSyntaxTree(arena, source, tokens);
+    if (root == NO_NODE) return false;
+    OptimizeStats stats;
+    if (optimize != OptimizeNone && !optimizeSyntaxTree(arena, &root, optimize == OptimizeFastMath, &stats)) return false;
+    return compileProgram(arena, root, program);
+}
+
+static int compareBuiltPrograms(const void * a, const void * b) {
+    const BuiltProgram * x = a;
+    const BuiltProgram * y = b;
+    return x->hash < y->hash ? -1 : x->hash > y->hash;
+}
+
+static size_t namesLength(const Program * program) {
+    size_t len = 0;
+    for (size_t i = 0; i < program->variables.count; i++) len += program->variables.spans[i].length + 1;
+    return len;
+}
+
+// Lays out every program behind the header and the entries, data has to be zeroed
+static void writeProgramCacheData(unsigned char * data, size_t size, const BuiltProgramVec * programs, uint32_t options) {
+    ProgramCacheEntry * entries = (ProgramCacheEntry *)(data + sizeof(ProgramCacheHeader));
+    size_t offset = sizeof(ProgramCacheHeader) + programs->count * sizeof(ProgramCacheEntry);
+    for (size_t i = 0; i < programs->count; i++) {
+        const BuiltProgram * built = &programs->vals[i];
+        const Program * program = &built->program;
+        ProgramCacheEntry * entry = &entries[i];
+        *entry = (ProgramCacheEntry) {
+            .source_hash = built->hash,
+            .source_len = (uint32_t)built->len,
+            .code_count = (uint32_t)program->code_count,
+            .constant_count = (uint32_t)program->constant_count,
+            .variable_count = (uint32_t)program->variables.count,
+            .max_stack = (uint32_t)program->max_stack,
+            .slot_count = (uint32_t)program->slot_count,
+        };
+
+        offset = ALIGN8(offset);
+        entry->constants_offset = offset;
+        memcpy(data + offset, program->constants, program->constant_count * sizeof(double));
+        offset += program->constant_count * sizeof(double);
+        entry->code_offset = offset;
+        memcpy(data + offset, program->code, program->code_count * sizeof(Instruction));
+        offset += program->code_count * sizeof(Instruction);
+        entry->names_offset = offset;
+        for (size_t v = 0; v < program->variables.count; v++) {
+            memcpy(data + offset, program->variables.vals[v], program->variables.spans[v].length + 1);
+            offset += program->variables.spans[v].length + 1;
+        }
+        entry->source_offset = offset;
+        memcpy(data + offset, built->source, built->len);
+        offset += built->len + 1;
+    }
+
+    ProgramCacheHeader * header = (ProgramCacheHeader *)data;
+    memcpy(header->magic, PROGRAM_CACHE_MAGIC, sizeof(header->magic));
+    header->version = PROGRAM_CACHE_VERSION;
+    header->entry_count = (uint32_t)programs->count;
+    header->file_size = size;
+    header->byte_order = PROGRAM_CACHE_BYTE_ORDER;
+    header->options = options;
+    header->checksum = hashBytes(0, data + sizeof(ProgramCacheHeader), size - sizeof(ProgramCacheHeader));
+}
+
+// Writes next to path and renames, processes that mapped the old file keep their copy
+static bool writeProgramCache(const char * path, const BuiltProgramVec * programs, uint32_t options) {
+    size_t size = sizeof(ProgramCacheHeader) + programs->count * sizeof(ProgramCacheEntry);
+    for (size_t i = 0; i < programs->count; i++) {
+        const Program * program = &programs->vals[i].program;
+        size = ALIGN8(size) + program->constant_count * sizeof(double) + program->code_count * sizeof(Instruction)
+             + namesLength(program) + programs->vals[i].len + 1;
+    }
+    size = ALIGN8(size);
+
+    unsigned char * data = calloc(1, size);
+    if (!data) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while writing the cache\n");
+        return false;
+    }
+    writeProgramCacheData(data, size, programs, options);
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE * fp = fopen(tmp_path, "wb");
+    bool ok = fp && fwrite(data, 1, size, fp) == size;
+    if (fp && fclose(fp) != 0) ok = false;
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok) {
+        snprintf(err_msg, sizeof(err_msg), "Could not write cache file >%s<\n", path);
+        remove(tmp_path);
+    }
+    free(data);
+    return ok;
+}
+
+long buildProgramCache(const char * library, const char * path, OptimizeMode optimize, bool share_nodes) {
+    FILE * fp = fopen(library, "r");
+    if (!fp) {
+        snprintf(err_msg, sizeof(err_msg), "Could not open file >%s<\n", library);
+        return -1;
+    }
+
+    const uint32_t options = programCacheOptions(optimize, share_nodes);
+    BuiltProgramVec programs = createBuiltProgramVec();
+    TokenVec tokens = createTokenVec();
+    NodeArena arena = createNodeArena();
+    char * line = NULL;
+    size_t line_cap = 0;
+    ssize_t read;
+    size_t line_number = 0;
+    long skipped = 0;
+    bool ok = true;
+    while (ok && (read = getline(&line, &line_cap, fp)) >= 0) {
+        line_number++;
+        size_t len = (size_t)read;
+        while (len && (line[len - 1] == '\n' || line[len - 1] == '\r')) len--;
+        if (!len || line[0] == '#') continue;
+        if (len > UINT32_MAX) {
+            fprintf(stderr, "Line %zu: Expression is too long (%zu characters)\n", line_number, len);
+            skipped++;
+            continue;
+        }
+
+        Program program;
+        if (!compileSource(&tokens, &arena, line, len, optimize, share_nodes, &program)) {
+            fprintf(stderr, "Line %zu: %s", line_number, err_msg);
+            skipped++;
+            continue;
+        }
+        char * source = malloc(len);
+        ok = source && appendBuiltProgramVec(&programs, (BuiltProgram) { hashProgramSource(options, line, len), source, len, program });
+        if (ok) {
+            memcpy(source, line, len);
+        } else {
+            free(source);
+            freeProgram(program);
+            snprintf(err_msg, sizeof(err_msg), "Out of memory while building the cache\n");
+        }
+    }
+    free(line);
+    fclose(fp);
+    freeTokenVec(tokens);
+    freeNodeArena(arena);
+
+    // Sorted by hash for binary search, the same text is only stored once
+    qsort(programs.vals, programs.count, sizeof(BuiltProgram), compareBuiltPrograms);
+    size_t unique = 0;
+    for (size_t i = 0; i < programs.count; i++) {
+        BuiltProgram * built = &programs.vals[i];
+        bool duplicate = false;
+        for (size_t j = unique; j-- > 0 && programs.vals[j].hash == built->hash;) {
+            duplicate = duplicate || (programs.vals[j].len == built->len && memcmp(programs.vals[j].source, built->source, built->len) == 0);
+        }
+        if (duplicate) {
+            free((char *)built->source);
+            freeProgram(built->program);
+        } else {
+            programs.vals[unique++] = *built;
+        }
+    }
+    programs.count = unique;
+
+    ok = ok && writeProgramCache(path, &programs, options);
+    if (ok) printf("Cached %zu programs in >%s<, %ld lines left out\n", programs.count, path, skipped);
+    for (size_t i = 0; i < programs.count; i++) {
+        free((char *)programs.vals[i].source);
+        freeProgram(programs.vals[i].program);
+    }
+    freeBuiltProgramVec(programs);
+    return ok ? skipped : -1;
+}
+
+static bool inFile(const ProgramCache * cache, uint64_t offset, uint64_t len, size_t alignment) {
+    return offset <= cache->size && len <= cache->size - offset && offset % alignment == 0;
+}
+
+// Walks the code once like runProgram would, so it cannot read outside of the variables, constants,
+// slots or stack of the entry. depth counts acc together with the stack like compileProgram.
+static bool checkCachedCode(const ProgramCacheEntry * entry, const Instruction * code) {
+    uint64_t depth = 0;
+    uint64_t constants = 0;
+    for (uint32_t i = 0; i < entry->code_count; i++) {
+        const uint32_t op = INSTRUCTION_OP(code[i]);
+        const uint32_t arg = INSTRUCTION_ARG(code[i]);
+        switch (op) {
+            case OpConst: if (++constants > entry->constant_count) return false; depth++; break;
+            case OpVar:   if (arg >= entry->variable_count) return false; depth++; break;
+            case OpLoad:  if (arg >= entry->slot_count) return false; depth++; break;
+            case OpStore: if (arg >= entry->slot_count || depth < 1) return false; break;
+            case OpDup:   if (depth < 1) return false; depth++; break;
+            case OpAdd: case OpSub: case OpMul: case OpDiv: case OpPow:
+                if (depth < 2) return false;
+                depth--;
+                break;
+            case OpNeg: case OpSqrt: case OpExp: case OpLog: case OpSin: case OpCos:
+                if (depth < 1) return false;
+                break;
+            case OpReturn: return depth == 1 && i == entry->code_count - 1;
+            default: return false;
+        }
+        if (depth > entry->max_stack) return false;
+    }
+    return false;
+}
+
+// Offsets of every entry have to stay inside the file and its code has to stay inside of what the
+// entry declares. The checksum catches files that were damaged or cut short.
+static bool checkProgramCache(const ProgramCache * cache, const char * path) {
+    const ProgramCacheHeader * header = cache->header;
+    if (memcmp(header->magic, PROGRAM_CACHE_MAGIC, sizeof(header->magic)) != 0) {
+        snprintf(err_msg, sizeof(err_msg), "File >%s< is no program cache\n", path);
+        return false;
+    }
+    if (header->version != PROGRAM_CACHE_VERSION || header->byte_order != PROGRAM_CACHE_BYTE_ORDER) {
+        snprintf(err_msg, sizeof(err_msg), "Program cache >%s< has version %u, expected %u\n", path, header->version, PROGRAM_CACHE_VERSION);
+        return false;
+    }
+    if (header->file_size != cache->size || !inFile(cache, sizeof(ProgramCacheHeader), (uint64_t)header->entry_count * sizeof(ProgramCacheEntry), 8)) {
+        snprintf(err_msg, sizeof(err_msg), "Program cache >%s< is cut short\n", path);
+        return false;
+    }
+    if (hashBytes(0, cache->data + sizeof(ProgramCacheHeader), cache->size - sizeof(ProgramCacheHeader)) != header->checksum) {
+        snprintf(err_msg, sizeof(err_msg), "Program cache >%s< does not match its checksum\n", path);
+        return false;
+    }
+    for (uint32_t i = 0; i < header->entry_count; i++) {
+        const ProgramCacheEntry * entry = &cache->entries[i];
+        bool valid = inFile(cache, entry->constants_offset, (uint64_t)entry->constant_count * sizeof(double), sizeof(double))
+                  && inFile(cache, entry->code_offset, (uint64_t)entry->code_count * sizeof(Instruction), sizeof(Instruction))
+                  && inFile(cache, entry->source_offset, (uint64_t)entry->source_len + 1, 1)
+                  && entry->code_count && entry->names_offset <= entry->source_offset
+                  && checkCachedCode(entry, (const Instruction *)(cache->data + entry->code_offset));
+        // Every name has to end before the source
+        const char * name = (const char *)cache->data + entry->names_offset;
+        for (uint32_t v = 0; valid && v < entry->variable_count; v++) {
+            const char * end = memchr(name, '\0', (size_t)((const char *)cache->data + entry->source_offset - name));
+            valid = end != NULL;
+            name = valid ? end + 1 : name;
+        }
+        if (!valid) {
+            snprintf(err_msg, sizeof(err_msg), "Program cache >%s< has a broken entry %u\n", path, i);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool openProgramCache(const char * path, ProgramCache * cache) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        snprintf(err_msg, sizeof(err_msg), "Could not open file >%s<\n", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ProgramCacheHeader)) {
+        snprintf(err_msg, sizeof(err_msg), "File >%s< is no program cache\n", path);
+        close(fd);
+        return false;
+    }
+    void * data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        snprintf(err_msg, sizeof(err_msg), "Could not map file >%s<\n", path);
+        return false;
+    }
+
+    *cache = (ProgramCache) {
+        .data = data,
+        .size = (size_t)st.st_size,
+        .header = data,
+        .entries = (const ProgramCacheEntry *)((const unsigned char *)data + sizeof(ProgramCacheHeader)),
+    };
+    if (!checkProgramCache(cache, path)) {
+        closeProgramCache(*cache);
+        return false;
+    }
+    return true;
+}
+
+void closeProgramCache(ProgramCache cache) {
+    if (cache.data) munmap((void *)cache.data, cache.size);
+}
+
+bool findCachedProgram(const ProgramCache * cache, uint32_t options, const char * source, size_t len, CachedProgram * cached) {
+    if (options != cache->header->options) return false;
+    const uint64_t hash = hashProgramSource(options, source, len);
+    size_t lo = 0;
+    size_t hi = cache->header->entry_count;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (cache->entries[mid].source_hash < hash) lo = mid + 1;
+        else                                        hi = mid;
+    }
+
+    // A changed text has another hash, an equal hash of another text is told apart by the text
+    for (; lo < cache->header->entry_count && cache->entries[lo].source_hash == hash; lo++) {
+        const ProgramCacheEntry * entry = &cache->entries[lo];
+        if (entry->source_len != len || memcmp(cache->data + entry->source_offset, source, len) != 0) continue;
+        *cached = (CachedProgram) {
+            .program = {
+                .code = (Instruction *)(cache->data + entry->code_offset),
+                .code_count = entry->code_count,
+                .constants = (double *)(cache->data + entry->constants_offset),
+                .constant_count = entry->constant_count,
+                .max_stack = entry->max_stack,
+                .slot_count = entry->slot_count,
+            },
+            .names = (const char *)cache->data + entry->names_offset,
+            .variable_count = entry->variable_count,
+        };
+        return true;
+    }
+    return false;
+}
+
+bool bindCachedVariables(const CachedProgram * cached, const StrVec * bound_names, const double * bound_values, double * values) {
+    const char * name = cached->names;
+    for (size_t i = 0; i < cached->variable_count; i++) {
+        const size_t len = strlen(name);
+        const size_t bound = findVariable(bound_names, name, len);
+        if (bound == bound_names->count) {
+            snprintf(err_msg, sizeof(err_msg), "Variable >%s< has no value\n", name);
+            return false;
+        }
+        values[i] = bound_values[bound];
+        name += len + 1;
+    }
+    return true;
+}
+
+int runProgramCache(const char * path, const char * expression, OptimizeMode optimize, bool share_nodes, const StrVec * bound_names,
+                    const double * bound_values) {
+    const double start = nowUs();
+    const uint32_t options = programCacheOptions(optimize, share_nodes);
+    const size_t len = strlen(expression);
+    ProgramCache cache = { 0 };
+    const bool opened = openProgramCache(path, &cache);
+    if (!opened) fprintf(stderr, "%sCompiling without the cache\n", err_msg);
+
+    CachedProgram cached;
+    Program compiled = { 0 };
+    const bool hit = opened && findCachedProgram(&cache, options, expression, len, &cached);
+    if (!hit) {
+        TokenVec tokens = createTokenVec();
+        NodeArena arena = createNodeArena();
+        const bool ok = compileSource(&tokens, &arena, expression, len, optimize, share_nodes, &compiled);
+        freeTokenVec(tokens);
+        freeNodeArena(arena);
+        if (!ok) {
+            fprintf(stderr, "%s", err_msg);
+            closeProgramCache(cache);
+            return -1;
+        }
+        cached = (CachedProgram) { .program = compiled };
+    }
+    const double loaded = nowUs();
+
+    const Program * program = &cached.program;
+    double * stack = malloc((program->max_stack + program->slot_count + 1) * sizeof(double));
+    const size_t variable_count = hit ? cached.variable_count : compiled.variables.count;
+    double * variables = malloc((variable_count + 1) * sizeof(double));
+    bool ok = stack && variables;
+    if (ok) ok = hit ? bindCachedVariables(&cached, bound_names, bound_values, variables) : bindVariables(&compiled.variables, bound_names, bound_values, variables);
+    if (ok) {
+        printf("%.17g\n", runProgram(program, variables, stack));
+        fprintf(stderr, "Cache %s: %s in %.3f us\n", hit ? "hit" : "miss", hit ? "loaded" : "compiled", loaded - start);
+    } else {
+        fprintf(stderr, "%s", stack && variables ? err_msg : "Out of memory\n");
+    }
+
+    free(stack);
+    free(variables);
+    if (!hit) freeProgram(compiled);
+    closeProgramCache(cache);
+    return ok ? 0 : -1;
+}
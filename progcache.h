@@ -0,0 +1,76 @@
+#ifndef __PROGCACHE_H__
+#define __PROGCACHE_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cvecs.h"
+#include "vm.h"
+#include "optimize.h"
+
+#define PROGRAM_CACHE_MAGIC      "MLPCACHE"
+#define PROGRAM_CACHE_VERSION    1
+#define PROGRAM_CACHE_BYTE_ORDER 0x01020304u // Files of machines with another byte order are rejected
+
+// File layout: the header, entry_count entries sorted by source_hash, then the constants, code,
+// variable names and source text of every entry. Everything is addressed by offsets from the start
+// of the file and aligned to its type, so a mapped file is evaluated from without deserializing.
+typedef struct ProgramCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint64_t file_size;
+    uint64_t checksum;      // Of every byte behind the header
+    uint32_t byte_order;
+    uint32_t options;       // Optimize mode and sharing the programs were compiled with
+} ProgramCacheHeader;
+
+typedef struct ProgramCacheEntry {
+    uint64_t source_hash;   // hashProgramSource of the options and the source text
+    uint64_t source_offset;
+    uint64_t code_offset;
+    uint64_t constants_offset;
+    uint64_t names_offset;  // variable_count NUL terminated names back to back
+    uint32_t source_len;
+    uint32_t code_count;
+    uint32_t constant_count;
+    uint32_t variable_count;
+    uint32_t max_stack;
+    uint32_t slot_count;
+} ProgramCacheEntry;
+
+// A cache file mapped read only
+typedef struct ProgramCache {
+    const unsigned char * data;
+    size_t size;
+    const ProgramCacheHeader * header;
+    const ProgramCacheEntry * entries;
+} ProgramCache;
+
+// A program inside a mapped cache. program.variables is empty, the names of the variables are in names.
+typedef struct CachedProgram {
+    Program program;
+    const char * names;
+    size_t variable_count;
+} CachedProgram;
+
+uint32_t programCacheOptions(OptimizeMode optimize, bool share_nodes); // Options stored in the header and hashed into every key
+uint64_t hashProgramSource(uint32_t options, const char * source, size_t len);
+
+// Compiles every line of library that is neither empty nor starts with # and writes the cache to path.
+// Lines that do not compile are reported and left out. Returns the number of lines left out or -1.
+long buildProgramCache(const char * library, const char * path, OptimizeMode optimize, bool share_nodes);
+
+bool openProgramCache(const char * path, ProgramCache * cache); // Maps path and checks its header and checksum
+void closeProgramCache(ProgramCache cache);                     // Unmaps the file
+
+// Finds the program of source compiled with options, false if the cache has none or only one of an older text
+bool findCachedProgram(const ProgramCache * cache, uint32_t options, const char * source, size_t len, CachedProgram * cached);
+// Same as bindVariables for the names of a cached program
+bool bindCachedVariables(const CachedProgram * cached, const StrVec * bound_names, const double * bound_values, double * values);
+
+// Evaluates expression with the program of the cache at path, compiles it if the cache has none
+int runProgramCache(const char * path, const char * expression, OptimizeMode optimize, bool share_nodes, const StrVec * bound_names,
+                    const double * bound_values);
+
+#endif // __PROGCACHE_H__
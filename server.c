@@ -0,0 +1,330 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "server.h"
+#include "syntax.h"
+#include "cache.h"
+
+#define SERVER_MAX_EVENTS  64
+#define SERVER_READ_SIZE   (1 << 16)
+#define SERVER_MAX_PENDING (1 << 20) // Unread response bytes after which requests of a client are not read anymore
+#define SERVER_MAX_LINE    (1 << 20) // Clients sending longer lines are disconnected
+
+typedef struct ServerClient {
+    int fd;
+    ByteBuf in;         // Received bytes not evaluated yet
+    ByteBuf out;        // Responses not written yet, starting at out_pos
+    size_t out_pos;
+    TokenVec tokens;
+    NodeArena arena;
+    uint32_t events;    // Events the client is registered for
+    bool closing;       // The client hung up, close once every response is written
+    struct ServerClient * next_free;
+    struct ServerClient * next_allocated;
+} ServerClient;
+
+typedef struct Server {
+    int epoll_fd;
+    int listen_fd;
+    int spare_fd;       // Kept open to accept and drop a connection once the process ran out of descriptors
+    bool bound;         // The socket file was created by this process and is removed again on shutdown
+    ResultCache cache;  // Only used with a memory_cap
+    ServerClient * free_clients; // Closed clients whose tokens and arena are reused by the next connection
+    ServerClient * allocated;    // Every client, open or not
+    size_t connections;
+    size_t requests;
+    size_t errors;
+} Server;
+
+static volatile sig_atomic_t server_stop = 0;
+
+static void stopServer(int signal) {
+    (void)signal;
+    server_stop = 1;
+}
+
+static bool appendResponse(ServerClient * client, const char * format, const char * msg, double result) {
+    const size_t max_len = 32 + (msg ? strlen(msg) : 0);
+    if (!reserveByteBuf(&client->out, client->out.count + max_len)) return false;
+    const int len = msg ? snprintf(client->out.vals + client->out.count, max_len, format, msg)
+                        : snprintf(client->out.vals + client->out.count, max_len, format, result);
+    client->out.count += (size_t)len;
+    return true;
+}
+
+static bool evaluateRequest(Server * server, ServerClient * client, const char * line, size_t len) {
+    if (len && line[len - 1] == '\r') len--;
+    client->tokens.count = 0;
+    resetNodeArena(&client->arena);
+    server->requests++;
+
+    double result = 0;
+    NodeIndex root = NO_NODE;
+    ResultCache * cache = server->cache.memory_cap ? &server->cache : NULL;
+    bool ok = tokenizeN(line, len, &client->tokens);
+    if (ok && !(cache && lookupResultCache(cache, &client->tokens, &result))) {
+        ok = (root = createSyntaxTree(&client->arena, line, &client->tokens)) != NO_NODE
+          && calculateResult(&client->arena, root, NULL, &result);
+        if (ok && cache) insertResultCache(cache, result);
+    }
+    if (ok) return appendResponse(client, "%.17g\n", NULL, result);
+
+    // Messages end with a newline, the response has to be exactly one line
+    server->errors++;
+    err_msg[strcspn(err_msg, "\n")] = '\0';
+    return appendResponse(client, "error: %s\n", err_msg, 0);
+}
+
+// Evaluates every complete line received so far, a trailing partial line only if final is set
+static bool evaluateRequests(Server * server, ServerClient * client, bool final) {
+    size_t pos = 0;
+    while (pos < client->in.count) {
+        const char * end = memchr(client->in.vals + pos, '\n', client->in.count - pos);
+        if (!end && !final) break;
+        const size_t len = end ? (size_t)(end - (client->in.vals + pos)) : client->in.count - pos;
+        if (!evaluateRequest(server, client, client->in.vals + pos, len)) return false;
+        pos += len + (end ? 1 : 0);
+    }
+    memmove(client->in.vals, client->in.vals + pos, client->in.count - pos);
+    client->in.count -= pos;
+    return client->in.count <= SERVER_MAX_LINE;
+}
+
+static bool updateEvents(Server * server, ServerClient * client, uint32_t events) {
+    if (events == client->events) return true;
+    struct epoll_event event = { .events = events, .data.ptr = client };
+    client->events = events;
+    return epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, client->fd, &event) == 0;
+}
+
+static void closeClient(Server * server, ServerClient * client) {
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+    client->next_free = server->free_clients;
+    server->free_clients = client;
+}
+
+// Writes as many responses as the socket takes. Stops reading requests while too many responses
+// are unread, so a client that only sends cannot make the server buffer without bound.
+static bool flushClient(Server * server, ServerClient * client) {
+    while (client->out_pos < client->out.count) {
+        const ssize_t n = send(client->fd, client->out.vals + client->out_pos, client->out.count - client->out_pos, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        client->out_pos += (size_t)n;
+    }
+    if (client->out_pos == client->out.count) {
+        client->out.count = 0;
+        client->out_pos = 0;
+        if (client->closing) return false;
+    }
+    const size_t pending = client->out.count - client->out_pos;
+    uint32_t events = 0;
+    if (!client->closing && pending < SERVER_MAX_PENDING) events |= EPOLLIN;
+    if (pending) events |= EPOLLOUT;
+    return updateEvents(server, client, events);
+}
+
+static bool readClient(Server * server, ServerClient * client) {
+    while (true) {
+        if (!reserveByteBuf(&client->in, client->in.count + SERVER_READ_SIZE)) return false;
+        const ssize_t n = read(client->fd, client->in.vals + client->in.count, client->in.capacity - client->in.count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        if (n == 0) {
+            client->closing = true;
+            break;
+        }
+        client->in.count += (size_t)n;
+        if (!evaluateRequests(server, client, false)) return false;
+        if (client->out.count - client->out_pos >= SERVER_MAX_PENDING) break;
+    }
+    return !client->closing || evaluateRequests(server, client, true);
+}
+
+static void acceptClients(Server * server) {
+    while (true) {
+        const int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            // The listening socket stays readable while the connection is pending, so drop it instead of waiting
+            if ((errno == EMFILE || errno == ENFILE) && server->spare_fd >= 0) {
+                close(server->spare_fd);
+                const int dropped = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+                if (dropped >= 0) close(dropped);
+                server->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                if (dropped >= 0) continue;
+            }
+            return;
+        }
+        ServerClient * client = server->free_clients;
+        if (client) {
+            server->free_clients = client->next_free;
+        } else if ((client = calloc(1, sizeof(ServerClient)))) {
+            client->tokens = createTokenVec();
+            client->arena = createNodeArena();
+            client->next_allocated = server->allocated;
+            server->allocated = client;
+        } else {
+            close(fd);
+            continue;
+        }
+        client->fd = fd;
+        client->in.count = 0;
+        client->out.count = 0;
+        client->out_pos = 0;
+        client->closing = false;
+        client->events = EPOLLIN;
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = client };
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            closeClient(server, client);
+            continue;
+        }
+        server->connections++;
+    }
+}
+
+static void freeClient(ServerClient * client) {
+    freeByteBuf(client->in);
+    freeByteBuf(client->out);
+    freeTokenVec(client->tokens);
+    freeNodeArena(client->arena);
+    free(client);
+}
+
+// Only a socket nobody listens on anymore is removed, anything else at socket_path is left alone
+static bool removeStaleSocket(const char * socket_path, const struct sockaddr_un * address) {
+    struct stat st;
+    if (lstat(socket_path, &st) != 0) {
+        if (errno == ENOENT) return true;
+        snprintf(err_msg, sizeof(err_msg), "Could not check >%s<: %s\n", socket_path, strerror(errno));
+        return false;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        snprintf(err_msg, sizeof(err_msg), "File >%s< exists and is no socket\n", socket_path);
+        return false;
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        snprintf(err_msg, sizeof(err_msg), "Could not create socket\n");
+        return false;
+    }
+    const bool stale = connect(fd, (const struct sockaddr *)address, sizeof(*address)) != 0 && errno == ECONNREFUSED;
+    close(fd);
+    if (!stale) {
+        snprintf(err_msg, sizeof(err_msg), "Socket >%s< is already in use\n", socket_path);
+        return false;
+    }
+    if (unlink(socket_path) != 0 && errno != ENOENT) {
+        snprintf(err_msg, sizeof(err_msg), "Could not remove stale socket >%s<: %s\n", socket_path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static bool openServer(Server * server, const char * socket_path) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        snprintf(err_msg, sizeof(err_msg), "Socket path >%s< is too long\n", socket_path);
+        return false;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listen_fd < 0) {
+        snprintf(err_msg, sizeof(err_msg), "Could not create socket\n");
+        return false;
+    }
+    if (!removeStaleSocket(socket_path, &address)) return false;
+    if (bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        snprintf(err_msg, sizeof(err_msg), "Could not listen on >%s<: %s\n", socket_path, strerror(errno));
+        return false;
+    }
+    server->bound = true;
+    if (listen(server->listen_fd, SOMAXCONN) != 0) {
+        snprintf(err_msg, sizeof(err_msg), "Could not listen on >%s<: %s\n", socket_path, strerror(errno));
+        return false;
+    }
+    server->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+    if (server->epoll_fd < 0 || epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &event) != 0) {
+        snprintf(err_msg, sizeof(err_msg), "Could not create epoll instance\n");
+        return false;
+    }
+    return true;
+}
+
+int runServer(const char * socket_path, size_t cache_bytes) {
+    Server server = { .epoll_fd = -1, .listen_fd = -1, .spare_fd = -1, .cache = createResultCache(cache_bytes) };
+    bool ok = openServer(&server, socket_path);
+
+    // No SA_RESTART, the signal has to interrupt epoll_wait
+    struct sigaction action = { .sa_handler = stopServer };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    if (ok) fprintf(stderr, "Listening on %s\n", socket_path);
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    while (ok && !server_stop) {
+        const int count = epoll_wait(server.epoll_fd, events, SERVER_MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            snprintf(err_msg, sizeof(err_msg), "epoll_wait failed: %s\n", strerror(errno));
+            ok = false;
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            ServerClient * client = events[i].data.ptr;
+            if (!client) {
+                acceptClients(&server);
+                continue;
+            }
+            if (client->fd < 0) continue;
+            bool alive = true;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) alive = readClient(&server, client);
+            if (alive) alive = flushClient(&server, client);
+            if (!alive) closeClient(&server, client);
+        }
+    }
+
+    if (!ok) fprintf(stderr, "%s", err_msg);
+    fprintf(stderr, "Served %zu requests (%zu errors) on %zu connections\n", server.requests, server.errors, server.connections);
+    if (cache_bytes) {
+        const CacheStats * stats = &server.cache.stats;
+        fprintf(stderr, "Cache: %zu hits, %zu misses, %zu evictions, %zu entries in %zu KiB\n",
+                stats->hits, stats->misses, stats->evictions, stats->entries, stats->memory / 1024);
+    }
+
+    while (server.allocated) {
+        ServerClient * next = server.allocated->next_allocated;
+        if (server.allocated->fd >= 0) close(server.allocated->fd);
+        freeClient(server.allocated);
+        server.allocated = next;
+    }
+    freeResultCache(server.cache);
+    if (server.epoll_fd >= 0) close(server.epoll_fd);
+    if (server.spare_fd >= 0) close(server.spare_fd);
+    if (server.listen_fd >= 0) close(server.listen_fd);
+    if (server.bound) unlink(socket_path);
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,11 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+#include <stddef.h>
+
+// Listens on the unix socket socket_path until SIGINT or SIGTERM. Clients send newline terminated
+// expressions and receive one line per expression in the same order, either the result or
+// "error: " followed by the message. Requests may be pipelined, every connection keeps its
+// tokens and arena between requests. With cache_bytes results are cached like in batch mode.
+int runServer(const char * socket_path, size_t cache_bytes);
+
+#endif // __SERVER_H__
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stream.h"
+#include "syntax.h"
+
+// Bound variables are looked up like bindVariables does
+static bool findStreamValue(const void * variables, const char * name, size_t len, double * value) {
+    const StreamEvaluator * stream = variables;
+    if (!stream->bound_names) return false;
+    const size_t bound = findVariable(stream->bound_names, name, len);
+    if (bound == stream->bound_names->count) return false;
+    *value = stream->bound_values[bound];
+    return true;
+}
+
+StreamEvaluator createStreamEvaluator(const StrVec * bound_names, const double * bound_values) {
+    return (StreamEvaluator) {
+        .lexer = createStreamLexer(NULL, NULL),
+        .stacks = createOperatorStacks(findStreamValue, NULL),
+        .bound_names = bound_names,
+        .bound_values = bound_values,
+    };
+}
+
+void freeStreamEvaluator(StreamEvaluator * stream) {
+    freeStreamLexer(stream->lexer);
+    freeOperatorStacks(stream->stacks);
+}
+
+static bool evaluateStreamTokens(void * context, const char * text, size_t base, const TokenVec * tokens) {
+    StreamEvaluator * stream = context;
+    for (size_t i = 0; i < tokens->count; i++) {
+        if (!pushOperatorToken(&stream->stacks, text, base, &tokens->vals[i])) return false;
+    }
+    stream->token_count += tokens->count;
+    return true;
+}
+
+// The evaluator may have been moved since it was created
+static void attachStreamEvaluator(StreamEvaluator * stream) {
+    stream->lexer.on_tokens = evaluateStreamTokens;
+    stream->lexer.context = stream;
+    stream->stacks.variables = stream;
+}
+
+bool feedStreamEvaluator(StreamEvaluator * stream, const char * chunk, size_t len) {
+    attachStreamEvaluator(stream);
+    return feedStreamLexer(&stream->lexer, chunk, len);
+}
+
+bool finishStreamEvaluator(StreamEvaluator * stream, double * result) {
+    attachStreamEvaluator(stream);
+    return finishStreamLexer(&stream->lexer) && finishOperatorStacks(&stream->stacks, result);
+}
+
+int runStream(const char * filename, const StrVec * bound_names, const double * bound_values) {
+    FILE * fp = filename ? fopen(filename, "r") : stdin;
+    if (!fp) {
+        fprintf(stderr, "Could not open file >%s<\n", filename);
+        return -1;
+    }
+
+    StreamEvaluator stream = createStreamEvaluator(bound_names, bound_values);
+    attachStreamEvaluator(&stream);
+    double result;
+    const bool ok = lexStreamFile(&stream.lexer, fp) && finishStreamEvaluator(&stream, &result);
+    if (ok) printf("%.17g\n", result);
+    else    fprintf(stderr, "%s", err_msg);
+    fprintf(stderr, "Streamed %zu characters, %zu tokens, stacks of %zu values and %zu operators\n", stream.lexer.offset,
+            stream.token_count, stream.stacks.values.capacity, stream.stacks.operators.capacity);
+
+    freeStreamEvaluator(&stream);
+    if (filename) fclose(fp);
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,30 @@
+#ifndef __STREAM_H__
+#define __STREAM_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cvecs.h"
+#include "syntax.h"
+
+// Evaluates an expression while it is being tokenized, without a syntax tree. Its OperatorStacks only
+// grow with the nesting depth of the expression, so a sum of a billion terms needs as little as a sum
+// of two. Results are those of calculateResult.
+typedef struct StreamEvaluator {
+    StreamLexer lexer;
+    OperatorStacks stacks;
+    size_t token_count;
+    const StrVec * bound_names;
+    const double * bound_values;
+} StreamEvaluator;
+
+StreamEvaluator createStreamEvaluator(const StrVec * bound_names, const double * bound_values); // Creates an evaluator for one expression
+void freeStreamEvaluator(StreamEvaluator * stream);                                         // Frees Memory of StreamEvaluator
+
+bool feedStreamEvaluator(StreamEvaluator * stream, const char * chunk, size_t len); // Evaluates the next chunk of the expression
+bool finishStreamEvaluator(StreamEvaluator * stream, double * result);            // Evaluates the rest once the expression ended
+
+// Evaluates the single expression in filename, or stdin if it is NULL, and prints its result
+int runStream(const char * filename, const StrVec * bound_names, const double * bound_values);
+
+#endif // __STREAM_H__
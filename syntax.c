@@ -0,0 +1,915 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+
+#include "cvecs.h"
+#include "syntax.h"
+#include "number.h"
+#include "mathfn.h"
+#include "trace.h"
+
+#define IS_WHITE_SPACE_TOKEN(C) (C == ' ' || C == '\n' || C == '\t' || C == '\r' || C == '\0')
+#define IS_OPERATOR(C)     (C == '+' || C == '-' || C == '*' || C == '/' || C == '(' || C == ')' || C == '^')
+#define IS_VARIABLE_START(C) (isalpha((unsigned char)(C)) || C == '_')
+#define IS_VARIABLE_CHAR(C)  (isalnum((unsigned char)(C)) || C == '_')
+
+_Thread_local char err_msg[1024];
+
+const char * operatorToStr(Operator op) {
+    switch (op) {
+        case NoOperator: return "";
+        case OperatorPlus: return "+";
+        case OperatorMinus: return "-";
+        case OperatorMult: return "*";
+        case OperatorDiv: return "/";
+        case OperatorPower: return "^";
+        case OperatorNegate: return "-";
+        case OperatorSqrt: return "sqrt";
+        case OperatorExp: return "exp";
+        case OperatorLog: return "log";
+        case OperatorSin: return "sin";
+        case OperatorCos: return "cos";
+    }
+    assert(false);
+}
+
+Operator charToOperator(char c) {
+    switch (c) {
+        case '+': return OperatorPlus;
+        case '-': return OperatorMinus;
+        case '*': return OperatorMult;
+        case '/': return OperatorDiv;
+        case '^': return OperatorPower;
+    }
+    return NoOperator;
+}
+
+// Names that are not variables, functions become TokenOperator and constants TokenValue
+static const struct {
+    const char * name;
+    Operator operator;
+    double value;
+} builtins[] = {
+    {"sqrt", OperatorSqrt, 0},
+    {"exp", OperatorExp, 0},
+    {"log", OperatorLog, 0},
+    {"sin", OperatorSin, 0},
+    {"cos", OperatorCos, 0},
+    {"pi", NoOperator, 3.14159265358979323846},
+    {"e", NoOperator, 2.71828182845904523536},
+};
+
+#define NODE_SIZE (sizeof(double) + 2 * sizeof(NodeIndex) + 2 * sizeof(uint8_t))
+#define MIN_SHARED_CAPACITY 128 // Table sizes are powers of two
+
+NodeArena createNodeArena(void) {
+    return (NodeArena) { 0 };
+}
+
+void freeNodeArena(NodeArena arena) {
+    free(arena.values);
+    free(arena.scratch);
+    free(arena.shared);
+    if (arena.variables.vals) freeStrVec(arena.variables);
+}
+
+void resetNodeArena(NodeArena * arena) {
+    arena->count = 0;
+    if (arena->variables.vals) clearStrVec(&arena->variables);
+    arena->reused = 0;
+    if (arena->shared) memset(arena->shared, 0xff, arena->shared_capacity * sizeof(NodeIndex));
+}
+
+size_t findVariable(const StrVec * variables, const char * name, size_t len) {
+    return findStrVec(variables, name, len);
+}
+
+bool bindVariables(const StrVec * names, const StrVec * bound_names, const double * bound_values, double * values) {
+    for (size_t i = 0; i < names->count; i++) {
+        const size_t bound = findVariable(bound_names, names->vals[i], names->spans[i].length);
+        if (bound == bound_names->count) {
+            snprintf(err_msg, sizeof(err_msg), "Variable >%s< has no value\n", names->vals[i]);
+            return false;
+        }
+        values[i] = bound_values[bound];
+    }
+    return true;
+}
+
+// Returns the index of the variable in the arena, adds it if it is new
+static NodeIndex addVariable(NodeArena * arena, const char * name, size_t len) {
+    if (!arena->variables.vals) arena->variables = createInternedStrVec(8);
+    const size_t index = findVariable(&arena->variables, name, len);
+    if (index < arena->variables.count) return (NodeIndex)index;
+
+    if (!appendStrVecN(&arena->variables, name, len)) return NO_NODE;
+    return (NodeIndex)index;
+}
+
+bool reserveNodeArena(NodeArena * arena, size_t capacity) {
+    if (capacity <= arena->capacity) return true;
+    if (capacity >= NO_NODE) return false;
+
+    char * block = malloc(capacity * NODE_SIZE);
+    if (!block) return false;
+
+    NodeArena grown = *arena;
+    grown.capacity = capacity;
+    grown.values = (double *)block;
+    grown.lefts = (NodeIndex *)(block + capacity * sizeof(double));
+    grown.rights = (NodeIndex *)(block + capacity * (sizeof(double) + sizeof(NodeIndex)));
+    grown.types = (uint8_t *)(block + capacity * (sizeof(double) + 2 * sizeof(NodeIndex)));
+    grown.operators = (uint8_t *)(block + capacity * (sizeof(double) + 2 * sizeof(NodeIndex) + sizeof(uint8_t)));
+    if (arena->count) {
+        memcpy(grown.values, arena->values, arena->count * sizeof(double));
+        memcpy(grown.lefts, arena->lefts, arena->count * sizeof(NodeIndex));
+        memcpy(grown.rights, arena->rights, arena->count * sizeof(NodeIndex));
+        memcpy(grown.types, arena->types, arena->count * sizeof(uint8_t));
+        memcpy(grown.operators, arena->operators, arena->count * sizeof(uint8_t));
+    }
+    free(arena->values);
+    *arena = grown;
+
+    return true;
+}
+
+// Scratch space is not preserved when it grows
+bool reserveNodeArenaScratch(NodeArena * arena, size_t capacity) {
+    if (capacity <= arena->scratch_capacity) return true;
+    free(arena->scratch);
+    arena->scratch = malloc(capacity * sizeof(uint32_t));
+    arena->scratch_capacity = arena->scratch ? capacity : 0;
+    return arena->scratch != NULL;
+}
+
+bool isUnaryOperator(Operator operator) {
+    return operator == OperatorNegate || isFunctionOperator(operator);
+}
+
+bool isFunctionOperator(Operator operator) {
+    return operator >= OperatorSqrt && operator <= OperatorCos;
+}
+
+// Value nodes are equal if their bits are, operator and variable nodes hold their last result as value
+static size_t hashNode(NodeIndex left, NodeIndex right, TokenType type, double value, Operator operator) {
+    uint64_t bits = 0;
+    if (type == TokenValue) memcpy(&bits, &value, sizeof(bits));
+    uint64_t hash = bits * 0x9e3779b97f4a7c15u;
+    hash ^= (((uint64_t)left << 32) | right) * 0xc2b2ae3d27d4eb4fu;
+    hash ^= (((uint64_t)type << 8) | operator) * 0x165667b19e3779f9u;
+    return (size_t)(hash ^ (hash >> 29));
+}
+
+static bool isSameNode(const NodeArena * arena, NodeIndex node, NodeIndex left, NodeIndex right, TokenType type, double value, Operator operator) {
+    if (arena->types[node] != type || arena->operators[node] != operator || arena->lefts[node] != left || arena->rights[node] != right) return false;
+    return type != TokenValue || memcmp(&arena->values[node], &value, sizeof(value)) == 0;
+}
+
+// Returns the slot of the table holding an equal node, or the empty slot it would be inserted at
+static size_t findSharedNode(const NodeArena * arena, NodeIndex left, NodeIndex right, TokenType type, double value, Operator operator) {
+    const size_t mask = arena->shared_capacity - 1;
+    size_t slot = hashNode(left, right, type, value, operator) & mask;
+    while (arena->shared[slot] != NO_NODE && !isSameNode(arena, arena->shared[slot], left, right, type, value, operator)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Of equal nodes only the first one is entered
+void rehashNodeArena(NodeArena * arena) {
+    if (!arena->shared) return;
+    memset(arena->shared, 0xff, arena->shared_capacity * sizeof(NodeIndex));
+    for (NodeIndex node = 0; node < arena->count; node++) {
+        const size_t slot = findSharedNode(arena, arena->lefts[node], arena->rights[node], arena->types[node], arena->values[node], arena->operators[node]);
+        if (arena->shared[slot] == NO_NODE) arena->shared[slot] = node;
+    }
+}
+
+// The table is kept at most half full
+bool reserveSharedNodes(NodeArena * arena, size_t capacity) {
+    if (2 * capacity <= arena->shared_capacity) return true;
+    size_t new_cap = arena->shared_capacity ? arena->shared_capacity : MIN_SHARED_CAPACITY;
+    while (new_cap < 2 * capacity) new_cap *= 2;
+    NodeIndex * shared = malloc(new_cap * sizeof(NodeIndex));
+    if (!shared) return false;
+    free(arena->shared);
+    arena->shared = shared;
+    arena->shared_capacity = new_cap;
+    rehashNodeArena(arena);
+    return true;
+}
+
+// With share_nodes an equal node that is already stored is returned instead. If the table
+// cannot grow the node is stored without being shared.
+NodeIndex createSyntaxNode(NodeArena * arena, NodeIndex left, NodeIndex right, TokenType type, double value, Operator operator) {
+    size_t slot = 0;
+    const bool share = arena->share_nodes && reserveSharedNodes(arena, arena->count + 1);
+    if (share) {
+        slot = findSharedNode(arena, left, right, type, value, operator);
+        if (arena->shared[slot] != NO_NODE) {
+            arena->reused++;
+            return arena->shared[slot];
+        }
+    }
+    if (arena->count == arena->capacity) {
+        if (!reserveNodeArena(arena, growVecCapacity(arena->capacity, DEFAULT_CAP_VEC, arena->count + 1))) return NO_NODE;
+    }
+    const NodeIndex ret = (NodeIndex)arena->count++;
+    arena->lefts[ret] = left;
+    arena->rights[ret] = right;
+    arena->types[ret] = (uint8_t)type;
+    arena->values[ret] = value;
+    arena->operators[ret] = (uint8_t)operator;
+    if (share) arena->shared[slot] = ret;
+
+    return ret;
+}
+
+bool strToValue(const char * str, size_t len, double * val) {
+    return len && parseNumber(str, len, val) == len;
+}
+
+StreamLexer createStreamLexer(StreamTokensFunction on_tokens, void * context) {
+    return (StreamLexer) {
+        .carry = createByteBuf(),
+        .tokens = createTokenVec(),
+        .on_tokens = on_tokens,
+        .context = context,
+    };
+}
+
+void freeStreamLexer(StreamLexer lexer) {
+    freeByteBuf(lexer.carry);
+    freeTokenVec(lexer.tokens);
+}
+
+// A + or - right behind the e of a decimal or the p of a hexadecimal literal is the sign of its exponent
+static bool isExponentSign(const char * token, size_t len) {
+    if (!isdigit((unsigned char)token[0]) && token[0] != '.') return false;
+    const bool hex = len > 2 && token[0] == '0' && (token[1] | 0x20) == 'x';
+    return (token[len - 1] | 0x20) == (hex ? 'p' : 'e');
+}
+
+// No token continues across text[i], so the text can be split in front of it.
+// Characters before lo are unknown, a sign whose token may start there is never a cut.
+static bool isTokenCut(const char * text, size_t lo, size_t i) {
+    const char c = text[i];
+    if (IS_WHITE_SPACE_TOKEN(c) || (IS_OPERATOR(c) && c != '+' && c != '-')) return true;
+    if (c != '+' && c != '-') return false;
+    size_t start = i;
+    while (start > lo && !IS_WHITE_SPACE_TOKEN(text[start - 1]) && !IS_OPERATOR(text[start - 1])) start--;
+    if (start == i) return i > lo;
+    return start > lo && !isExponentSign(text + start, i - start);
+}
+
+// Tokenizes len characters starting at offset base of the whole text and hands their tokens on
+static bool lexStreamPiece(StreamLexer * lexer, const char * text, size_t len, size_t base) {
+    lexer->tokens.count = 0;
+    if (!tokenizeChunk(text, len, base, &lexer->tokens)) return false;
+    return !lexer->tokens.count || lexer->on_tokens(lexer->context, text, base, &lexer->tokens);
+}
+
+bool feedStreamLexer(StreamLexer * lexer, const char * chunk, size_t len) {
+    size_t last = len;
+    while (last > 0 && !isTokenCut(chunk, 0, last - 1)) last--;
+    if (!last) {
+        // Only one token can be this long, every longer carry is a syntax error anyway
+        if (lexer->carry.count + len > STREAM_MAX_CARRY) {
+            snprintf(err_msg, sizeof(err_msg), "Unknown Token at column %zu. No token ends within %d characters\n", lexer->offset + 1, STREAM_MAX_CARRY);
+            return false;
+        }
+        if (!reserveByteBuf(&lexer->carry, lexer->carry.count + len)) goto out_of_memory;
+        memcpy(lexer->carry.vals + lexer->carry.count, chunk, len);
+        lexer->carry.count += len;
+        return true;
+    }
+    last--;
+
+    // The carried characters are completed by the chunk up to its first cut
+    size_t first = 0;
+    if (lexer->carry.count) {
+        while (!isTokenCut(chunk, 0, first)) first++;
+        if (!reserveByteBuf(&lexer->carry, lexer->carry.count + first)) goto out_of_memory;
+        memcpy(lexer->carry.vals + lexer->carry.count, chunk, first);
+        lexer->carry.count += first;
+        if (!lexStreamPiece(lexer, lexer->carry.vals, lexer->carry.count, lexer->offset)) return false;
+        lexer->offset += lexer->carry.count;
+        lexer->carry.count = 0;
+    }
+    if (!lexStreamPiece(lexer, chunk + first, last - first, lexer->offset)) return false;
+    lexer->offset += last - first;
+
+    if (!reserveByteBuf(&lexer->carry, len - last)) goto out_of_memory;
+    memcpy(lexer->carry.vals, chunk + last, len - last);
+    lexer->carry.count = len - last;
+    return true;
+
+out_of_memory:
+    snprintf(err_msg, sizeof(err_msg), "Out of memory while tokenizing\n");
+    return false;
+}
+
+bool finishStreamLexer(StreamLexer * lexer) {
+    if (!lexer->carry.count) return true;
+    if (!lexStreamPiece(lexer, lexer->carry.vals, lexer->carry.count, lexer->offset)) return false;
+    lexer->offset += lexer->carry.count;
+    lexer->carry.count = 0;
+    return true;
+}
+
+bool lexStreamFile(StreamLexer * lexer, FILE * fp) {
+    char * chunk = malloc(STREAM_CHUNK_SIZE);
+    if (!chunk) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while tokenizing\n");
+        return false;
+    }
+    size_t len;
+    bool ok = true;
+    while (ok && (len = fread(chunk, 1, STREAM_CHUNK_SIZE, fp)) > 0) ok = feedStreamLexer(lexer, chunk, len);
+    if (ok && ferror(fp)) {
+        snprintf(err_msg, sizeof(err_msg), "Could not read after column %zu\n", lexer->offset + lexer->carry.count);
+        ok = false;
+    }
+    free(chunk);
+    return ok && finishStreamLexer(lexer);
+}
+
+// Moves the tokens of one piece to the offsets inside the whole file
+static bool appendFileTokens(void * context, const char * text, size_t base, const TokenVec * tokens) {
+    (void)text;
+    TokenVec * file_tokens = context;
+    if (base + tokens->vals[tokens->count - 1].offset > UINT32_MAX) {
+        snprintf(err_msg, sizeof(err_msg), "File is too long to keep its tokens (%zu characters)\n", base);
+        return false;
+    }
+    if (!reserveTokenVec(file_tokens, file_tokens->count + tokens->count)) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while tokenizing\n");
+        return false;
+    }
+    for (size_t i = 0; i < tokens->count; i++) {
+        Token token = tokens->vals[i];
+        token.offset = (uint32_t)(base + token.offset);
+        file_tokens->vals[file_tokens->count++] = token;
+    }
+    return true;
+}
+
+// Offsets of tokens read from a file are relative to the start of the file
+bool tokenize_file(const char * filename, TokenVec * tokens) {
+    FILE * fp = fopen(filename, "r");
+    if (!fp) {
+        snprintf(err_msg, sizeof(err_msg), "Could not open file >%s<\n", filename);
+        return false;
+    }
+
+    StreamLexer lexer = createStreamLexer(appendFileTokens, tokens);
+    const bool ok = lexStreamFile(&lexer, fp);
+    freeStreamLexer(lexer);
+    fclose(fp);
+
+    return ok;
+}
+
+bool tokenize(const char * expression, TokenVec * tokens) {
+    return tokenizeN(expression, strlen(expression), tokens);
+}
+
+bool tokenizeN(const char * expression, size_t len, TokenVec * tokens) {
+    return tokenizeRange(expression, 0, len, tokens);
+}
+
+// Lexes the token starting at *pos, which is no white space, and moves *pos behind it.
+// Columns of errors are counted from base characters before expression.
+static inline bool lexToken(const char * expression, size_t len, size_t * pos, size_t base, Token * token) {
+    size_t i = *pos;
+    const char c = expression[i];
+    *token = (Token) {
+        .value = 0,
+        .offset = (uint32_t)i,
+        .length = 1,
+        .type = TokenOperator,
+        .operator = NoOperator,
+    };
+
+    if (IS_OPERATOR(c)) {
+        if      (c == '(') token->type = TokenParenOpen;
+        else if (c == ')') token->type = TokenParenClose;
+        else               token->operator = (uint8_t)charToOperator(c);
+        *pos = i + 1;
+        return true;
+    }
+
+    // Numbers end where parseNumber stops, their exponent may contain a sign
+    const size_t start = i;
+    const bool variable = IS_VARIABLE_START(c);
+    const size_t number = variable ? 0 : parseNumber(expression + start, len - start, &token->value);
+    i += number;
+    bool valid = variable || number;
+    while (i < len && !IS_WHITE_SPACE_TOKEN(expression[i]) && !IS_OPERATOR(expression[i])) {
+        valid = valid && variable && IS_VARIABLE_CHAR(expression[i]);
+        i++;
+    }
+    valid = valid && i - start <= UINT16_MAX;
+    if (!valid) {
+        snprintf(err_msg, sizeof(err_msg), "Unknown Token >%.*s< at column %zu\n", (int)(i - start), expression + start, base + start + 1);
+        return false;
+    }
+    token->type = variable ? TokenVariable : TokenValue;
+    token->length = (uint16_t)(i - start);
+    for (size_t b = 0; variable && b < sizeof(builtins) / sizeof(builtins[0]); b++) {
+        if (strncmp(builtins[b].name, expression + start, token->length) != 0 || builtins[b].name[token->length] != '\0') continue;
+        token->type = builtins[b].operator == NoOperator ? TokenValue : TokenOperator;
+        token->operator = (uint8_t)builtins[b].operator;
+        token->value = builtins[b].value;
+        break;
+    }
+    *pos = i;
+    return true;
+}
+
+bool nextToken(const char * expression, size_t len, size_t * pos, Token * token) {
+    while (*pos < len && IS_WHITE_SPACE_TOKEN(expression[*pos])) (*pos)++;
+    if (*pos == len) {
+        token->length = 0;
+        return true;
+    }
+    if (len > UINT32_MAX) {
+        snprintf(err_msg, sizeof(err_msg), "Expression is too long (%zu characters)\n", len);
+        return false;
+    }
+    return lexToken(expression, len, pos, 0, token);
+}
+
+// Columns of errors are counted from base characters before expression
+static bool tokenizeSpan(const char * expression, size_t start, size_t len, size_t base, TokenVec * tokens) {
+
+    if (len > UINT32_MAX) {
+        snprintf(err_msg, sizeof(err_msg), "Expression is too long (%zu characters)\n", len);
+        return false;
+    }
+
+    TRACE_STAGE(TraceTokenize, TraceBegin, 0, 0);
+    const size_t first_token = tokens->count;
+    size_t i = start;
+    while (i < len) {
+        if (IS_WHITE_SPACE_TOKEN(expression[i])) {
+            i++;
+            continue;
+        }
+
+        Token token;
+        if (!lexToken(expression, len, &i, base, &token)) return false;
+        if (!appendTokenVec(tokens, token)) {
+            snprintf(err_msg, sizeof(err_msg), "Out of memory while tokenizing\n");
+            return false;
+        }
+        TRACE_TOKEN(token.offset, token.type, token.operator, token.value);
+    }
+    TRACE_STAGE(TraceTokenize, TraceEnd, tokens->count - first_token, 0);
+
+    return true;
+}
+
+bool tokenizeRange(const char * expression, size_t start, size_t len, TokenVec * tokens) {
+    return tokenizeSpan(expression, start, len, 0, tokens);
+}
+
+bool tokenizeChunk(const char * chunk, size_t len, size_t base, TokenVec * tokens) {
+    return tokenizeSpan(chunk, 0, len, base, tokens);
+}
+
+#define PARSE_UNARY 0x80000000u // Marks a unary operator on the operator stack
+
+int operatorPrecedence(Operator operator) {
+    switch (operator) {
+        case OperatorPlus:
+        case OperatorMinus:  return 1;
+        case OperatorMult:
+        case OperatorDiv:    return 2;
+        case OperatorNegate: return 3;
+        case OperatorPower:  return 4;
+        case OperatorSqrt:
+        case OperatorExp:
+        case OperatorLog:
+        case OperatorSin:
+        case OperatorCos:    return 5;
+        case NoOperator:     break;
+    }
+    return 0;
+}
+
+// Operator of an entry of the operator stack, a unary minus is OperatorNegate
+static Operator stackedOperator(const TokenVec * tokens, uint32_t entry) {
+    const Operator operator = tokens->vals[entry & ~PARSE_UNARY].operator;
+    return (entry & PARSE_UNARY) && operator == OperatorMinus ? OperatorNegate : operator;
+}
+
+// Pops the operator on top of the operator stack and creates its node from the operand stack
+static void reduceSyntaxTree(NodeArena * arena, const TokenVec * tokens, uint32_t * operators, size_t * operator_count, NodeIndex * operands, size_t * operand_count) {
+    const uint32_t entry = operators[--(*operator_count)];
+    if (entry & PARSE_UNARY) {
+        const NodeIndex operand = operands[*operand_count - 1];
+        operands[*operand_count - 1] = createSyntaxNode(arena, operand, NO_NODE, TokenOperator, 0, stackedOperator(tokens, entry));
+    } else {
+        const NodeIndex right = operands[--(*operand_count)];
+        const NodeIndex left = operands[*operand_count - 1];
+        operands[*operand_count - 1] = createSyntaxNode(arena, left, right, TokenOperator, 0, tokens->vals[entry].operator);
+    }
+}
+
+// Precedence climbing over explicit stacks, so nesting depth is only bounded by memory.
+// Nodes are created children first, the returned root is always the last node of the tree.
+// A shared root is the last node too, no proper subexpression equals the whole expression.
+NodeIndex createSyntaxTree(NodeArena * arena, const char * expression, const TokenVec * tokens) {
+
+    TRACE_STAGE(TraceParse, TraceBegin, 0, 0);
+    const size_t count = tokens->count;
+    if (count == 0) {
+        snprintf(err_msg, sizeof(err_msg), "Syntax Error: Empty Expression\n");
+        return NO_NODE;
+    }
+
+    // Every token becomes at most one node, so the arena never grows while building
+    if (!reserveNodeArena(arena, arena->count + count)) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while creating Syntax Tree\n");
+        return NO_NODE;
+    }
+    if (!reserveNodeArenaScratch(arena, 2 * count) || (arena->share_nodes && !reserveSharedNodes(arena, arena->count + count))) {
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while creating Syntax Tree\n");
+        return NO_NODE;
+    }
+    NodeIndex * operands = arena->scratch;
+    uint32_t * operators = arena->scratch + count;
+    size_t operand_count = 0;
+    size_t operator_count = 0;
+
+    bool expect_value = true;
+    for (size_t i = 0; i < count; i++) {
+        const Token * token = &tokens->vals[i];
+        switch (token->type) {
+            case TokenValue:
+                if (!expect_value) goto expected_operator;
+                operands[operand_count++] = createSyntaxNode(arena, NO_NODE, NO_NODE, TokenValue, token->value, NoOperator);
+                expect_value = false;
+                break;
+            case TokenVariable: {
+                if (!expect_value) goto expected_operator;
+                const NodeIndex variable = addVariable(arena, expression + token->offset, token->length);
+                if (variable == NO_NODE) {
+                    snprintf(err_msg, sizeof(err_msg), "Out of memory while creating Syntax Tree\n");
+                    return NO_NODE;
+                }
+                operands[operand_count++] = createSyntaxNode(arena, variable, NO_NODE, TokenVariable, 0, NoOperator);
+                expect_value = false;
+                break;
+            }
+            case TokenParenOpen:
+                if (!expect_value) goto expected_operator;
+                operators[operator_count++] = (uint32_t)i;
+                break;
+            case TokenParenClose:
+                if (expect_value) goto expected_value;
+                while (operator_count && tokens->vals[operators[operator_count - 1] & ~PARSE_UNARY].type != TokenParenOpen) {
+                    reduceSyntaxTree(arena, tokens, operators, &operator_count, operands, &operand_count);
+                }
+                if (!operator_count) {
+                    snprintf(err_msg, sizeof(err_msg), "Syntax Error at column %u. Unmatched >)<\n", token->offset + 1);
+                    return NO_NODE;
+                }
+                operator_count--;
+                break;
+            case TokenOperator: {
+                if (isFunctionOperator(token->operator)) {
+                    if (!expect_value) goto expected_operator;
+                    if (i + 1 == count || tokens->vals[i + 1].type != TokenParenOpen) {
+                        snprintf(err_msg, sizeof(err_msg), "Syntax Error at Token >%.*s< at column %u. Expected >(< after function\n", (int)token->length, expression + token->offset, token->offset + 1);
+                        return NO_NODE;
+                    }
+                    operators[operator_count++] = (uint32_t)i | PARSE_UNARY;
+                    break;
+                }
+                if (expect_value) {
+                    if (token->operator != OperatorMinus) goto expected_value;
+                    operators[operator_count++] = (uint32_t)i | PARSE_UNARY;
+                    break;
+                }
+                const int precedence = operatorPrecedence(token->operator);
+                const bool right_assoc = token->operator == OperatorPower;
+                while (operator_count) {
+                    const uint32_t top = operators[operator_count - 1];
+                    const Token * top_token = &tokens->vals[top & ~PARSE_UNARY];
+                    if (top_token->type == TokenParenOpen) break;
+                    const int top_precedence = operatorPrecedence(stackedOperator(tokens, top));
+                    if (top_precedence < precedence || (top_precedence == precedence && right_assoc)) break;
+                    reduceSyntaxTree(arena, tokens, operators, &operator_count, operands, &operand_count);
+                }
+                operators[operator_count++] = (uint32_t)i;
+                expect_value = true;
+                break;
+            }
+        }
+        continue;
+
+expected_operator:
+        snprintf(err_msg, sizeof(err_msg), "Syntax Error at Token >%.*s< at column %u. Expected Operator\n", (int)token->length, expression + token->offset, token->offset + 1);
+        return NO_NODE;
+expected_value:
+        snprintf(err_msg, sizeof(err_msg), "Syntax Error at Token >%.*s< at column %u. Expected Value before\n", (int)token->length, expression + token->offset, token->offset + 1);
+        return NO_NODE;
+    }
+
+    if (expect_value) {
+        const Token * last = &tokens->vals[count - 1];
+        snprintf(err_msg, sizeof(err_msg), "Syntax Error at Token >%.*s< at column %u. Expected Value next\n", (int)last->length, expression + last->offset, last->offset + 1);
+        return NO_NODE;
+    }
+    while (operator_count) {
+        const Token * top_token = &tokens->vals[operators[operator_count - 1] & ~PARSE_UNARY];
+        if (top_token->type == TokenParenOpen) {
+            snprintf(err_msg, sizeof(err_msg), "Syntax Error at column %u. Unmatched >(<\n", top_token->offset + 1);
+            return NO_NODE;
+        }
+        reduceSyntaxTree(arena, tokens, operators, &operator_count, operands, &operand_count);
+    }
+    assert(operand_count == 1);
+
+    TRACE_STAGE(TraceParse, TraceEnd, operands[0] + 1, 0);
+    return operands[0];
+}
+
+OperatorStacks createOperatorStacks(FindValueFunction find_value, const void * variables) {
+    return (OperatorStacks) {
+        .values = createStackedValueVec(),
+        .operators = createStackedOperatorVec(),
+        .find_value = find_value,
+        .variables = variables,
+        .expect_value = true,
+    };
+}
+
+OperatorStacks createFixedOperatorStacks(double * values, StackedOperator * operators, size_t capacity, FindValueFunction find_value, const void * variables) {
+    return (OperatorStacks) {
+        .values = { 0, capacity, values },
+        .operators = { 0, capacity, operators },
+        .find_value = find_value,
+        .variables = variables,
+        .fixed = true,
+        .expect_value = true,
+    };
+}
+
+void freeOperatorStacks(OperatorStacks stacks) {
+    if (stacks.fixed) return;
+    freeStackedValueVec(stacks.values);
+    freeStackedOperatorVec(stacks.operators);
+}
+
+// Pops the operator on top of the stack and applies it to the values on top of the value stack
+static void reduceOperatorStacks(OperatorStacks * stacks) {
+    const StackedOperator top = stacks->operators.vals[--stacks->operators.count];
+    double * values = stacks->values.vals;
+    if (top.unary) {
+        double * operand = &values[stacks->values.count - 1];
+        applyOperator(*operand, 0, top.operator, operand);
+    } else {
+        const double right = values[--stacks->values.count];
+        double * left = &values[stacks->values.count - 1];
+        applyOperator(*left, right, top.operator, left);
+    }
+}
+
+static bool pushStackedOperator(OperatorStacks * stacks, const Token * token, size_t base, Operator operator, bool unary) {
+    const StackedOperator entry = {
+        .offset = base + token->offset,
+        .type = token->type,
+        .operator = (uint8_t)operator,
+        .unary = unary,
+    };
+    if (stacks->fixed && stacks->operators.count == stacks->operators.capacity) {
+        snprintf(err_msg, sizeof(err_msg), "Expression is nested too deep for %zu operators\n", stacks->operators.capacity);
+        return false;
+    }
+    if (appendStackedOperatorVec(&stacks->operators, entry)) return true;
+    snprintf(err_msg, sizeof(err_msg), "Out of memory while evaluating\n");
+    return false;
+}
+
+static bool pushStackedValue(OperatorStacks * stacks, double value) {
+    if (stacks->fixed && stacks->values.count == stacks->values.capacity) {
+        snprintf(err_msg, sizeof(err_msg), "Expression is nested too deep for %zu values\n", stacks->values.capacity);
+        return false;
+    }
+    if (appendStackedValueVec(&stacks->values, value)) return true;
+    snprintf(err_msg, sizeof(err_msg), "Out of memory while evaluating\n");
+    return false;
+}
+
+// Text of the function on top of the stack, function names are only written one way
+static void expectedParenError(const OperatorStacks * stacks) {
+    const StackedOperator * top = &stacks->operators.vals[stacks->operators.count - 1];
+    snprintf(err_msg, sizeof(err_msg), "Syntax Error at Token >%s< at column %zu. Expected >(< after function\n", operatorToStr(top->operator), top->offset + 1);
+}
+
+// Same rules and messages as createSyntaxTree, columns are counted from the start of the whole text
+bool pushOperatorToken(OperatorStacks * stacks, const char * text, size_t base, const Token * token) {
+    const size_t column = base + token->offset + 1;
+    if (stacks->expect_paren && token->type != TokenParenOpen) {
+        expectedParenError(stacks);
+        return false;
+    }
+    stacks->expect_paren = false;
+
+    switch (token->type) {
+        case TokenValue:
+            if (!stacks->expect_value) goto expected_operator;
+            stacks->expect_value = false;
+            return pushStackedValue(stacks, token->value);
+        case TokenVariable: {
+            if (!stacks->expect_value) goto expected_operator;
+            double value;
+            if (!stacks->find_value || !stacks->find_value(stacks->variables, text + token->offset, token->length, &value)) {
+                snprintf(err_msg, sizeof(err_msg), "Variable >%.*s< has no value\n", (int)token->length, text + token->offset);
+                return false;
+            }
+            stacks->expect_value = false;
+            return pushStackedValue(stacks, value);
+        }
+        case TokenParenOpen:
+            if (!stacks->expect_value) goto expected_operator;
+            return pushStackedOperator(stacks, token, base, NoOperator, false);
+        case TokenParenClose:
+            if (stacks->expect_value) goto expected_value;
+            while (stacks->operators.count && stacks->operators.vals[stacks->operators.count - 1].type != TokenParenOpen) reduceOperatorStacks(stacks);
+            if (!stacks->operators.count) {
+                snprintf(err_msg, sizeof(err_msg), "Syntax Error at column %zu. Unmatched >)<\n", column);
+                return false;
+            }
+            stacks->operators.count--;
+            return true;
+        case TokenOperator: {
+            if (isFunctionOperator(token->operator)) {
+                if (!stacks->expect_value) goto expected_operator;
+                stacks->expect_paren = true;
+                return pushStackedOperator(stacks, token, base, token->operator, true);
+            }
+            if (stacks->expect_value) {
+                if (token->operator != OperatorMinus) goto expected_value;
+                return pushStackedOperator(stacks, token, base, OperatorNegate, true);
+            }
+            const int precedence = operatorPrecedence(token->operator);
+            const bool right_assoc = token->operator == OperatorPower;
+            while (stacks->operators.count) {
+                const StackedOperator * top = &stacks->operators.vals[stacks->operators.count - 1];
+                if (top->type == TokenParenOpen) break;
+                const int top_precedence = operatorPrecedence(top->operator);
+                if (top_precedence < precedence || (top_precedence == precedence && right_assoc)) break;
+                reduceOperatorStacks(stacks);
+            }
+            stacks->expect_value = true;
+            return pushStackedOperator(stacks, token, base, token->operator, false);
+        }
+    }
+    return true;
+
+expected_operator:
+    snprintf(err_msg, sizeof(err_msg), "Syntax Error at Token >%.*s< at column %zu. Expected Operator\n", (int)token->length, text + token->offset, column);
+    return false;
+expected_value:
+    snprintf(err_msg, sizeof(err_msg), "Syntax Error at Token >%.*s< at column %zu. Expected Value before\n", (int)token->length, text + token->offset, column);
+    return false;
+}
+
+// An expression waiting for a value ended behind an operator or >(<, which is on top of the stack
+bool finishOperatorStacks(OperatorStacks * stacks, double * result) {
+    if (stacks->expect_value && !stacks->operators.count) {
+        snprintf(err_msg, sizeof(err_msg), "Syntax Error: Empty Expression\n");
+        return false;
+    }
+    if (stacks->expect_paren) {
+        expectedParenError(stacks);
+        return false;
+    }
+    if (stacks->expect_value) {
+        const StackedOperator * top = &stacks->operators.vals[stacks->operators.count - 1];
+        const char * token = top->type == TokenParenOpen ? "(" : operatorToStr(top->operator);
+        snprintf(err_msg, sizeof(err_msg), "Syntax Error at Token >%s< at column %zu. Expected Value next\n", token, top->offset + 1);
+        return false;
+    }
+    while (stacks->operators.count) {
+        const StackedOperator * top = &stacks->operators.vals[stacks->operators.count - 1];
+        if (top->type == TokenParenOpen) {
+            snprintf(err_msg, sizeof(err_msg), "Syntax Error at column %zu. Unmatched >(<\n", top->offset + 1);
+            return false;
+        }
+        reduceOperatorStacks(stacks);
+    }
+
+    *result = stacks->values.vals[0];
+    return true;
+}
+
+bool applyOperator(double a, double b, Operator operator, double * result) {
+    if (!result) return false;
+    switch (operator) {
+        case OperatorPlus:
+            *result = a + b;
+            return true;
+            break;
+        case OperatorMinus:
+            *result = a - b;
+            return true;
+            break;
+        case OperatorMult:
+            *result = a * b;
+            return true;
+            break;
+        case OperatorDiv:
+            *result = a / b;
+            return true;
+            break;
+        case OperatorPower:
+            *result = pow(a, b);
+            return true;
+        case OperatorNegate:
+            *result = -a;
+            return true;
+        case OperatorSqrt:
+            *result = sqrt(a);
+            return true;
+        case OperatorExp:
+            *result = mathExp(a);
+            return true;
+        case OperatorLog:
+            *result = mathLog(a);
+            return true;
+        case OperatorSin:
+            *result = mathSin(a);
+            return true;
+        case OperatorCos:
+            *result = mathCos(a);
+            return true;
+        case NoOperator:
+            break;
+    }
+    return false;
+}
+
+// With contained set a node referencing a node before first fails, the compiler removes the check otherwise
+static inline bool sweepNodes(NodeArena * arena, NodeIndex first, NodeIndex last, const double * variables, bool contained) {
+    const NodeIndex * const lefts = arena->lefts;
+    const NodeIndex * const rights = arena->rights;
+    const uint8_t * const types = arena->types;
+    const uint8_t * const operators = arena->operators;
+    double * const values = arena->values;
+
+    for (NodeIndex current = first; current <= last; current++) {
+        if (types[current] == TokenValue) continue;
+        if (types[current] == TokenVariable) {
+            if (!variables) {
+                snprintf(err_msg, sizeof(err_msg), "Variable >%s< has no value\n", arena->variables.vals[lefts[current]]);
+                return false;
+            }
+            values[current] = variables[lefts[current]];
+            continue;
+        }
+
+        const Operator operator = operators[current];
+        const bool unary = isUnaryOperator(operator);
+        if (contained && (lefts[current] < first || (!unary && rights[current] < first))) {
+            snprintf(err_msg, sizeof(err_msg), "Node %u references a node outside of its subtree\n", current);
+            return false;
+        }
+        const double left = values[lefts[current]];
+        const double right = unary ? 0 : values[rights[current]];
+        if (!applyOperator(left, right, operator, &values[current])) {
+            snprintf(err_msg, sizeof(err_msg), "Cannot apply Operator >%s<\n", operatorToStr(operator));
+            return false;
+        }
+        TRACE_OPERATION(current, operator, left, right, values[current]);
+    }
+    return true;
+}
+
+bool calculateNodes(NodeArena * arena, NodeIndex first, NodeIndex last, const double * variables) {
+    return sweepNodes(arena, first, last, variables, false);
+}
+
+bool calculateSubtree(NodeArena * arena, NodeIndex first, NodeIndex last, const double * variables) {
+    return sweepNodes(arena, first, last, variables, true);
+}
+
+// Children are always stored before their parents, so one forward sweep evaluates the tree.
+// The arena must only hold the tree of root, operator and variable nodes receive their result as value.
+// variables holds one value per entry of arena->variables and may be NULL if there are none.
+bool calculateResult(NodeArena * arena, NodeIndex root, const double * variables, double * result) {
+
+    TRACE_STAGE(TraceEvaluate, TraceBegin, root + 1, 0);
+    if (!calculateNodes(arena, 0, root, variables)) return false;
+
+    *result = arena->values[root];
+    TRACE_STAGE(TraceEvaluate, TraceEnd, root + 1, *result);
+    return true;
+}
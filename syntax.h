@@ -0,0 +1,165 @@
+#ifndef __SYNTAX_H__
+#define __SYNTAX_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cvecs.h"
+
+typedef enum TokenType {
+    TokenValue = 0,
+    TokenOperator,
+    TokenParenOpen,
+    TokenParenClose,
+    TokenVariable,
+} TokenType;
+
+typedef enum Operator {
+    NoOperator = 0,
+    OperatorPlus,
+    OperatorMinus,
+    OperatorMult,
+    OperatorDiv,
+    OperatorPower,
+    OperatorNegate, // Unary, only has a left operand
+    OperatorSqrt,   // Unary, only has a left operand
+    OperatorExp,    // Unary, only has a left operand
+    OperatorLog,    // Unary, only has a left operand
+    OperatorSin,    // Unary, only has a left operand
+    OperatorCos,    // Unary, only has a left operand
+} Operator;
+
+typedef uint32_t NodeIndex;
+#define NO_NODE UINT32_MAX
+
+// Syntax nodes of an expression are stored as struct of arrays inside one allocation.
+// Nodes reference each other by index, the arena is reset and reused for every expression.
+// A TokenVariable node stores the index of its name in variables as left.
+// With share_nodes set, structurally equal nodes are stored once and the tree becomes a DAG,
+// children are still stored before every node referencing them.
+typedef struct NodeArena {
+    size_t count;
+    size_t capacity;
+    double * values;
+    NodeIndex * lefts;
+    NodeIndex * rights;
+    uint8_t * types;     // TokenType
+    uint8_t * operators; // Operator
+    uint32_t * scratch;  // Stacks of the parser
+    size_t scratch_capacity;
+    StrVec variables;    // Names of the variables in the expression
+    NodeIndex * shared;  // Open addressing table of the stored nodes, only used with share_nodes
+    size_t shared_capacity;
+    size_t reused;       // createSyntaxNode calls that returned an existing node
+    bool share_nodes;
+} NodeArena;
+
+// A Token does not own its text, it points into the expression it was created from
+typedef struct Token {
+    double value;     // Parsed value of TokenValue
+    uint32_t offset;  // Offset of the token inside the expression
+    uint16_t length;  // Length of the token inside the expression
+    uint8_t type;     // TokenType
+    uint8_t operator; // Operator of TokenOperator, functions are TokenOperator with a unary Operator
+} Token;
+
+DEFINE_VEC(TokenVec, Token, DEFAULT_CAP_VEC) // createTokenVec, freeTokenVec, reserveTokenVec and appendTokenVec
+
+#define STREAM_CHUNK_SIZE (1 << 20)          // Bytes lexStreamFile reads at once
+#define STREAM_MAX_CARRY  (2 * UINT16_MAX)   // Characters a StreamLexer carries at most without finding the end of a token
+
+// Receives the tokens of one piece of a streamed text, their offsets are relative to text which starts
+// at offset base of the whole text. text and tokens are only valid during the call.
+typedef bool (*StreamTokensFunction)(void * context, const char * text, size_t base, const TokenVec * tokens);
+
+// Tokenizes a text handed over in chunks of any size with constant memory. Characters behind the
+// last position no token can continue across are carried over and tokenized with the next chunk.
+typedef struct StreamLexer {
+    ByteBuf carry;
+    size_t offset;      // Offset of carry inside the whole text
+    TokenVec tokens;    // Tokens of the current piece
+    StreamTokensFunction on_tokens;
+    void * context;
+} StreamLexer;
+
+// Operator waiting on the stack of OperatorStacks
+typedef struct StackedOperator {
+    size_t offset;      // Offset of its token inside the whole text
+    uint8_t type;       // TokenParenOpen or TokenOperator
+    uint8_t operator;   // Operator to apply, a unary minus is OperatorNegate
+    bool unary;
+} StackedOperator;
+
+DEFINE_VEC(StackedValueVec, double, 64)
+DEFINE_VEC(StackedOperatorVec, StackedOperator, 64)
+
+// Looks up the value of a variable for OperatorStacks, false if it has none
+typedef bool (*FindValueFunction)(const void * variables, const char * name, size_t len, double * value);
+
+// Evaluates tokens one at a time without a syntax tree, with the rules, results and messages of
+// createSyntaxTree and calculateResult. Operators are applied as soon as precedence allows, so the
+// stacks only grow with the nesting depth. Fixed stacks live in memory of the caller and fail once full.
+typedef struct OperatorStacks {
+    StackedValueVec values;
+    StackedOperatorVec operators;
+    FindValueFunction find_value;
+    const void * variables; // Handed to find_value
+    bool fixed;
+    bool expect_value;
+    bool expect_paren;      // The last token was a function
+} OperatorStacks;
+
+// Per thread, so every thread can tokenize, parse and calculate on its own
+extern _Thread_local char err_msg[1024]; // Message of the last error
+
+const char * operatorToStr(Operator op);
+Operator charToOperator(char c);
+int operatorPrecedence(Operator operator);
+bool isUnaryOperator(Operator operator);
+bool isFunctionOperator(Operator operator); // Unary operators written as name(argument)
+
+NodeArena createNodeArena(void);                        // Creates an empty NodeArena
+void freeNodeArena(NodeArena arena);                    // Frees Memory of NodeArena
+void resetNodeArena(NodeArena * arena);                 // Removes all Nodes but keeps the Memory
+bool reserveNodeArena(NodeArena * arena, size_t capacity); // Grows NodeArena to hold at least capacity Nodes
+bool reserveNodeArenaScratch(NodeArena * arena, size_t capacity); // Grows scratch to hold at least capacity entries
+bool reserveSharedNodes(NodeArena * arena, size_t capacity); // Grows the table of shared nodes to hold at least capacity Nodes
+void rehashNodeArena(NodeArena * arena);                // Rebuilds the table of shared nodes after Nodes were moved
+size_t findVariable(const StrVec * variables, const char * name, size_t len); // Returns variables->count if not found
+// Looks up the value of every variable in names, values[i] belongs to bound_names->vals[i]
+bool bindVariables(const StrVec * names, const StrVec * bound_names, const double * bound_values, double * values);
+NodeIndex createSyntaxNode(NodeArena * arena, NodeIndex left, NodeIndex right, TokenType type, double value, Operator operator);
+
+
+bool strToValue(const char * str, size_t len, double * val); // Parses exactly len characters as a number
+bool tokenize(const char * expression, TokenVec * tokens);      // Appends the Tokens of expression
+bool tokenizeN(const char * expression, size_t len, TokenVec * tokens); // Appends the Tokens of the first len characters
+bool tokenizeRange(const char * expression, size_t start, size_t len, TokenVec * tokens); // Same for the characters from start to len
+bool tokenizeChunk(const char * chunk, size_t len, size_t base, TokenVec * tokens); // Same for a chunk at offset base of a longer text, base only shifts the columns of errors
+bool tokenize_file(const char * filename, TokenVec * tokens);   // Appends the Tokens of file, their offsets are relative to its start
+bool nextToken(const char * expression, size_t len, size_t * pos, Token * token); // Lexes the Token at *pos and moves behind it, its length is 0 at the end
+
+StreamLexer createStreamLexer(StreamTokensFunction on_tokens, void * context); // Creates a StreamLexer that hands its tokens to on_tokens
+void freeStreamLexer(StreamLexer lexer);                                         // Frees Memory of StreamLexer
+bool feedStreamLexer(StreamLexer * lexer, const char * chunk, size_t len);      // Tokenizes the next chunk of the text
+bool finishStreamLexer(StreamLexer * lexer);                                     // Tokenizes the carried characters at the end of the text
+bool lexStreamFile(StreamLexer * lexer, FILE * fp);                             // Feeds fp chunk by chunk and finishes the text
+
+OperatorStacks createOperatorStacks(FindValueFunction find_value, const void * variables); // Creates growing stacks
+// Creates stacks of capacity entries each in values and operators, which never allocate
+OperatorStacks createFixedOperatorStacks(double * values, StackedOperator * operators, size_t capacity, FindValueFunction find_value, const void * variables);
+void freeOperatorStacks(OperatorStacks stacks);                                 // Frees Memory of growing stacks
+// Applies the next token, its offset is relative to text which starts at offset base of the whole text
+bool pushOperatorToken(OperatorStacks * stacks, const char * text, size_t base, const Token * token);
+bool finishOperatorStacks(OperatorStacks * stacks, double * result);            // Applies the waiting operators once the expression ended
+
+NodeIndex createSyntaxTree(NodeArena * arena, const char * expression, const TokenVec * tokens); // Returns root or NO_NODE
+bool applyOperator(double a, double b, Operator operator, double * result);
+bool calculateResult(NodeArena * arena, NodeIndex root, const double * variables, double * result);
+// Evaluates the nodes from first to last, children outside of that range must already have their value
+bool calculateNodes(NodeArena * arena, NodeIndex first, NodeIndex last, const double * variables);
+// Same for nodes that may only reference each other, false if one references a node before first
+bool calculateSubtree(NodeArena * arena, NodeIndex first, NodeIndex last, const double * variables);
+
+#endif // __SYNTAX_H__
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+#include "syntax.h"
+
+#define TRACE_CALIBRATION_NS 2000000 // Time spent at start measuring how fast ticks advance
+
+TraceFile * trace_file = NULL;
+_Thread_local TraceRing * trace_ring = NULL;
+_Thread_local bool trace_untraced = false;
+
+static size_t trace_size = 0;
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+bool openTrace(const char * filename) {
+    const size_t size = sizeof(TraceFile) + TRACE_MAX_THREADS * sizeof(TraceRing);
+    const int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        snprintf(err_msg, sizeof(err_msg), "Could not open trace file >%s<\n", filename);
+        return false;
+    }
+    // The file stays sparse, only rings that get used take up space
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        snprintf(err_msg, sizeof(err_msg), "Could not resize trace file >%s<\n", filename);
+        return false;
+    }
+    TraceFile * file = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        snprintf(err_msg, sizeof(err_msg), "Could not map trace file >%s<\n", filename);
+        return false;
+    }
+
+    const uint64_t start_ns = nowNs();
+    const uint64_t start_ticks = traceTicks();
+    uint64_t end_ns;
+    while ((end_ns = nowNs()) - start_ns < TRACE_CALIBRATION_NS);
+    const uint64_t end_ticks = traceTicks();
+
+    memcpy(file->magic, TRACE_MAGIC, sizeof(file->magic));
+    file->record_size = sizeof(TraceRecord);
+    file->ring_records = TRACE_RING_RECORDS;
+    file->max_threads = TRACE_MAX_THREADS;
+    atomic_store(&file->thread_count, 0);
+    file->ticks_per_us = (double)(end_ticks - start_ticks) * 1e3 / (double)(end_ns - start_ns);
+    file->start_ticks = start_ticks;
+
+    trace_size = size;
+    trace_file = file;
+    return true;
+}
+
+void closeTrace(void) {
+    TraceFile * file = trace_file;
+    if (!file) return;
+    trace_file = NULL;
+    munmap(file, trace_size);
+}
+
+TraceRing * attachTraceThread(void) {
+    const uint32_t index = atomic_fetch_add(&trace_file->thread_count, 1);
+    if (index >= trace_file->max_threads) {
+        trace_untraced = true;
+        return NULL;
+    }
+    trace_ring = &trace_file->rings[index];
+    trace_ring->thread_id = (uint64_t)syscall(SYS_gettid);
+    return trace_ring;
+}
@@ -0,0 +1,125 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#if !defined(__x86_64__) && !defined(__i386__)
+#include <time.h>
+#endif
+
+// 0: every TRACE_ macro compiles to nothing, 1: stages of every expression, 2: also every token and operation
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL 1
+#endif
+
+#define TRACE_MAGIC        "MLTRACE1"
+#define TRACE_MAX_THREADS  64
+#define TRACE_RING_RECORDS (1 << 15) // Records per thread, once full the oldest get overwritten
+
+typedef enum TraceEvent {
+    TraceTokenize = 0, // arg: tokens
+    TraceParse,        // arg: nodes
+    TraceOptimize,     // arg: nodes left
+    TraceCompile,      // arg: instructions
+    TraceEvaluate,     // result
+    TraceBatchChunk,   // arg: lines
+    TraceError,        // arg: line inside the batch chunk
+    TraceToken,        // arg: offset, token_type, operator, a: value
+    TraceOperation,    // arg: node, operator, a, b, result
+    TraceEventCount,
+} TraceEvent;
+
+typedef enum TracePhase {
+    TraceInstant = 0,
+    TraceBegin,
+    TraceEnd,
+} TracePhase;
+
+// Fixed size binary record, tracedump decodes them
+typedef struct TraceRecord {
+    uint64_t ticks;
+    double a;
+    double b;
+    double result;
+    uint32_t arg;
+    uint8_t event;
+    uint8_t phase;
+    uint8_t operator;
+    uint8_t token_type;
+} TraceRecord;
+
+// Only the thread owning a ring writes it, head is published after the record is complete
+typedef struct TraceRing {
+    _Atomic uint64_t head; // Records written so far, the latest is at (head - 1) % TRACE_RING_RECORDS
+    uint64_t thread_id;
+    uint64_t reserved[6];  // Keeps the heads of different threads on different cache lines
+    TraceRecord records[TRACE_RING_RECORDS];
+} TraceRing;
+
+// Layout of a trace file, it is mapped shared so the records survive a crash of the process
+typedef struct TraceFile {
+    char magic[8];
+    uint32_t record_size;
+    uint32_t ring_records;
+    uint32_t max_threads;
+    _Atomic uint32_t thread_count; // Rings handed out, threads beyond max_threads are not traced
+    double ticks_per_us;
+    uint64_t start_ticks;
+    uint64_t reserved[3];
+    TraceRing rings[];
+} TraceFile;
+
+extern TraceFile * trace_file;               // NULL while tracing is off
+extern _Thread_local TraceRing * trace_ring; // Ring of the calling thread, NULL until its first event
+extern _Thread_local bool trace_untraced;    // Set once a thread found no free ring
+
+bool openTrace(const char * filename); // Starts tracing into filename, replacing its contents
+void closeTrace(void);                 // Stops tracing, the file keeps every record
+TraceRing * attachTraceThread(void);   // Hands the calling thread its ring
+
+static inline uint64_t traceTicks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static inline void traceEvent(TraceEvent event, TracePhase phase, uint8_t operator, uint8_t token_type, uint32_t arg, double a, double b, double result) {
+    if (!trace_file || trace_untraced) return;
+    TraceRing * ring = trace_ring ? trace_ring : attachTraceThread();
+    if (!ring) return;
+
+    const uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    ring->records[head % TRACE_RING_RECORDS] = (TraceRecord) {
+        .ticks = traceTicks(),
+        .a = a,
+        .b = b,
+        .result = result,
+        .arg = arg,
+        .event = (uint8_t)event,
+        .phase = (uint8_t)phase,
+        .operator = operator,
+        .token_type = token_type,
+    };
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+#if TRACE_LEVEL >= 1
+#define TRACE_STAGE(EVENT, PHASE, ARG, VALUE) traceEvent(EVENT, PHASE, 0, 0, (uint32_t)(ARG), VALUE, 0, 0)
+#else
+#define TRACE_STAGE(EVENT, PHASE, ARG, VALUE) ((void)sizeof(ARG), (void)sizeof(VALUE)) // Unevaluated, only keeps the arguments used
+#endif
+
+#if TRACE_LEVEL >= 2
+#define TRACE_TOKEN(OFFSET, TYPE, OPERATOR, VALUE) traceEvent(TraceToken, TraceInstant, (uint8_t)(OPERATOR), (uint8_t)(TYPE), (uint32_t)(OFFSET), VALUE, 0, 0)
+#define TRACE_OPERATION(NODE, OPERATOR, A, B, RESULT) traceEvent(TraceOperation, TraceInstant, (uint8_t)(OPERATOR), 0, (uint32_t)(NODE), A, B, RESULT)
+#else
+#define TRACE_TOKEN(OFFSET, TYPE, OPERATOR, VALUE) ((void)sizeof(OFFSET), (void)sizeof(TYPE), (void)sizeof(OPERATOR), (void)sizeof(VALUE))
+#define TRACE_OPERATION(NODE, OPERATOR, A, B, RESULT) ((void)sizeof(NODE), (void)sizeof(OPERATOR), (void)sizeof(A), (void)sizeof(B), (void)sizeof(RESULT))
+#endif
+
+#endif // __TRACE_H__
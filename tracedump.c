@@ -0,0 +1,146 @@
+// Decodes a trace file written by mathlang --trace, also after mathlang crashed
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "syntax.h"
+#include "trace.h"
+
+typedef struct DumpRecord {
+    TraceRecord record;
+    uint32_t thread;
+    uint64_t sequence;
+} DumpRecord;
+
+static const char * event_names[TraceEventCount] = {
+    [TraceTokenize] = "tokenize",
+    [TraceParse] = "parse",
+    [TraceOptimize] = "optimize",
+    [TraceCompile] = "compile",
+    [TraceEvaluate] = "evaluate",
+    [TraceBatchChunk] = "chunk",
+    [TraceError] = "error",
+    [TraceToken] = "token",
+    [TraceOperation] = "operation",
+};
+
+static const char * phase_names[] = {"", "begin", "end"};
+
+static int compareRecords(const void * a, const void * b) {
+    const DumpRecord * left = a;
+    const DumpRecord * right = b;
+    if (left->record.ticks != right->record.ticks) return left->record.ticks < right->record.ticks ? -1 : 1;
+    if (left->thread != right->thread) return left->thread < right->thread ? -1 : 1;
+    return left->sequence < right->sequence ? -1 : left->sequence > right->sequence;
+}
+
+static void printDetails(const TraceRecord * record) {
+    const Operator operator = (Operator)record->operator;
+    switch ((TraceEvent)record->event) {
+        case TraceTokenize:
+        case TraceParse:
+        case TraceOptimize:
+        case TraceCompile:
+        case TraceBatchChunk:
+            if (record->phase == TraceEnd || record->event == TraceOptimize) {
+                const char * unit = record->event == TraceTokenize ? "tokens"
+                                  : record->event == TraceCompile ? "instructions"
+                                  : record->event == TraceBatchChunk ? "lines" : "nodes";
+                printf("%u %s", record->arg, unit);
+            }
+            break;
+        case TraceEvaluate:
+            if (record->phase == TraceEnd) printf("%.17g", record->a);
+            else                           printf("%u nodes", record->arg);
+            break;
+        case TraceError:
+            printf("line %u of the chunk", record->arg + 1);
+            break;
+        case TraceToken:
+            printf("column %u: ", record->arg + 1);
+            if      (record->token_type == TokenValue)      printf("value %.17g", record->a);
+            else if (record->token_type == TokenVariable)   printf("variable");
+            else if (record->token_type == TokenParenOpen)  printf("(");
+            else if (record->token_type == TokenParenClose) printf(")");
+            else                                            printf("operator %s", operatorToStr(operator));
+            break;
+        case TraceOperation:
+            printf("node %u: ", record->arg);
+            if (isUnaryOperator(operator)) printf("%s %.17g", operatorToStr(operator), record->a);
+            else                           printf("%.17g %s %.17g", record->a, operatorToStr(operator), record->b);
+            printf(" = %.17g", record->result);
+            break;
+        default:
+            break;
+    }
+}
+
+int main(int argc, char * argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s TraceFile [LastRecords]\n", argv[0]);
+        return -1;
+    }
+    const size_t last = argc > 2 ? (size_t)strtoul(argv[2], NULL, 10) : 0;
+
+    const int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Could not open trace file >%s<\n", argv[1]);
+        return -1;
+    }
+    const TraceFile * file = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED || (size_t)st.st_size < sizeof(TraceFile) || memcmp(file->magic, TRACE_MAGIC, sizeof(file->magic)) != 0
+            || file->record_size != sizeof(TraceRecord) || file->ring_records != TRACE_RING_RECORDS
+            || (size_t)st.st_size < sizeof(TraceFile) + file->max_threads * sizeof(TraceRing)) {
+        fprintf(stderr, ">%s< is not a trace file of this version\n", argv[1]);
+        return -1;
+    }
+
+    const uint32_t threads = file->thread_count < file->max_threads ? file->thread_count : file->max_threads;
+    size_t count = 0;
+    uint64_t overwritten = 0;
+    for (uint32_t t = 0; t < threads; t++) {
+        const uint64_t head = file->rings[t].head;
+        count += head < TRACE_RING_RECORDS ? head : TRACE_RING_RECORDS;
+        if (head > TRACE_RING_RECORDS) overwritten += head - TRACE_RING_RECORDS;
+    }
+
+    DumpRecord * records = malloc((count ? count : 1) * sizeof(DumpRecord));
+    if (!records) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    size_t filled = 0;
+    for (uint32_t t = 0; t < threads; t++) {
+        const TraceRing * ring = &file->rings[t];
+        const uint64_t head = ring->head;
+        for (uint64_t i = head < TRACE_RING_RECORDS ? 0 : head - TRACE_RING_RECORDS; i < head; i++) {
+            records[filled++] = (DumpRecord) { ring->records[i % TRACE_RING_RECORDS], t, i };
+        }
+    }
+    qsort(records, count, sizeof(DumpRecord), compareRecords);
+
+    printf("%u threads, %zu records", threads, count);
+    if (overwritten) printf(", %llu older records were overwritten", (unsigned long long)overwritten);
+    if (file->thread_count > file->max_threads) printf(", %u threads were not traced", file->thread_count - file->max_threads);
+    printf("\n");
+    for (uint32_t t = 0; t < threads; t++) printf("thread %u: tid %llu\n", t, (unsigned long long)file->rings[t].thread_id);
+
+    for (size_t i = count > last && last ? count - last : 0; i < count; i++) {
+        const TraceRecord * record = &records[i].record;
+        const double us = (double)(int64_t)(record->ticks - file->start_ticks) / file->ticks_per_us;
+        const char * name = record->event < TraceEventCount ? event_names[record->event] : "unknown";
+        printf("%14.3f us  %2u  %-9s %-5s  ", us, records[i].thread, name, record->phase <= TraceEnd ? phase_names[record->phase] : "");
+        printDetails(record);
+        printf("\n");
+    }
+
+    free(records);
+    munmap((void *)file, (size_t)st.st_size);
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "vm.h"
+#include "mathfn.h"
+#include "trace.h"
+
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO
+#endif
+
+static OpCode operatorToOpCode(Operator operator) {
+    switch (operator) {
+        case OperatorPlus: return OpAdd;
+        case OperatorMinus: return OpSub;
+        case OperatorMult: return OpMul;
+        case OperatorDiv: return OpDiv;
+        case OperatorPower: return OpPow;
+        case OperatorNegate: return OpNeg;
+        case OperatorSqrt: return OpSqrt;
+        case OperatorExp: return OpExp;
+        case OperatorLog: return OpLog;
+        case OperatorSin: return OpSin;
+        case OperatorCos: return OpCos;
+        case NoOperator: break;
+    }
+    assert(false);
+    return OpReturn;
+}
+
+typedef struct CompileFrame {
+    NodeIndex node;
+    uint8_t state; // 0: Visit left, 1: Visit right, 2: Emit
+} CompileFrame;
+
+// Counts the references of every node reachable from root, the root counts as referenced once.
+// Both children of one operator being the same node counts once, that is compiled to OpDup.
+static void countReferences(const NodeArena * arena, NodeIndex root, uint32_t * references) {
+    memset(references, 0, ((size_t)root + 1) * sizeof(uint32_t));
+    references[root] = 1;
+    for (NodeIndex node = root + 1; node-- > 0;) {
+        if (!references[node] || arena->types[node] != TokenOperator) continue;
+        references[arena->lefts[node]]++;
+        if (!isUnaryOperator(arena->operators[node]) && arena->rights[node] != arena->lefts[node]) references[arena->rights[node]]++;
+    }
+}
+
+bool compileProgram(const NodeArena * arena, NodeIndex root, Program * program) {
+    if (root == NO_NODE || root >= arena->count) {
+        snprintf(err_msg, sizeof(err_msg), "Cannot compile empty Syntax Tree\n");
+        return false;
+    }
+
+    TRACE_STAGE(TraceCompile, TraceBegin, root + 1, 0);
+    // Post order walk with an explicit stack. Every reference emits a leaf again, but an operator
+    // referenced more than once is only compiled the first time and loaded from its slot afterwards.
+    // That is at most three instructions per operator plus one per reference, two per operator.
+    const size_t max_nodes = (size_t)root + 1;
+    *program = (Program) { 0 };
+    if (arena->variables.count >= (1u << 24) || max_nodes >= (1u << 24)) {
+        snprintf(err_msg, sizeof(err_msg), "Too many variables or nodes to compile\n");
+        return false;
+    }
+    program->code = malloc((5 * max_nodes + 1) * sizeof(Instruction));
+    program->constants = malloc((2 * max_nodes + 1) * sizeof(double));
+    CompileFrame * frames = malloc(max_nodes * sizeof(CompileFrame));
+    uint32_t * references = malloc(2 * max_nodes * sizeof(uint32_t));
+    if (!program->code || !program->constants || !frames || !references) {
+        free(frames);
+        free(references);
+        freeProgram(*program);
+        snprintf(err_msg, sizeof(err_msg), "Out of memory while compiling\n");
+        return false;
+    }
+    uint32_t * slots = references + max_nodes;
+    countReferences(arena, root, references);
+    memset(slots, 0xff, max_nodes * sizeof(uint32_t));
+
+    size_t frame_count = 0;
+    size_t depth = 0;
+    frames[frame_count++] = (CompileFrame) { root, 0 };
+    while (frame_count) {
+        CompileFrame * frame = &frames[frame_count - 1];
+        const NodeIndex node = frame->node;
+        if (arena->types[node] == TokenOperator && frame->state < 2) {
+            const NodeIndex child = frame->state == 0 ? arena->lefts[node] : arena->rights[node];
+            frame->state++;
+            if (frame->state == 2 && child == arena->lefts[node]) continue;
+            if (child == NO_NODE) continue;
+            if (slots[child] != UINT32_MAX) {
+                program->code[program->code_count++] = INSTRUCTION(OpLoad, slots[child]);
+                if (++depth > program->max_stack) program->max_stack = depth;
+                continue;
+            }
+            frames[frame_count++] = (CompileFrame) { child, 0 };
+            continue;
+        }
+        frame_count--;
+
+        if (arena->types[node] == TokenValue || arena->types[node] == TokenVariable) {
+            if (arena->types[node] == TokenValue) {
+                program->constants[program->constant_count++] = arena->values[node];
+                program->code[program->code_count++] = INSTRUCTION(OpConst, 0);
+            } else {
+                program->code[program->code_count++] = INSTRUCTION(OpVar, arena->lefts[node]);
+            }
+            if (++depth > program->max_stack) program->max_stack = depth;
+            continue;
+        }
+        const Operator operator = arena->operators[node];
+        if (arena->lefts[node] == arena->rights[node]) {
+            program->code[program->code_count++] = INSTRUCTION(OpDup, 0);
+            if (++depth > program->max_stack) program->max_stack = depth;
+        }
+        program->code[program->code_count++] = INSTRUCTION(operatorToOpCode(operator), 0);
+        if (!isUnaryOperator(operator)) depth--;
+        if (references[node] > 1) {
+            slots[node] = (uint32_t)program->slot_count++;
+            program->code[program->code_count++] = INSTRUCTION(OpStore, slots[node]);
+        }
+    }
+    program->code[program->code_count++] = INSTRUCTION(OpReturn, 0);
+    assert(depth == 1);
+    free(frames);
+    free(references);
+
+    program->variables = createStrVecEx(arena->variables.count ? arena->variables.count : 1);
+    for (size_t i = 0; i < arena->variables.count; i++) {
+        if (!appendStrVec(&program->variables, arena->variables.vals[i])) {
+            freeProgram(*program);
+            snprintf(err_msg, sizeof(err_msg), "Out of memory while compiling\n");
+            return false;
+        }
+    }
+    TRACE_STAGE(TraceCompile, TraceEnd, program->code_count, 0);
+    return true;
+}
+
+void freeProgram(Program program) {
+    free(program.code);
+    free(program.constants);
+    if (program.variables.vals) freeStrVec(program.variables);
+}
+
+// The top of the stack is kept in acc, stack only holds the values below it
+double runProgram(const Program * program, const double * variables, double * stack) {
+    double * const slots = stack + program->max_stack;
+    const Instruction * ip = program->code;
+    const double * constant = program->constants;
+    double * sp = stack - 1;
+    double acc = 0;
+
+#ifdef VM_COMPUTED_GOTO
+    static const void * const labels[OpCodeCount] = {
+        [OpConst] = &&label_OpConst,
+        [OpVar] = &&label_OpVar,
+        [OpDup] = &&label_OpDup,
+        [OpStore] = &&label_OpStore,
+        [OpLoad] = &&label_OpLoad,
+        [OpAdd] = &&label_OpAdd,
+        [OpSub] = &&label_OpSub,
+        [OpMul] = &&label_OpMul,
+        [OpDiv] = &&label_OpDiv,
+        [OpPow] = &&label_OpPow,
+        [OpNeg] = &&label_OpNeg,
+        [OpSqrt] = &&label_OpSqrt,
+        [OpExp] = &&label_OpExp,
+        [OpLog] = &&label_OpLog,
+        [OpSin] = &&label_OpSin,
+        [OpCos] = &&label_OpCos,
+        [OpReturn] = &&label_OpReturn,
+    };
+    #define VM_CASE(OP) label_##OP:
+    #define VM_NEXT     goto *labels[INSTRUCTION_OP(*ip++)]
+    VM_NEXT;
+#else
+    #define VM_CASE(OP) case OP:
+    #define VM_NEXT     continue
+    for (;;) switch (INSTRUCTION_OP(*ip++)) {
+#endif
+        VM_CASE(OpConst) *++sp = acc; acc = *constant++;  VM_NEXT;
+        VM_CASE(OpVar)   *++sp = acc; acc = variables[INSTRUCTION_ARG(ip[-1])]; VM_NEXT;
+        VM_CASE(OpDup)   *++sp = acc;                     VM_NEXT;
+        VM_CASE(OpStore) slots[INSTRUCTION_ARG(ip[-1])] = acc; VM_NEXT;
+        VM_CASE(OpLoad)  *++sp = acc; acc = slots[INSTRUCTION_ARG(ip[-1])]; VM_NEXT;
+        VM_CASE(OpAdd)   acc = *sp-- + acc;               VM_NEXT;
+        VM_CASE(OpSub)   acc = *sp-- - acc;               VM_NEXT;
+        VM_CASE(OpMul)   acc = *sp-- * acc;               VM_NEXT;
+        VM_CASE(OpDiv)   acc = *sp-- / acc;               VM_NEXT;
+        VM_CASE(OpPow)   acc = pow(*sp--, acc);           VM_NEXT;
+        VM_CASE(OpNeg)   acc = -acc;                      VM_NEXT;
+        VM_CASE(OpSqrt)  acc = sqrt(acc);                 VM_NEXT;
+        VM_CASE(OpExp)   acc = mathExp(acc);              VM_NEXT;
+        VM_CASE(OpLog)   acc = mathLog(acc);              VM_NEXT;
+        VM_CASE(OpSin)   acc = mathSin(acc);              VM_NEXT;
+        VM_CASE(OpCos)   acc = mathCos(acc);              VM_NEXT;
+        VM_CASE(OpReturn) return acc;
+#ifndef VM_COMPUTED_GOTO
+        default: assert(false); return acc;
+    }
+#endif
+    #undef VM_CASE
+    #undef VM_NEXT
+}
@@ -0,0 +1,52 @@
+#ifndef __VM_H__
+#define __VM_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "syntax.h"
+
+typedef enum OpCode {
+    OpConst = 0, // Pushes the next constant
+    OpVar,       // Pushes the variable of the argument
+    OpDup,       // Pushes the top of the stack again
+    OpStore,     // Keeps the top of the stack in the shared slot of the argument
+    OpLoad,      // Pushes the shared slot of the argument
+    OpAdd,
+    OpSub,
+    OpMul,
+    OpDiv,
+    OpPow,
+    OpNeg,
+    OpSqrt,
+    OpExp,
+    OpLog,
+    OpSin,
+    OpCos,
+    OpReturn,
+    OpCodeCount,
+} OpCode;
+
+// OpCode in the low 8 bits, argument in the upper 24 bits
+typedef uint32_t Instruction;
+#define INSTRUCTION(OP, ARG)   ((Instruction)(OP) | ((Instruction)(ARG) << 8))
+#define INSTRUCTION_OP(I)      ((I) & 0xff)
+#define INSTRUCTION_ARG(I)     ((I) >> 8)
+
+// Stack based bytecode of one expression. Constants are stored in the order they are pushed.
+// Operators a DAG references more than once are computed once and kept in a shared slot.
+typedef struct Program {
+    Instruction * code;
+    size_t code_count;
+    double * constants;
+    size_t constant_count;
+    size_t max_stack; // Number of doubles runProgram needs as stack
+    size_t slot_count; // Number of shared slots, runProgram keeps them behind the stack
+    StrVec variables; // Names of the variables, runProgram expects their values in this order
+} Program;
+
+bool compileProgram(const NodeArena * arena, NodeIndex root, Program * program); // Compiles the tree of root
+void freeProgram(Program program);                                             // Frees Memory of Program
+double runProgram(const Program * program, const double * variables, double * stack); // Evaluates Program, stack needs max_stack + slot_count doubles
+
+#endif // __VM_H__